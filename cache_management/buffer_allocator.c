@@ -0,0 +1,149 @@
+//
+// Allocation of the buffers of the cache benchmarks with different page sizes
+//
+#define _GNU_SOURCE
+
+#include "buffer_allocator.h"
+
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+#define HUGE_PAGE_2M_BYTES (2L * 1024 * 1024)
+#define HUGE_PAGE_1G_BYTES (1024L * 1024 * 1024)
+
+static const char *buffer_type_names[] = {"stack", "4k", "2m", "1g", "thp"};
+
+bool buffer_type_from_name(const char *name, enum buffer_type *type) {
+    for (int i = BUFFER_STACK; i <= BUFFER_TRANSPARENT_HUGE_PAGES; ++i) {
+        if (strcmp(name, buffer_type_names[i]) == 0) {
+            *type = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char *buffer_type_name(enum buffer_type type) {
+    return buffer_type_names[type];
+}
+
+void test_buffer_allocate(struct test_buffer *buffer, enum buffer_type type, long size_bytes) {
+    memset(buffer, 0, sizeof(struct test_buffer));
+    buffer->type = type;
+    buffer->size_bytes = size_bytes;
+
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+    switch (type) {
+        case BUFFER_STACK:
+            fprintf(stderr, "stack buffers can't be mapped\n");
+            exit(-1);
+        case BUFFER_BASE_PAGES:
+            buffer->page_size_bytes = sysconf(_SC_PAGESIZE);
+            break;
+        case BUFFER_HUGETLB_2M:
+            buffer->page_size_bytes = HUGE_PAGE_2M_BYTES;
+            flags |= MAP_HUGETLB | (21 << MAP_HUGE_SHIFT);
+            break;
+        case BUFFER_HUGETLB_1G:
+            buffer->page_size_bytes = HUGE_PAGE_1G_BYTES;
+            flags |= MAP_HUGETLB | (30 << MAP_HUGE_SHIFT);
+            break;
+        case BUFFER_TRANSPARENT_HUGE_PAGES:
+            buffer->page_size_bytes = HUGE_PAGE_2M_BYTES;
+            break;
+    }
+
+    // The size is rounded to the page size. The transparent huge pages need a 2 MB aligned region, so one more huge
+    // page is mapped to align it
+    buffer->mapping_bytes = (size_bytes + buffer->page_size_bytes - 1) / buffer->page_size_bytes *
+                            buffer->page_size_bytes;
+    if (type == BUFFER_TRANSPARENT_HUGE_PAGES)
+        buffer->mapping_bytes += HUGE_PAGE_2M_BYTES;
+
+    // The transparent huge pages are mapped without access first: with mlockall(MCL_FUTURE) the pages are faulted in
+    // by mmap, before madvise could request huge pages. The mprotect after madvise faults them in
+    int protection = type == BUFFER_TRANSPARENT_HUGE_PAGES ? PROT_NONE : PROT_READ | PROT_WRITE;
+    buffer->mapping = mmap(NULL, buffer->mapping_bytes, protection, flags, -1, 0);
+    if (buffer->mapping == MAP_FAILED) {
+        if (type == BUFFER_HUGETLB_2M || type == BUFFER_HUGETLB_1G)
+            fprintf(stderr, "the %s huge pages must be reserved in /sys/kernel/mm/hugepages\n",
+                    buffer_type_name(type));
+        perror("mmap failed");
+        exit(-1);
+    }
+    buffer->address = buffer->mapping;
+
+    if (type == BUFFER_BASE_PAGES) {
+        // Keep the base pages even if transparent huge pages are enabled for all the mappings
+        madvise(buffer->mapping, buffer->mapping_bytes, MADV_NOHUGEPAGE);
+    } else if (type == BUFFER_TRANSPARENT_HUGE_PAGES) {
+        buffer->address = (void *) (((uintptr_t) buffer->mapping + HUGE_PAGE_2M_BYTES - 1) &
+                                    ~(uintptr_t) (HUGE_PAGE_2M_BYTES - 1));
+        if (madvise(buffer->address, buffer->mapping_bytes - HUGE_PAGE_2M_BYTES, MADV_HUGEPAGE))
+            perror("madvise MADV_HUGEPAGE failed");
+
+        if (mprotect(buffer->mapping, buffer->mapping_bytes, PROT_READ | PROT_WRITE)) {
+            perror("mprotect failed");
+            exit(-1);
+        }
+    }
+
+    // Write the buffer so each page is backed by its own frame
+    memset(buffer->address, 1, size_bytes);
+}
+
+void test_buffer_free(struct test_buffer *buffer) {
+    if (buffer->mapping != NULL)
+        munmap(buffer->mapping, buffer->mapping_bytes);
+    buffer->mapping = NULL;
+    buffer->address = NULL;
+}
+
+long test_buffer_huge_page_bytes(const struct test_buffer *buffer) {
+    if (buffer->type == BUFFER_HUGETLB_2M || buffer->type == BUFFER_HUGETLB_1G)
+        return buffer->mapping_bytes;
+
+    FILE *smaps = fopen("/proc/self/smaps", "r");
+    if (smaps == NULL)
+        return 0;
+
+    // Find the mapping of the buffer and read its AnonHugePages field
+    char line[256];
+    bool in_buffer_mapping = false;
+    long huge_page_bytes = 0;
+
+    while (fgets(line, sizeof(line), smaps)) {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            in_buffer_mapping = start <= (uintptr_t) buffer->address && (uintptr_t) buffer->address < end;
+            continue;
+        }
+
+        long kilobytes;
+        if (in_buffer_mapping && sscanf(line, "AnonHugePages: %ld kB", &kilobytes) == 1) {
+            huge_page_bytes = kilobytes * 1024;
+            break;
+        }
+    }
+
+    fclose(smaps);
+    return huge_page_bytes;
+}
+
+void test_buffer_print(const struct test_buffer *buffer) {
+    printf("Buffer: \n\t%s: %s\n\t%s: %ld bytes\n\t%s: %ld bytes\n\t%s: %ld bytes\n",
+           "Type", buffer_type_name(buffer->type),
+           "Size", buffer->size_bytes,
+           "Requested page size", buffer->page_size_bytes,
+           "Memory backed by huge pages", test_buffer_huge_page_bytes(buffer));
+}
@@ -0,0 +1,59 @@
+//
+// Allocation of the buffers of the cache benchmarks with different page sizes
+//
+#ifndef BUFFER_ALLOCATOR_H
+#define BUFFER_ALLOCATOR_H
+
+#include <stdbool.h>
+
+enum buffer_type {
+    // Array in the stack of the benchmark (only for the fill buffer), 4 KB pages
+    BUFFER_STACK,
+
+    // Anonymous mapping with the base pages (4 KB), transparent huge pages disabled
+    BUFFER_BASE_PAGES,
+
+    // Anonymous mapping from the hugetlbfs pools, 2 MB or 1 GB pages (they must be reserved in
+    // /sys/kernel/mm/hugepages)
+    BUFFER_HUGETLB_2M,
+    BUFFER_HUGETLB_1G,
+
+    // Anonymous mapping aligned to 2 MB with MADV_HUGEPAGE (transparent huge pages)
+    BUFFER_TRANSPARENT_HUGE_PAGES
+};
+
+struct test_buffer {
+    enum buffer_type type;
+
+    // Usable buffer and its size
+    void *address;
+    long size_bytes;
+
+    // Whole mapping (it can be bigger than the buffer to align it)
+    void *mapping;
+    long mapping_bytes;
+
+    // Size of the pages requested
+    long page_size_bytes;
+};
+
+// Get the type of a name (stack, 4k, 2m, 1g or thp). Return false if the name is not valid
+bool buffer_type_from_name(const char *name, enum buffer_type *type);
+
+// Get the name of a type
+const char *buffer_type_name(enum buffer_type type);
+
+// Map a buffer of the given type, touched so it is backed by memory. It exits if the pages aren't available. The
+// stack type can't be allocated by this function
+void test_buffer_allocate(struct test_buffer *buffer, enum buffer_type type, long size_bytes);
+
+// Unmap the buffer
+void test_buffer_free(struct test_buffer *buffer);
+
+// Get the bytes of the buffer backed by huge pages, according to /proc/self/smaps
+long test_buffer_huge_page_bytes(const struct test_buffer *buffer);
+
+// Print the type of the buffer and the memory backed by huge pages
+void test_buffer_print(const struct test_buffer *buffer);
+
+#endif // BUFFER_ALLOCATOR_H
@@ -0,0 +1,251 @@
+//
+// Eviction of a memory region from the data caches without the clear_cache kernel module
+//
+#include "cache_eviction.h"
+#include "../common/statistics.h"
+#include "../common/timer.h"
+
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <setjmp.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+// The eviction buffer is EVICTION_BUFFER_LLC_FACTOR times the last level cache
+#define EVICTION_BUFFER_LLC_FACTOR 2
+
+// Number of lines of the region timed by cache_eviction_verify, and number of trials
+#define VERIFICATION_PROBE_LINES 16
+#define VERIFICATION_TRIALS 20
+
+// A probe load is considered a miss if it is VERIFICATION_MISS_FACTOR times slower than the cached one
+#define VERIFICATION_MISS_FACTOR 2
+
+#if defined(__x86_64__)
+static bool clflushopt_available = false;
+#endif
+
+#if defined(__aarch64__)
+static sigjmp_buf flush_probe_jump;
+
+static void flush_probe_handler(int signal_number) {
+    (void) signal_number;
+    siglongjmp(flush_probe_jump, 1);
+}
+#endif
+
+static bool flush_available(void) {
+    /***
+     * Check if the lines can be flushed from user space
+     */
+
+#if defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        clflushopt_available = (ebx & (1U << 23)) != 0;
+
+    // clflush is always available in x86_64, but check it anyway
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & (1U << 19));
+#elif defined(__aarch64__)
+    // DC CIVAC is only allowed in EL0 if SCTLR_EL1.UCI is set, in other case it raises a signal
+    struct sigaction probe_action, old_sigill_action, old_sigsegv_action;
+    memset(&probe_action, 0, sizeof(probe_action));
+    probe_action.sa_handler = flush_probe_handler;
+    sigaction(SIGILL, &probe_action, &old_sigill_action);
+    sigaction(SIGSEGV, &probe_action, &old_sigsegv_action);
+
+    bool available = false;
+    int64_t probe_variable = 0;
+    if (sigsetjmp(flush_probe_jump, 1) == 0) {
+        __asm__ __volatile__("dc civac, %0\n\tdsb sy" : : "r" (&probe_variable) : "memory");
+        available = true;
+    }
+
+    sigaction(SIGILL, &old_sigill_action, NULL);
+    sigaction(SIGSEGV, &old_sigsegv_action, NULL);
+    return available;
+#else
+    return false;
+#endif
+}
+
+static void flush_region(char *address, long size_bytes, int line_size_bytes) {
+    /***
+     * Clean and invalidate all the lines of the region in all the cache levels
+     */
+
+    char *end = address + size_bytes;
+    char *line = (char *) ((uintptr_t) address & ~((uintptr_t) line_size_bytes - 1));
+
+#if defined(__x86_64__)
+    if (clflushopt_available) {
+        for (; line < end; line += line_size_bytes)
+            __asm__ __volatile__("clflushopt %0" : "+m" (*(volatile char *) line));
+    } else {
+        for (; line < end; line += line_size_bytes)
+            __asm__ __volatile__("clflush %0" : "+m" (*(volatile char *) line));
+    }
+
+    // Wait until all the flushes have finished
+    __asm__ __volatile__("mfence" : : : "memory");
+#elif defined(__aarch64__)
+    for (; line < end; line += line_size_bytes)
+        __asm__ __volatile__("dc civac, %0" : : "r" (line) : "memory");
+
+    // Wait until all the maintenance operations have finished
+    __asm__ __volatile__("dsb sy\n\tisb" : : : "memory");
+#else
+    (void) line;
+    (void) end;
+#endif
+}
+
+static void read_eviction_buffer(struct cache_eviction *eviction) {
+    /***
+     * Load one word of each line of the eviction buffer
+     */
+
+    long stride = eviction->line_size_bytes / (long) sizeof(int64_t);
+    long length = eviction->eviction_buffer_bytes / (long) sizeof(int64_t);
+    volatile int64_t *eviction_buffer = eviction->eviction_buffer;
+
+    for (long i = 0; i < length; i += stride)
+        (void) eviction_buffer[i];
+}
+
+static void manual_clear_cache() {
+    int fd;
+    fd = open("/dev/clear_cache", O_RDWR);
+    if (fd < 0) {
+        perror("Failed to open the device...");
+    }
+    close(fd);
+    sleep(1); // Allow other process to fill the cache L2 that their are using
+}
+
+bool cache_eviction_method_from_name(const char *name, enum cache_eviction_method *method) {
+    for (int i = CACHE_EVICTION_FLUSH; i <= CACHE_EVICTION_MODULE; ++i) {
+        if (strcmp(name, cache_eviction_method_name(i)) == 0) {
+            *method = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char *cache_eviction_method_name(enum cache_eviction_method method) {
+    switch (method) {
+        case CACHE_EVICTION_FLUSH:
+            return "flush";
+        case CACHE_EVICTION_BUFFER:
+            return "buffer";
+        case CACHE_EVICTION_MODULE:
+            return "module";
+    }
+
+    return "unknown";
+}
+
+void cache_eviction_init(struct cache_eviction *eviction, const struct cache_topology *topology,
+                         enum cache_eviction_method method) {
+    memset(eviction, 0, sizeof(struct cache_eviction));
+    eviction->method = method;
+    eviction->line_size_bytes = topology->line_size_bytes;
+
+    if (method == CACHE_EVICTION_FLUSH && !flush_available()) {
+        fprintf(stderr, "cache flush instructions not allowed in user space, using the eviction buffer\n");
+        eviction->method = CACHE_EVICTION_BUFFER;
+    }
+
+    if (eviction->method == CACHE_EVICTION_BUFFER) {
+        eviction->eviction_buffer_bytes = EVICTION_BUFFER_LLC_FACTOR * cache_topology_last_level_size(topology);
+        eviction->eviction_buffer = mmap(NULL, eviction->eviction_buffer_bytes, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (eviction->eviction_buffer == MAP_FAILED) {
+            perror("mmap failed");
+            exit(-1);
+        }
+
+        // Write the buffer so each page is backed by its own frame
+        memset(eviction->eviction_buffer, 1, eviction->eviction_buffer_bytes);
+    }
+}
+
+void cache_eviction_evict(struct cache_eviction *eviction, void *address, long size_bytes) {
+    switch (eviction->method) {
+        case CACHE_EVICTION_FLUSH:
+            flush_region(address, size_bytes, eviction->line_size_bytes);
+            break;
+        case CACHE_EVICTION_BUFFER:
+            read_eviction_buffer(eviction);
+            break;
+        case CACHE_EVICTION_MODULE:
+            manual_clear_cache();
+            break;
+    }
+}
+
+static uint64_t time_probe_loads(volatile char *address, long size_bytes) {
+    /***
+     * Get the ticks needed to load VERIFICATION_PROBE_LINES words spread over the region
+     */
+
+    long probe_stride = size_bytes / VERIFICATION_PROBE_LINES;
+
+    uint64_t start = timer_read();
+    for (int i = 0; i < VERIFICATION_PROBE_LINES; ++i)
+        (void) address[i * probe_stride];
+    uint64_t end = timer_read();
+
+    return end - start;
+}
+
+bool cache_eviction_verify(struct cache_eviction *eviction, void *address, long size_bytes) {
+    struct histogram cached_histogram, evicted_histogram;
+    histogram_init(&cached_histogram);
+    histogram_init(&evicted_histogram);
+
+    int evicted_trials = 0;
+    for (int trial = 0; trial < VERIFICATION_TRIALS; ++trial) {
+        // Load the probe lines and time them while they are cached
+        time_probe_loads(address, size_bytes);
+        long long cached_nanoseconds = timer_ticks_to_ns(
+                (long long) time_probe_loads(address, size_bytes) - timer_overhead_ticks);
+
+        cache_eviction_evict(eviction, address, size_bytes);
+        long long evicted_nanoseconds = timer_ticks_to_ns(
+                (long long) time_probe_loads(address, size_bytes) - timer_overhead_ticks);
+
+        histogram_record(&cached_histogram, cached_nanoseconds / VERIFICATION_PROBE_LINES);
+        histogram_record(&evicted_histogram, evicted_nanoseconds / VERIFICATION_PROBE_LINES);
+
+        if (evicted_nanoseconds > VERIFICATION_MISS_FACTOR * (cached_nanoseconds > 0 ? cached_nanoseconds : 1))
+            evicted_trials++;
+    }
+
+    bool verified = evicted_trials * 2 > VERIFICATION_TRIALS;
+
+    printf("Cache eviction: \n\t%s: %s\n\t%s: %lld ns\n\t%s: %lld ns\n\t%s: %d of %d (%s)\n",
+           "Method", cache_eviction_method_name(eviction->method),
+           "Median probe load time when cached", histogram_percentile(&cached_histogram, 50.0),
+           "Median probe load time after eviction", histogram_percentile(&evicted_histogram, 50.0),
+           "Trials with evicted probe lines", evicted_trials, VERIFICATION_TRIALS,
+           verified ? "verified" : "NOT verified");
+
+    return verified;
+}
+
+void cache_eviction_destroy(struct cache_eviction *eviction) {
+    if (eviction->eviction_buffer != NULL)
+        munmap(eviction->eviction_buffer, eviction->eviction_buffer_bytes);
+    eviction->eviction_buffer = NULL;
+}
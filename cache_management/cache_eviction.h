@@ -0,0 +1,55 @@
+//
+// Eviction of a memory region from the data caches without the clear_cache kernel module
+//
+#ifndef CACHE_EVICTION_H
+#define CACHE_EVICTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cache_topology.h"
+
+enum cache_eviction_method {
+    // Flush each line of the region (clflushopt/clflush on x86_64, DC CIVAC on aarch64)
+    CACHE_EVICTION_FLUSH,
+
+    // Read a buffer bigger than the last level cache, replacing all its lines
+    CACHE_EVICTION_BUFFER,
+
+    // Open /dev/clear_cache (clear_cache_module) and wait one second
+    CACHE_EVICTION_MODULE
+};
+
+struct cache_eviction {
+    enum cache_eviction_method method;
+
+    // Size of the lines flushed and of the stride used to read the eviction buffer
+    int line_size_bytes;
+
+    // Buffer used by CACHE_EVICTION_BUFFER
+    int64_t *eviction_buffer;
+    long eviction_buffer_bytes;
+};
+
+// Get the method with the given name ("flush", "buffer" or "module"). Return false if the name is not valid
+bool cache_eviction_method_from_name(const char *name, enum cache_eviction_method *method);
+
+// Get the name of a method
+const char *cache_eviction_method_name(enum cache_eviction_method method);
+
+// Prepare the eviction with the given method, sized from the detected topology. If the flush instructions aren't
+// allowed in user space the buffer method is used instead
+void cache_eviction_init(struct cache_eviction *eviction, const struct cache_topology *topology,
+                         enum cache_eviction_method method);
+
+// Evict the region [address, address + size_bytes) from all the data cache levels
+void cache_eviction_evict(struct cache_eviction *eviction, void *address, long size_bytes);
+
+// Check that the eviction works timing the load of some lines of the region before and after evicting it, and print
+// the result. Return true if the lines were slower to load after the eviction in most of the trials
+bool cache_eviction_verify(struct cache_eviction *eviction, void *address, long size_bytes);
+
+// Release the resources of the eviction
+void cache_eviction_destroy(struct cache_eviction *eviction);
+
+#endif // CACHE_EVICTION_H
@@ -0,0 +1,195 @@
+//
+// Detection of the data cache hierarchy of a CPU
+//
+// The hierarchy is read from /sys/devices/system/cpu/cpu*/cache. CLIDR_EL1 and CCSIDR_EL1 can only be read from EL1
+// (that is what the clear_cache module does), so in user space on aarch64 only the line size can be obtained from the
+// hardware, through CTR_EL0.
+//
+#include "cache_topology.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Sizes used when the hierarchy can't be detected (Raspberry Pi 3B)
+#define DEFAULT_L1_CACHE_SIZE_BYTES 16384 // 16KB L1P and L1D
+#define DEFAULT_L2_CACHE_SIZE_BYTES 524288 // 512KB L2
+#define DEFAULT_CACHE_LINE_SIZE_BYTES 64
+
+static int read_sysfs_string(int cpu, int index, const char *attribute, char *value, int value_size) {
+    /***
+     * Read the attribute of the cache index of cpu
+     * Return 0 on success
+     */
+
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/%s", cpu, index, attribute);
+
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return -1;
+
+    if (fgets(value, value_size, file) == NULL) {
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    // Remove the end of line
+    value[strcspn(value, "\n")] = '\0';
+    return 0;
+}
+
+static long read_sysfs_number(int cpu, int index, const char *attribute) {
+    /***
+     * Read a numeric attribute of the cache index of cpu, accepting the K and M suffixes
+     * Return 0 if it can't be read
+     */
+
+    char value[64];
+    if (read_sysfs_string(cpu, index, attribute, value, sizeof(value)))
+        return 0;
+
+    char *suffix;
+    long number = strtol(value, &suffix, 10);
+    if (*suffix == 'K')
+        number *= 1024;
+    else if (*suffix == 'M')
+        number *= 1024 * 1024;
+
+    return number;
+}
+
+static int count_cpus_in_list(const char *cpu_list) {
+    /***
+     * Count the CPUs of a list with the format "0-3,8,10-11"
+     */
+
+    int number_of_cpus = 0;
+    const char *position = cpu_list;
+
+    while (*position) {
+        char *end;
+        long first = strtol(position, &end, 10);
+        long last = first;
+        if (*end == '-')
+            last = strtol(end + 1, &end, 10);
+
+        number_of_cpus += (int) (last - first + 1);
+
+        if (*end != ',')
+            break;
+        position = end + 1;
+    }
+
+    return number_of_cpus;
+}
+
+static int hardware_line_size(void) {
+    /***
+     * Get the smallest data cache line size from the hardware, or 0 if it isn't available
+     */
+
+#if defined(__aarch64__)
+    unsigned long ctr;
+    __asm__ __volatile__("mrs %0, ctr_el0" : "=r" (ctr));
+
+    // DminLine: log2 of the number of words (4 bytes) of the smallest data cache line
+    return 4 << ((ctr >> 16) & 0xf);
+#else
+    return 0;
+#endif
+}
+
+void cache_topology_detect(int cpu, struct cache_topology *topology) {
+    memset(topology, 0, sizeof(struct cache_topology));
+
+    for (int index = 0; topology->number_of_levels < MAX_CACHE_LEVELS; ++index) {
+        char type[16];
+        if (read_sysfs_string(cpu, index, "type", type, sizeof(type)))
+            break;
+
+        // Instruction caches aren't used by the benchmarks
+        if (strcmp(type, "Instruction") == 0)
+            continue;
+
+        struct cache_level *cache_level = &(topology->levels[topology->number_of_levels]);
+        snprintf(cache_level->type, sizeof(cache_level->type), "%s", type);
+        cache_level->level = (int) read_sysfs_number(cpu, index, "level");
+        cache_level->size_bytes = read_sysfs_number(cpu, index, "size");
+        cache_level->line_size_bytes = (int) read_sysfs_number(cpu, index, "coherency_line_size");
+        cache_level->ways_of_associativity = (int) read_sysfs_number(cpu, index, "ways_of_associativity");
+        cache_level->number_of_sets = (int) read_sysfs_number(cpu, index, "number_of_sets");
+
+        char shared_cpu_list[256];
+        if (read_sysfs_string(cpu, index, "shared_cpu_list", shared_cpu_list, sizeof(shared_cpu_list)) == 0)
+            cache_level->shared_cpus = count_cpus_in_list(shared_cpu_list);
+        else
+            cache_level->shared_cpus = 1;
+
+        // Some platforms don't report the size in sysfs
+        if (cache_level->size_bytes == 0 && cache_level->line_size_bytes && cache_level->ways_of_associativity &&
+            cache_level->number_of_sets) {
+            cache_level->size_bytes = (long) cache_level->line_size_bytes * cache_level->ways_of_associativity *
+                                      cache_level->number_of_sets;
+        }
+
+        if (cache_level->level > 0 && cache_level->size_bytes > 0)
+            topology->number_of_levels++;
+    }
+
+    // Sort by level (the indexes are usually already sorted)
+    for (int i = 1; i < topology->number_of_levels; ++i) {
+        struct cache_level cache_level = topology->levels[i];
+        int j = i - 1;
+        while (j >= 0 && topology->levels[j].level > cache_level.level) {
+            topology->levels[j + 1] = topology->levels[j];
+            j--;
+        }
+        topology->levels[j + 1] = cache_level;
+    }
+
+    topology->detected = topology->number_of_levels > 0;
+
+    if (!topology->detected) {
+        topology->number_of_levels = 2;
+        topology->levels[0] = (struct cache_level) {1, "Data", DEFAULT_L1_CACHE_SIZE_BYTES, 0, 0, 0, 1};
+        topology->levels[1] = (struct cache_level) {2, "Unified", DEFAULT_L2_CACHE_SIZE_BYTES, 0, 0, 0, 1};
+    }
+
+    // Line size
+    topology->line_size_bytes = hardware_line_size();
+    for (int i = 0; i < topology->number_of_levels && topology->line_size_bytes == 0; ++i)
+        topology->line_size_bytes = topology->levels[i].line_size_bytes;
+    if (topology->line_size_bytes == 0)
+        topology->line_size_bytes = DEFAULT_CACHE_LINE_SIZE_BYTES;
+
+    for (int i = 0; i < topology->number_of_levels; ++i) {
+        if (topology->levels[i].line_size_bytes == 0)
+            topology->levels[i].line_size_bytes = topology->line_size_bytes;
+    }
+}
+
+long cache_topology_level_size(const struct cache_topology *topology, int level) {
+    for (int i = 0; i < topology->number_of_levels; ++i) {
+        if (topology->levels[i].level == level)
+            return topology->levels[i].size_bytes;
+    }
+
+    return 0;
+}
+
+long cache_topology_last_level_size(const struct cache_topology *topology) {
+    return topology->levels[topology->number_of_levels - 1].size_bytes;
+}
+
+void cache_topology_print(const struct cache_topology *topology) {
+    printf("Cache hierarchy (%s): \n", topology->detected ? "detected" : "default values");
+
+    for (int i = 0; i < topology->number_of_levels; ++i) {
+        const struct cache_level *cache_level = &(topology->levels[i]);
+        printf("\tL%d %s: %ld KB, %d B lines, %d ways, %d sets, shared by %d CPUs\n", cache_level->level,
+               cache_level->type, cache_level->size_bytes / 1024, cache_level->line_size_bytes,
+               cache_level->ways_of_associativity, cache_level->number_of_sets, cache_level->shared_cpus);
+    }
+}
@@ -0,0 +1,52 @@
+//
+// Detection of the data cache hierarchy of a CPU
+//
+#ifndef CACHE_TOPOLOGY_H
+#define CACHE_TOPOLOGY_H
+
+#include <stdbool.h>
+
+#define MAX_CACHE_LEVELS 8
+
+struct cache_level {
+    // Level of the cache (1 for L1, 2 for L2...)
+    int level;
+
+    // "Data" or "Unified"
+    char type[16];
+
+    long size_bytes;
+    int line_size_bytes;
+    int ways_of_associativity;
+    int number_of_sets;
+
+    // Number of CPUs sharing this cache
+    int shared_cpus;
+};
+
+struct cache_topology {
+    // Data and unified caches, ordered by level
+    int number_of_levels;
+    struct cache_level levels[MAX_CACHE_LEVELS];
+
+    // Smallest data cache line size
+    int line_size_bytes;
+
+    // True if the sizes were read from the system, false if the default ones are used
+    bool detected;
+};
+
+// Detect the data and unified caches used by cpu. If they can't be detected the sizes of the Raspberry Pi 3B
+// (16KB L1 and 512KB L2) are used
+void cache_topology_detect(int cpu, struct cache_topology *topology);
+
+// Get the size of the given cache level, or 0 if it doesn't exist
+long cache_topology_level_size(const struct cache_topology *topology, int level);
+
+// Get the size of the last level cache
+long cache_topology_last_level_size(const struct cache_topology *topology);
+
+// Print the detected cache hierarchy
+void cache_topology_print(const struct cache_topology *topology);
+
+#endif // CACHE_TOPOLOGY_H
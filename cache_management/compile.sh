@@ -1,10 +1,18 @@
 #!/bin/bash
 
-CC=aarch64-none-linux-gnu-gcc
-ARCHITECTURE=aarch64
+# Architecture variables (ARCHITECTURE=x86_64 ./compile.sh builds the x86_64 version with the native compiler)
+ARCHITECTURE=${ARCHITECTURE:-aarch64}
+
+if [ "${ARCHITECTURE}" == "aarch64" ]; then
+  CC=${CC:-aarch64-none-linux-gnu-gcc}
+  ARCHITECTURE_FLAGS="-D AARCH64_COMPILATION"
+else
+  CC=${CC:-gcc}
+  ARCHITECTURE_FLAGS="-D X86_64_COMPILATION"
+fi
 
 mkdir -p ../builds/${ARCHITECTURE}
 
 # Get MP to L2 transfer cost
 #
-${CC} -Wall -O0 -D AARCH64_COMPILATION l2_cache_fill.aarch64.S l2_cache_fill_cost.c -o ../builds/${ARCHITECTURE}/l2_cache_fill_cost
\ No newline at end of file
+${CC} -Wall -O0 ${ARCHITECTURE_FLAGS} l2_cache_fill.${ARCHITECTURE}.S l2_cache_fill_cost.c fill_kernels.c pointer_chase.c buffer_allocator.c cache_topology.c cache_eviction.c ../common/statistics.c ../common/timer.c ../common/perf_counters.c ../common/interference.c ../common/overhead_profile.c ../common/result_file.c ../common/preflight.c -lm -o ../builds/${ARCHITECTURE}/l2_cache_fill_cost
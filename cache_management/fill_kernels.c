@@ -0,0 +1,106 @@
+//
+// Runtime selection of the kernels used to read the vectors of the cache benchmarks
+//
+#include "fill_kernels.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+static bool always_available(void) {
+    return true;
+}
+
+static bool simd_available(void) {
+#if defined(__aarch64__)
+    return (getauxval(AT_HWCAP) & HWCAP_ASIMD) != 0;
+#elif defined(__x86_64__)
+    return true; // SSE2 is part of x86_64
+#else
+    return false;
+#endif
+}
+
+static bool simd_256_available(void) {
+#if defined(__aarch64__)
+    return simd_available();
+#elif defined(__x86_64__)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+static bool simd_512_available(void) {
+#if defined(__aarch64__)
+    return simd_available();
+#elif defined(__x86_64__)
+    return __builtin_cpu_supports("avx512f");
+#else
+    return false;
+#endif
+}
+
+static bool non_temporal_available(void) {
+#if defined(__aarch64__)
+    return simd_available();
+#elif defined(__x86_64__)
+    return __builtin_cpu_supports("sse4.1");
+#else
+    return false;
+#endif
+}
+
+const struct fill_kernel fill_kernels[NUMBER_OF_FILL_KERNELS + 1] = {
+        {"64_bits",      "one 64 bits load per element",                 read_from_vector_64_bits,      8,
+                always_available},
+        {"128_bits",     "128 bits SIMD loads (NEON/SSE)",               read_from_vector_128_bits,     16,
+                simd_available},
+        {"256_bits",     "256 bits SIMD loads (2 NEON registers/AVX2)",  read_from_vector_256_bits,     32,
+                simd_256_available},
+        {"512_bits",     "512 bits SIMD loads (4 NEON registers/AVX-512)", read_from_vector_512_bits,   64,
+                simd_512_available},
+        {"non_temporal", "non-temporal loads (LDNP/MOVNTDQA)",           read_from_vector_non_temporal, 16,
+                non_temporal_available},
+        {"cache_line",   "one 64 bits load per cache line",              read_from_vector_cache_line,   8,
+                always_available},
+        {"unrolled",     "all the 64 bits loads of a cache line unrolled", read_from_vector_unrolled,   8,
+                always_available},
+        {"store",        "one 64 bits store per element (dirty lines)",  write_to_vector_64_bits,       8,
+                always_available},
+        {"rmw",          "one 64 bits read-modify-write per element",    modify_vector_64_bits,         8,
+                always_available},
+        {NULL,           NULL,                                           NULL,                          0, NULL}
+};
+
+const struct fill_kernel *fill_kernel_select(const char *name) {
+    if (strcmp(name, "auto") == 0) {
+        // Widest SIMD load supported by the CPU
+        const struct fill_kernel *selected_kernel = &(fill_kernels[0]);
+        for (const struct fill_kernel *kernel = fill_kernels; kernel->name != NULL; ++kernel) {
+            if (strstr(kernel->name, "_bits") != NULL && kernel->available() &&
+                kernel->load_size_bytes > selected_kernel->load_size_bytes)
+                selected_kernel = kernel;
+        }
+        return selected_kernel;
+    }
+
+    for (const struct fill_kernel *kernel = fill_kernels; kernel->name != NULL; ++kernel) {
+        if (strcmp(kernel->name, name) == 0)
+            return kernel->available() ? kernel : NULL;
+    }
+
+    return NULL;
+}
+
+void fill_kernels_print(void) {
+    printf("Kernels: \n");
+    for (const struct fill_kernel *kernel = fill_kernels; kernel->name != NULL; ++kernel) {
+        printf("\t%s: %s (%s)\n", kernel->name, kernel->description,
+               kernel->available() ? "available" : "not supported by the CPU");
+    }
+}
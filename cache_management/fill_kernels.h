@@ -0,0 +1,57 @@
+//
+// Kernels used to read (or write) the vectors of the cache benchmarks, implemented in l2_cache_fill.<architecture>.S
+//
+#ifndef FILL_KERNELS_H
+#define FILL_KERNELS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Read (or write) a vector from initial_addr to final_addr (address of its last 64 bits element). The size of the
+// vector must be a multiple of 64 bytes and it must be aligned to 16 bytes
+typedef void (*fill_kernel_function)(int64_t *initial_addr, int64_t *final_addr);
+
+struct fill_kernel {
+    const char *name;
+    const char *description;
+    fill_kernel_function function;
+
+    // Bytes accessed by each load (or store) instruction
+    int load_size_bytes;
+
+    // True if the CPU supports the instructions used by the kernel
+    bool (*available)(void);
+};
+
+extern void read_from_vector_64_bits(int64_t *initial_addr, int64_t *final_addr);
+
+extern void read_from_vector_128_bits(int64_t *initial_addr, int64_t *final_addr);
+
+extern void read_from_vector_256_bits(int64_t *initial_addr, int64_t *final_addr);
+
+extern void read_from_vector_512_bits(int64_t *initial_addr, int64_t *final_addr);
+
+extern void read_from_vector_non_temporal(int64_t *initial_addr, int64_t *final_addr);
+
+extern void read_from_vector_cache_line(int64_t *initial_addr, int64_t *final_addr);
+
+extern void read_from_vector_unrolled(int64_t *initial_addr, int64_t *final_addr);
+
+extern void write_to_vector_64_bits(int64_t *initial_addr, int64_t *final_addr);
+
+extern void modify_vector_64_bits(int64_t *initial_addr, int64_t *final_addr);
+
+// Number of kernels
+#define NUMBER_OF_FILL_KERNELS 9
+
+// All the kernels, the last one has a NULL name
+extern const struct fill_kernel fill_kernels[NUMBER_OF_FILL_KERNELS + 1];
+
+// Get the kernel with the given name, or the widest one available for "auto". Return NULL if it doesn't exist or the
+// CPU doesn't support it
+const struct fill_kernel *fill_kernel_select(const char *name);
+
+// Print the kernels and if they are supported by the CPU
+void fill_kernels_print(void);
+
+#endif // FILL_KERNELS_H
@@ -14,71 +14,525 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <errno.h>
-#include <fcntl.h>
 #include <string.h>
 
+#include "../common/statistics.h"
+#include "../common/timer.h"
+#include "../common/perf_counters.h"
+#include "../common/interference.h"
+#include "../common/overhead_profile.h"
+#include "../common/result_file.h"
+#include "../common/preflight.h"
+#include "cache_topology.h"
+#include "cache_eviction.h"
+#include "fill_kernels.h"
+#include "pointer_chase.h"
+#include "buffer_allocator.h"
+
 #define NUMBER_OF_EXPERIMENTS 100
 #define CORE_TO_TEST 2
 
-#define L1_CACHE_SIZE_BYTES 16384 // 16KB L1P and L1D
-#define L2_CACHE_SIZE_BYTES 524288 // 512KB L2
+// Sweep mode: working sets from SWEEP_MIN_SIZE_BYTES up to SWEEP_LLC_FACTOR times the last level cache, with
+// SWEEP_STEPS_PER_DOUBLING sizes between powers of two
+#define SWEEP_MIN_SIZE_BYTES 1024
+#define SWEEP_LLC_FACTOR 4
+#define SWEEP_STEPS_PER_DOUBLING 2
+#define SWEEP_EXPERIMENTS 20
+
+// Pointer chasing mode: each experiment follows at least POINTER_CHASE_MIN_ACCESSES pointers
+#define POINTER_CHASE_EXPERIMENTS 10
+#define POINTER_CHASE_MIN_ACCESSES 1000000
+#define PAGE_SIZE_BYTES 4096
+
+// The default buffer of the pointer chasing mode (the span of SWEEP_LLC_FACTOR times the last level cache, page size /
+// line size times bigger with pages) is locked, so it is capped to 1/POINTER_CHASE_MEMORY_DIVISOR of the memory
+#define POINTER_CHASE_MEMORY_DIVISOR 4
+
+// Biggest fill vector kept in the stack (8 MB by default), bigger ones (half of the last level cache when there isn't
+// L2) are mapped with base pages
+#define STACK_FILL_VECTOR_MAX_BYTES (2 * 1024 * 1024)
+
+// TLB mode: chains of TLB_MIN_PAGES up to TLB_MAX_PAGES pages (by default), doubling the number of pages
+#define TLB_MIN_PAGES 16
+#define TLB_MAX_PAGES 16384
+
+void measure_fill_cost(int64_t *l2_fill_vector, long l2_fill_vector_length, fill_kernel_function read_vector,
+                       struct cache_eviction *eviction, long number_of_experiments,
+                       struct histogram *l2_load_cost_histogram, struct histogram *not_cached_histogram,
+                       const struct perf_counters *perf_counters, struct perf_attribution *attribution,
+                       struct result_series *series) {
+    /***
+     * Measure the difference between iterating over the vector when it isn't in the cache and when it is
+     * The time of the iterations when the vector isn't in the cache is also recorded in not_cached_histogram
+     * If perf_counters isn't NULL, the counter deltas of these iterations are recorded in attribution
+     * If series isn't NULL, the raw differences are recorded in it too
+     */
+
+    int64_t counters_before[NUMBER_OF_PERF_COUNTERS], counters_after[NUMBER_OF_PERF_COUNTERS];
+
+    // Variables where the time will be stored
+    uint64_t local_time_measure_before, local_time_measure_after;
+
+    // Variables that will contain the execution time. They shouldn't be stored in cache while the loop execution neither
+    long long cached_vector_operation_time, not_cached_vector_operation_time;
+
+    // Execute experiments
+    for (long j = 0; j < number_of_experiments; ++j) {
+        // Fill L2 level cache
+        read_vector(l2_fill_vector, &l2_fill_vector[l2_fill_vector_length - 1]);
+
+        // Cost of load vector stored in L2Cache
+        local_time_measure_before = timer_read();
+        read_vector(l2_fill_vector, &l2_fill_vector[l2_fill_vector_length - 1]);
+        local_time_measure_after = timer_read();
+
+        // Operation time calculation
+        cached_vector_operation_time = timer_interval_ns(local_time_measure_before, local_time_measure_after);
+
+        // Clean cache
+        cache_eviction_evict(eviction, l2_fill_vector, l2_fill_vector_length * (long) sizeof(int64_t));
+
+        // Cost of load vector not stored in L2Cache
+        if (perf_counters != NULL)
+            perf_counters_read(perf_counters, counters_before);
+        local_time_measure_before = timer_read();
+        read_vector(l2_fill_vector, &l2_fill_vector[l2_fill_vector_length - 1]);
+        local_time_measure_after = timer_read();
+        if (perf_counters != NULL)
+            perf_counters_read(perf_counters, counters_after);
 
-extern void read_from_vector_64_bits(int64_t *initial_addr, int64_t *final_addr);
+        // Operation time calculation
+        not_cached_vector_operation_time = timer_interval_ns(local_time_measure_before, local_time_measure_after);
+        if (perf_counters != NULL)
+            perf_attribution_record(attribution, not_cached_vector_operation_time, counters_before, counters_after);
 
-void manual_clear_cache() {
-    int fd;
-    fd = open("/dev/clear_cache", O_RDWR);
-    if (fd < 0) {
-        perror("Failed to open the device...");
+        // Store experiment result
+        histogram_record(l2_load_cost_histogram, not_cached_vector_operation_time - cached_vector_operation_time);
+        if (series != NULL)
+            result_series_record(series, not_cached_vector_operation_time - cached_vector_operation_time);
+        histogram_record(not_cached_histogram, not_cached_vector_operation_time);
     }
-    close(fd);
-    sleep(1); // Allow other process to fill the cache L2 that their are using
 }
 
-bool timespec_subtract(struct timespec *result, struct timespec *start_time, struct timespec *end_time) {
+void measure_pollution_cost(int64_t *l2_fill_vector, long l2_fill_vector_length, fill_kernel_function read_vector,
+                            struct cache_eviction *eviction, int64_t *pollution_vector, long pollution_vector_length,
+                            long number_of_experiments, struct histogram *clean_histogram,
+                            struct histogram *dirty_histogram) {
     /***
-     * Do timeval subtraction
-     * result = end_time - start_time
-     * Return true if is positive, else negative
+     * Measure the time to read the evicted vector when the cache has been filled before with clean lines (the
+     * pollution vector was read) and with dirty lines (it was written), so the refill of the second case also has to
+     * write back the lines it replaces. Both cases are alternated in each experiment
      */
 
-    bool return_value;
-    if (end_time->tv_sec > start_time->tv_sec ||
-        (end_time->tv_sec == start_time->tv_sec && end_time->tv_nsec >= start_time->tv_nsec)) {
-        result->tv_sec = end_time->tv_sec - start_time->tv_sec;
-        result->tv_nsec = end_time->tv_nsec - start_time->tv_nsec;
-        return_value = true;
-    } else {
-        result->tv_sec = start_time->tv_sec - end_time->tv_sec;
-        result->tv_nsec = start_time->tv_nsec - end_time->tv_nsec;
-        return_value = false;
+    uint64_t local_time_measure_before, local_time_measure_after;
+
+    for (long j = 0; j < 2 * number_of_experiments; ++j) {
+        bool dirty = j % 2;
+
+        // Write back the pollution of the previous experiment, a dirty line that is read again stays dirty and the
+        // clean refill would pay its write back too. The buffer and module methods already replace the whole cache
+        if (eviction->method == CACHE_EVICTION_FLUSH)
+            cache_eviction_evict(eviction, pollution_vector, pollution_vector_length * (long) sizeof(int64_t));
+
+        // Bring the vector to the cache and evict it, so the pollution is the only content of the cache
+        read_vector(l2_fill_vector, &l2_fill_vector[l2_fill_vector_length - 1]);
+        cache_eviction_evict(eviction, l2_fill_vector, l2_fill_vector_length * (long) sizeof(int64_t));
+
+        // Pollute the cache with clean or dirty lines
+        if (dirty)
+            write_to_vector_64_bits(pollution_vector, &pollution_vector[pollution_vector_length - 1]);
+        else
+            read_from_vector_64_bits(pollution_vector, &pollution_vector[pollution_vector_length - 1]);
+
+        // Cost of refilling the cache with the vector
+        local_time_measure_before = timer_read();
+        read_vector(l2_fill_vector, &l2_fill_vector[l2_fill_vector_length - 1]);
+        local_time_measure_after = timer_read();
+
+        histogram_record(dirty ? dirty_histogram : clean_histogram,
+                         timer_interval_ns(local_time_measure_before, local_time_measure_after));
+    }
+}
+
+void print_pollution_cost(long vector_bytes, long pollution_bytes, struct histogram *clean_histogram,
+                          struct histogram *dirty_histogram) {
+    /***
+     * Print the refill after a clean and after a dirty pollution side by side, and the write back penalty
+     */
+
+    struct histogram *histograms[] = {clean_histogram, dirty_histogram};
+    const char *names[] = {"clean", "dirty"};
+
+    printf("Refill after evicting clean and dirty lines (pollution of %ld bytes):\n", pollution_bytes);
+    printf("eviction,refill_p50_ns,refill_p99_ns,refill_bandwidth_MBps\n");
+    for (int i = 0; i < 2; ++i) {
+        long long median_ns = histogram_percentile(histograms[i], 50.0);
+        printf("%s,%lld,%lld,%.1f\n", names[i], median_ns, histogram_percentile(histograms[i], 99.0),
+               median_ns > 0 ? (double) vector_bytes * 1000.0 / (double) median_ns : 0.0);
     }
+    printf("\t%s: %lld ns\n", "Median write back penalty of the refill",
+           histogram_percentile(dirty_histogram, 50.0) - histogram_percentile(clean_histogram, 50.0));
+}
+
+const char *working_set_level(const struct cache_topology *topology, long size_bytes) {
+    /***
+     * Get the name of the smallest memory level where a working set of size_bytes fits
+     */
+
+    static const char *level_names[] = {"L1", "L2", "L3", "L4", "L5", "L6", "L7", "L8"};
 
-    if (result->tv_nsec < 0) {
-        result->tv_nsec += 1000000000L;
-        result->tv_sec -= 1L;
+    for (int i = 0; i < topology->number_of_levels; ++i) {
+        if (size_bytes <= topology->levels[i].size_bytes && topology->levels[i].level <= MAX_CACHE_LEVELS)
+            return level_names[topology->levels[i].level - 1];
     }
 
-    return return_value;
+    return "DRAM";
 }
 
-int main() {
-    // Variables where the time will be stored
-    struct timespec local_time_measure_before, local_time_measure_after;
+void measure_sweep(const struct cache_topology *topology, long max_size_bytes, fill_kernel_function read_vector,
+                   enum buffer_type buffer_type) {
+    /***
+     * Measure the time needed to read working sets of increasing size that are already loaded in the cache (as
+     * much as they fit), and print the latency and bandwidth curve
+     */
 
-    // Variable with the size of half L2 cache
-    // As other programs can be executing concurrently, only half cache will be used for the tests.
-    // This will correspond to 8 from the 16 lines each set has
-    int64_t l2_fill_vector[L2_CACHE_SIZE_BYTES / (2 * 8)];
+    // Buffer shared by all the working sets (it is locked in memory by mlockall)
+    struct test_buffer buffer;
+    test_buffer_allocate(&buffer, buffer_type, max_size_bytes);
+    test_buffer_print(&buffer);
+    int64_t *sweep_vector = buffer.address;
 
-    // Auxiliary variable where the time difference will be stored. It shouldn't be stored in cache while the loop execution
-    struct timespec result;
+    struct histogram read_time_histogram;
 
-    // Variables that will contain the execution time. They shouldn't be stored in cache while the loop execution neither
-    long long cached_vector_operation_time, not_cached_vector_operation_time;
+    printf("Sweep result: \n\t%s: %d\n", "Number of experiments per working set", SWEEP_EXPERIMENTS);
+    printf("size_bytes,level,median_ns,p99_ns,ns_per_access,bandwidth_MBps\n");
+
+    for (int step = 0;; ++step) {
+        // SWEEP_STEPS_PER_DOUBLING equally spaced sizes between each power of two, rounded to the line size
+        long size_bytes = ((long) SWEEP_MIN_SIZE_BYTES << (step / SWEEP_STEPS_PER_DOUBLING)) *
+                          (SWEEP_STEPS_PER_DOUBLING + step % SWEEP_STEPS_PER_DOUBLING) / SWEEP_STEPS_PER_DOUBLING;
+        size_bytes &= ~63L;
+        if (size_bytes > max_size_bytes)
+            break;
+
+        long length = size_bytes / 8;
+        histogram_init(&read_time_histogram);
+
+        // Load the working set in the cache
+        read_vector(sweep_vector, &sweep_vector[length - 1]);
+
+        for (int j = 0; j < SWEEP_EXPERIMENTS; ++j) {
+            uint64_t local_time_measure_before = timer_read();
+            read_vector(sweep_vector, &sweep_vector[length - 1]);
+            uint64_t local_time_measure_after = timer_read();
+
+            histogram_record(&read_time_histogram,
+                             timer_interval_ns(local_time_measure_before, local_time_measure_after));
+        }
+
+        long long median_ns = histogram_percentile(&read_time_histogram, 50.0);
+        printf("%ld,%s,%lld,%lld,%.3f,%.1f\n", size_bytes, working_set_level(topology, size_bytes), median_ns,
+               histogram_percentile(&read_time_histogram, 99.0), (double) median_ns / (double) length,
+               median_ns > 0 ? (double) size_bytes * 1000.0 / (double) median_ns : 0.0);
+    }
+
+    test_buffer_free(&buffer);
+}
+
+void measure_chase_latency(void *buffer, long span_bytes, long granularity_bytes, int line_size_bytes,
+                           struct histogram *latency_picoseconds_histogram) {
+    /***
+     * Measure the latency of each dependent load of a random chain over span_bytes of buffer, in picoseconds
+     */
+
+    long number_of_slots = pointer_chase_build(buffer, span_bytes, granularity_bytes, line_size_bytes);
+    long accesses = number_of_slots;
+    while (accesses < POINTER_CHASE_MIN_ACCESSES)
+        accesses += number_of_slots;
+
+    // Load the chain in the cache (as much as it fits)
+    void **position = chase_pointers(pointer_chase_start(buffer), number_of_slots);
+
+    for (int j = 0; j < POINTER_CHASE_EXPERIMENTS; ++j) {
+        uint64_t local_time_measure_before = timer_read();
+        position = chase_pointers(position, accesses);
+        uint64_t local_time_measure_after = timer_read();
+
+        histogram_record(latency_picoseconds_histogram,
+                         timer_interval_ns(local_time_measure_before, local_time_measure_after) * 1000 / accesses);
+    }
+}
+
+void measure_latency(const struct cache_topology *topology, long granularity_bytes, long max_size_bytes, bool sweep,
+                     enum buffer_type buffer_type) {
+    /***
+     * Measure the dependent load latency of each memory level (or of a sweep of sizes), visiting one line of each
+     * granularity_bytes slot
+     * The footprint in the cache is one line per slot, so the buffer spans granularity / line size times the
+     * footprint
+     */
+
+    int line_size_bytes = topology->line_size_bytes;
+    long span_per_footprint = granularity_bytes / line_size_bytes;
+
+    struct test_buffer buffer;
+    test_buffer_allocate(&buffer, buffer_type, max_size_bytes);
+    test_buffer_print(&buffer);
+    void *chase_buffer = buffer.address;
+
+    struct histogram latency_picoseconds_histogram;
+
+    printf("Pointer chasing result: \n\t%s: %ld bytes\n\t%s: %d\n", "Granularity", granularity_bytes,
+           "Number of experiments per working set", POINTER_CHASE_EXPERIMENTS);
+    printf("level,footprint_bytes,span_bytes,median_ns_per_access,p99_ns_per_access\n");
 
-    // Vector were times will be stored
-    long long l2_load_cost_nanoseconds[NUMBER_OF_EXPERIMENTS];
+    // Footprints to measure: 3/4 of each cache level and 4 times the last level (DRAM), or the sweep sizes
+    long footprints[MAX_CACHE_LEVELS + 1];
+    int number_of_footprints = 0;
+    if (!sweep) {
+        for (int i = 0; i < topology->number_of_levels; ++i)
+            footprints[number_of_footprints++] = topology->levels[i].size_bytes * 3 / 4;
+        footprints[number_of_footprints++] = SWEEP_LLC_FACTOR * cache_topology_last_level_size(topology);
+    }
+
+    for (int step = 0;; ++step) {
+        long footprint_bytes;
+        if (sweep) {
+            footprint_bytes = ((long) SWEEP_MIN_SIZE_BYTES << (step / SWEEP_STEPS_PER_DOUBLING)) *
+                              (SWEEP_STEPS_PER_DOUBLING + step % SWEEP_STEPS_PER_DOUBLING) / SWEEP_STEPS_PER_DOUBLING;
+        } else {
+            if (step == number_of_footprints)
+                break;
+            footprint_bytes = footprints[step];
+        }
+
+        long span_bytes = footprint_bytes * span_per_footprint;
+        span_bytes -= span_bytes % granularity_bytes;
+        if (span_bytes > max_size_bytes) {
+            if (!sweep)
+                printf("# footprint of %ld bytes skipped, it needs a buffer bigger than %ld bytes\n",
+                       footprint_bytes, max_size_bytes);
+            if (sweep)
+                break;
+            continue;
+        }
+
+        histogram_init(&latency_picoseconds_histogram);
+        measure_chase_latency(chase_buffer, span_bytes, granularity_bytes, line_size_bytes,
+                              &latency_picoseconds_histogram);
+
+        printf("%s,%ld,%ld,%.3f,%.3f\n", working_set_level(topology, footprint_bytes), footprint_bytes, span_bytes,
+               (double) histogram_percentile(&latency_picoseconds_histogram, 50.0) / 1000.0,
+               (double) histogram_percentile(&latency_picoseconds_histogram, 99.0) / 1000.0);
+    }
+
+    test_buffer_free(&buffer);
+}
+
+void measure_tlb(const struct cache_topology *topology, long max_pages, enum buffer_type buffer_type) {
+    /***
+     * Separate the TLB refill from the data refill: a chain that visits one line of each page (page stride) needs one
+     * TLB entry per access, while a chain over the same number of lines packed contiguously (line stride) has the
+     * same data footprint but needs one entry each page worth of lines. The difference of their latencies is the
+     * cost of the TLB misses (page walks)
+     * The stride is always the base page, so with huge pages the same chains are covered by fewer TLB entries
+     */
+
+    int line_size_bytes = topology->line_size_bytes;
+
+    struct test_buffer buffer;
+    test_buffer_allocate(&buffer, buffer_type, max_pages * PAGE_SIZE_BYTES);
+    test_buffer_print(&buffer);
+
+    struct histogram page_stride_histogram, line_stride_histogram;
+
+    printf("TLB result: \n\t%s: %d bytes\n\t%s: %d\n", "Stride", PAGE_SIZE_BYTES,
+           "Number of experiments per chain", POINTER_CHASE_EXPERIMENTS);
+    printf("pages,footprint_bytes,level,page_stride_ns_per_access,line_stride_ns_per_access,tlb_refill_ns\n");
+
+    for (long pages = TLB_MIN_PAGES; pages <= max_pages; pages *= 2) {
+        long footprint_bytes = pages * line_size_bytes;
+
+        histogram_init(&page_stride_histogram);
+        measure_chase_latency(buffer.address, pages * PAGE_SIZE_BYTES, PAGE_SIZE_BYTES, line_size_bytes,
+                              &page_stride_histogram);
+
+        histogram_init(&line_stride_histogram);
+        measure_chase_latency(buffer.address, footprint_bytes, line_size_bytes, line_size_bytes,
+                              &line_stride_histogram);
+
+        long long page_stride_ps = histogram_percentile(&page_stride_histogram, 50.0);
+        long long line_stride_ps = histogram_percentile(&line_stride_histogram, 50.0);
+        printf("%ld,%ld,%s,%.3f,%.3f,%.3f\n", pages, footprint_bytes, working_set_level(topology, footprint_bytes),
+               (double) page_stride_ps / 1000.0, (double) line_stride_ps / 1000.0,
+               (double) (page_stride_ps - line_stride_ps) / 1000.0);
+    }
+
+    test_buffer_free(&buffer);
+}
+
+void print_usage(const char *program_name) {
+    printf("Usage: %s [-n experiments] [-k kernel|auto|all] [-e flush|buffer|module] [-s] [-p line|page] "
+           "[-m max_size_bytes] [-c]\n"
+           "       [-b stack|4k|2m|1g|thp] [-t] [-P] [-O path_prefix] [-r file] [-i] [-L mode:cpu[,cpu...]]\n"
+           "\t-n: number of experiments (%d by default)\n"
+           "\t-k: kernel used to read the vector (64_bits by default), auto selects the widest SIMD load supported\n"
+           "\t    and all runs the benchmark with every supported kernel\n"
+           "\t-e: method used to evict the vector from the cache (flush by default)\n"
+           "\t    flush: flush each line of the vector (clflushopt/clflush or DC CIVAC)\n"
+           "\t    buffer: read a buffer of twice the size of the last level cache\n"
+           "\t    module: use the clear_cache kernel module (/dev/clear_cache) and wait one second\n"
+           "\t-s: sweep mode, measure the read latency and bandwidth of working sets from %d bytes up to %d times the\n"
+           "\t    last level cache\n"
+           "\t-p: pointer chasing mode, measure the latency of dependent loads following a random cycle over the\n"
+           "\t    lines or the pages of a buffer, for each memory level (or for each size of the sweep if -s is given)\n"
+           "\t-t: TLB mode, measure the latency of a chain over one line of each page and of a chain over the same\n"
+           "\t    number of contiguous lines, from %d up to %d pages (or -m bytes), to separate the TLB refill\n"
+           "\t-m: maximum working set size of the sweep mode and maximum buffer size of the pointer chasing mode\n"
+           "\t    (by default the span of %d times the last level cache, capped to 1/%d of the physical memory)\n"
+           "\t-c: read the performance counters around each read of the evicted vector and report their mean deltas\n"
+           "\t    by latency\n"
+           "\t-b: memory of the buffers (stack by default, the mapped buffers of the other modes and vectors\n"
+           "\t    bigger than %d bytes use 4k then)\n"
+           "\t    stack: array in the stack, 4k: base pages, 2m and 1g: hugetlbfs pages (they must be reserved)\n"
+           "\t    thp: transparent huge pages (madvise)\n"
+           "\t-P: also measure the refill of the evicted vector after filling the cache with clean lines (reading a\n"
+           "\t    buffer of the size of the L2) and with dirty lines (writing it), side by side\n"
+           "\t-O: write the overhead profile (fill cost of each kernel) with the metadata of the host to\n"
+           "\t    path_prefix.json and path_prefix.bin\n"
+           "\t-r: write the raw fill costs of each kernel and the configuration of the run to a result file (see\n"
+           "\t    common/result_file.h), to compare runs with compare_results. It can't be used with -t, -p or -s\n"
+           "\t-i: apply a low noise setup to the tested core during the run (IRQs, frequency, C-states, RT\n"
+           "\t    throttling and THP, see common/preflight.h), it needs root and the settings are restored at exit\n",
+           program_name, NUMBER_OF_EXPERIMENTS, SWEEP_MIN_SIZE_BYTES, SWEEP_LLC_FACTOR, TLB_MIN_PAGES, TLB_MAX_PAGES,
+           SWEEP_LLC_FACTOR, POINTER_CHASE_MEMORY_DIVISOR, STACK_FILL_VECTOR_MAX_BYTES);
+    printf("%s", interference_usage);
+    fill_kernels_print();
+}
+
+int main(int argc, char *argv[]) {
+    bool sweep = false;
+    long sweep_max_size_bytes = 0;
+    long number_of_experiments = NUMBER_OF_EXPERIMENTS;
+    enum cache_eviction_method eviction_method = CACHE_EVICTION_FLUSH;
+    const char *kernel_name = "64_bits";
+    long pointer_chase_granularity_bytes = 0;
+    bool use_perf_counters = false;
+    bool tlb = false;
+    bool pollution = false;
+    const char *overhead_profile_path = NULL;
+    static struct overhead_profile overhead_profile;
+    const char *result_file_path = NULL;
+    bool low_noise_setup = false;
+    static struct preflight_report preflight_report;
+    enum buffer_type buffer_type = BUFFER_STACK;
+    static struct interference interference;
+
+    int option;
+    while ((option = getopt(argc, argv, "n:k:e:sp:m:cL:b:tPO:r:ih")) != -1) {
+        switch (option) {
+            case 'c':
+                use_perf_counters = true;
+                break;
+            case 'b':
+                if (!buffer_type_from_name(optarg, &buffer_type)) {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            case 't':
+                tlb = true;
+                break;
+            case 'P':
+                pollution = true;
+                break;
+            case 'O':
+                overhead_profile_path = optarg;
+                break;
+            case 'r':
+                result_file_path = optarg;
+                break;
+            case 'i':
+                low_noise_setup = true;
+                break;
+            case 'L':
+                if (!interference_add(&interference, optarg)) {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            case 'p':
+                if (strcmp(optarg, "line") == 0) {
+                    pointer_chase_granularity_bytes = -1; // Set when the line size is known
+                } else if (strcmp(optarg, "page") == 0) {
+                    pointer_chase_granularity_bytes = PAGE_SIZE_BYTES;
+                } else {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            case 'k':
+                kernel_name = optarg;
+                break;
+            case 'n':
+                number_of_experiments = strtol(optarg, NULL, 0);
+                break;
+            case 'e':
+                if (!cache_eviction_method_from_name(optarg, &eviction_method)) {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            case 's':
+                sweep = true;
+                break;
+            case 'm':
+                sweep_max_size_bytes = strtol(optarg, NULL, 0);
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(option == 'h' ? 0 : -1);
+        }
+    }
+
+    // Only the default mode records the raw fill costs
+    if (result_file_path != NULL && (tlb || pointer_chase_granularity_bytes || sweep)) {
+        fprintf(stderr, "the -r option can't be used in the TLB, pointer chasing and sweep modes\n");
+        exit(-1);
+    }
+
+    // Select the kernels to run
+    const struct fill_kernel *kernels_to_run[NUMBER_OF_FILL_KERNELS];
+    int number_of_kernels = 0;
+    if (strcmp(kernel_name, "all") == 0) {
+        for (const struct fill_kernel *kernel = fill_kernels; kernel->name != NULL; ++kernel) {
+            if (kernel->available())
+                kernels_to_run[number_of_kernels++] = kernel;
+        }
+    } else {
+        kernels_to_run[0] = fill_kernel_select(kernel_name);
+        if (kernels_to_run[0] == NULL) {
+            fprintf(stderr, "kernel %s doesn't exist or isn't supported by the CPU\n", kernel_name);
+            fill_kernels_print();
+            exit(-1);
+        }
+        number_of_kernels = 1;
+    }
+
+    // Detect the cache hierarchy of the core to test
+    struct cache_topology topology;
+    cache_topology_detect(CORE_TO_TEST, &topology);
+
+    // Select and calibrate the timer
+    timer_init();
+
+    // Check the settings of the core to test
+    cpu_set_t mask_cpu;
+    CPU_ZERO(&mask_cpu);
+    CPU_SET(CORE_TO_TEST, &mask_cpu);
+    preflight_check(&mask_cpu, &preflight_report);
+    if (low_noise_setup)
+        preflight_apply(&mask_cpu);
 
     // Set max priority for the thread
     // The sched fifo policy avoid involuntary preemption
@@ -96,77 +550,210 @@ int main() {
     }
 
     // Set sched affinity to some CPU
-    cpu_set_t mask_cpu;
-    CPU_ZERO(&mask_cpu);
-    CPU_SET(CORE_TO_TEST, &mask_cpu);
     if (sched_setaffinity(0, sizeof(cpu_set_t), &mask_cpu)) {
         perror("setaffinity failed");
         exit(-1);
     }
 
-    // Execute experiments
-    for (int j = 0; j < NUMBER_OF_EXPERIMENTS; ++j) {
-        // Fill L2 level cache
-        read_from_vector_64_bits(l2_fill_vector, &l2_fill_vector[(L2_CACHE_SIZE_BYTES / (2 * 8)) - 1]);
+    cache_topology_print(&topology);
+    timer_print_info();
 
-        // Cost of load vector stored in L2Cache
-        clock_gettime(CLOCK_MONOTONIC, &(local_time_measure_after));
-        read_from_vector_64_bits(l2_fill_vector, &l2_fill_vector[(L2_CACHE_SIZE_BYTES / (2 * 8)) - 1]);
-        clock_gettime(CLOCK_MONOTONIC, &(local_time_measure_before));
+    // Start sampling with the frequency of the core to test stable
+    preflight_warm_up(&mask_cpu);
 
-        // Operation time calculation
-        timespec_subtract(&result, &(local_time_measure_before), &(local_time_measure_after));
-        cached_vector_operation_time = result.tv_sec * 1000000000L + result.tv_nsec;
+    // The stack can't hold the buffers of the other modes
+    enum buffer_type mapped_buffer_type = buffer_type == BUFFER_STACK ? BUFFER_BASE_PAGES : buffer_type;
 
-        // Clean cache
-        manual_clear_cache();
+    if (tlb) {
+        measure_tlb(&topology, sweep_max_size_bytes > 0 ? sweep_max_size_bytes / PAGE_SIZE_BYTES : TLB_MAX_PAGES,
+                    mapped_buffer_type);
+    } else if (pointer_chase_granularity_bytes) {
+        if (pointer_chase_granularity_bytes < 0)
+            pointer_chase_granularity_bytes = topology.line_size_bytes;
+        if (sweep_max_size_bytes <= 0) {
+            sweep_max_size_bytes = SWEEP_LLC_FACTOR * cache_topology_last_level_size(&topology) *
+                                   (pointer_chase_granularity_bytes / topology.line_size_bytes);
 
-        // Cost of load vector not stored in L2Cache
-        clock_gettime(CLOCK_MONOTONIC, &(local_time_measure_after));
-        read_from_vector_64_bits(l2_fill_vector, &l2_fill_vector[(L2_CACHE_SIZE_BYTES / (2 * 8)) - 1]);
-        clock_gettime(CLOCK_MONOTONIC, &(local_time_measure_before));
+            long memory_cap_bytes = sysconf(_SC_PHYS_PAGES) / POINTER_CHASE_MEMORY_DIVISOR * sysconf(_SC_PAGESIZE);
+            if (memory_cap_bytes > 0 && sweep_max_size_bytes > memory_cap_bytes) {
+                printf("# buffer of %ld bytes capped to %ld bytes (1/%d of the physical memory), use -m to change it\n",
+                       sweep_max_size_bytes, memory_cap_bytes, POINTER_CHASE_MEMORY_DIVISOR);
+                sweep_max_size_bytes = memory_cap_bytes;
+            }
+        }
 
-        // Operation time calculation
-        timespec_subtract(&result, &(local_time_measure_before), &(local_time_measure_after));
-        not_cached_vector_operation_time = result.tv_sec * 1000000000L + result.tv_nsec;
+        measure_latency(&topology, pointer_chase_granularity_bytes, sweep_max_size_bytes, sweep, mapped_buffer_type);
+    } else if (sweep) {
+        if (sweep_max_size_bytes <= 0)
+            sweep_max_size_bytes = SWEEP_LLC_FACTOR * cache_topology_last_level_size(&topology);
 
-        // Store experiment result
-        l2_load_cost_nanoseconds[j] = not_cached_vector_operation_time - cached_vector_operation_time;
-    }
+        for (int k = 0; k < number_of_kernels; ++k) {
+            printf("Kernel: %s\n", kernels_to_run[k]->name);
+            measure_sweep(&topology, sweep_max_size_bytes, kernels_to_run[k]->function, mapped_buffer_type);
+        }
+    } else {
+        // Variable with the size of half L2 cache (or of the last level if there isn't L2)
+        // As other programs can be executing concurrently, only half cache will be used for the tests.
+        // This will correspond to half of the lines each set has
+        long l2_cache_size_bytes = cache_topology_level_size(&topology, 2);
+        if (l2_cache_size_bytes == 0)
+            l2_cache_size_bytes = cache_topology_last_level_size(&topology);
 
-    // Unlock pages
-    if (munlockall())
-        perror("munlockall failed");
+        long l2_fill_vector_length = ((l2_cache_size_bytes / 2) & ~63L) / 8;
+        long l2_fill_vector_bytes = l2_fill_vector_length * (long) sizeof(int64_t);
+        if (buffer_type == BUFFER_STACK && l2_fill_vector_bytes > STACK_FILL_VECTOR_MAX_BYTES) {
+            printf("# vector of %ld bytes mapped with 4k pages, the stack holds up to %d bytes\n",
+                   l2_fill_vector_bytes, STACK_FILL_VECTOR_MAX_BYTES);
+            buffer_type = BUFFER_BASE_PAGES;
+        }
+        int64_t stack_fill_vector[buffer_type == BUFFER_STACK ? l2_fill_vector_length : 1] __attribute__((aligned(64)));
+        int64_t *l2_fill_vector = stack_fill_vector;
 
-    // Analyze result
-    long long min_l2_fill_cost_nanoseconds, max_l2_fill_cost_nanoseconds, avg_l2_fill_cost_nanoseconds;
+        // The vector can also be mapped with the selected page size
+        struct test_buffer fill_buffer;
+        if (buffer_type != BUFFER_STACK) {
+            test_buffer_allocate(&fill_buffer, buffer_type, l2_fill_vector_length * (long) sizeof(int64_t));
+            test_buffer_print(&fill_buffer);
+            l2_fill_vector = fill_buffer.address;
+        }
 
-    // Max calculation
-    max_l2_fill_cost_nanoseconds = 0;
-    for (int i = 0; i < NUMBER_OF_EXPERIMENTS; ++i) {
-        if (max_l2_fill_cost_nanoseconds < l2_load_cost_nanoseconds[i])
-            max_l2_fill_cost_nanoseconds = l2_load_cost_nanoseconds[i];
-    }
+        // Prepare the eviction of the vector and check that it works (the module method only cleans the cache, and
+        // waits one second per eviction, so it isn't checked)
+        struct cache_eviction eviction;
+        cache_eviction_init(&eviction, &topology, eviction_method);
+        if (eviction.method != CACHE_EVICTION_MODULE)
+            cache_eviction_verify(&eviction, l2_fill_vector, l2_fill_vector_length * (long) sizeof(int64_t));
 
-    // Min calculation
-    min_l2_fill_cost_nanoseconds = max_l2_fill_cost_nanoseconds;
-    for (int i = 0; i < NUMBER_OF_EXPERIMENTS; ++i) {
-        if (min_l2_fill_cost_nanoseconds > l2_load_cost_nanoseconds[i])
-            min_l2_fill_cost_nanoseconds = l2_load_cost_nanoseconds[i];
-    }
+        if (overhead_profile_path != NULL) {
+            overhead_profile_init(&overhead_profile, "l2_cache_fill_cost", CORE_TO_TEST);
+            overhead_profile_add_config(&overhead_profile, "experiments", "%ld", number_of_experiments);
+            overhead_profile_add_config(&overhead_profile, "eviction", "%s",
+                                        cache_eviction_method_name(eviction.method));
+            overhead_profile_add_config(&overhead_profile, "buffer", "%s", buffer_type_name(buffer_type));
+            overhead_profile_add_config(&overhead_profile, "antagonists", "%d", interference.number_of_threads);
+        }
 
-    // Avg calculation (Warning: If NUMBER_OF_EXPERIMENTS or the fill cost is very high, there can be an integer
-    // overflow in the variable avg_preemption_cost_nanoseconds)
-    avg_l2_fill_cost_nanoseconds = 0;
-    for (int i = 0; i < NUMBER_OF_EXPERIMENTS; ++i) {
-        avg_l2_fill_cost_nanoseconds += l2_load_cost_nanoseconds[i];
+        // Raw fill costs of each kernel
+        static struct result_series fill_series[NUMBER_OF_FILL_KERNELS];
+        for (int k = 0; k < number_of_kernels && result_file_path != NULL; ++k) {
+            char series_name[32];
+            snprintf(series_name, sizeof(series_name), "fill_%s", kernels_to_run[k]->name);
+            result_series_init(&fill_series[k], series_name, number_of_experiments);
+        }
+
+        // Histograms where the results will be stored
+        static struct histogram l2_load_cost_histogram, not_cached_histogram;
+        static struct histogram idle_l2_load_cost_histogram, idle_not_cached_histogram;
+        static struct histogram clean_pollution_histogram, dirty_pollution_histogram;
+
+        // Buffer written or read to fill the cache with dirty or clean lines before the refill
+        struct test_buffer pollution_buffer;
+        if (pollution)
+            test_buffer_allocate(&pollution_buffer, mapped_buffer_type, l2_cache_size_bytes & ~63L);
+
+        // Counters of the reads of the evicted vector
+        static struct perf_counters perf_counters;
+        static struct perf_attribution not_cached_attribution;
+        if (use_perf_counters) {
+            perf_counters_open(&perf_counters);
+            perf_counters_print_info(&perf_counters);
+        }
+
+        for (int k = 0; k < number_of_kernels; ++k) {
+            histogram_init(&l2_load_cost_histogram);
+            histogram_init(&not_cached_histogram);
+            perf_attribution_init(&not_cached_attribution);
+
+            // With antagonists, the costs are measured idle first and then under interference
+            if (interference.number_of_threads) {
+                histogram_init(&idle_l2_load_cost_histogram);
+                histogram_init(&idle_not_cached_histogram);
+                measure_fill_cost(l2_fill_vector, l2_fill_vector_length, kernels_to_run[k]->function, &eviction,
+                                  number_of_experiments, &idle_l2_load_cost_histogram, &idle_not_cached_histogram,
+                                  NULL, NULL, NULL);
+                interference_start(&interference);
+            }
+
+            measure_fill_cost(l2_fill_vector, l2_fill_vector_length, kernels_to_run[k]->function, &eviction,
+                              number_of_experiments, &l2_load_cost_histogram, &not_cached_histogram,
+                              use_perf_counters ? &perf_counters : NULL, &not_cached_attribution,
+                              result_file_path != NULL ? &fill_series[k] : NULL);
+
+            if (interference.number_of_threads)
+                interference_stop(&interference);
+
+            // Print result
+            long long not_cached_median_ns = histogram_percentile(&not_cached_histogram, 50.0);
+            printf("Kernel: %s\n", kernels_to_run[k]->name);
+            histogram_print(&l2_load_cost_histogram, "fill half l2 cache");
+            printf("\t%s: %lld ns\n\t%s: %.1f MB/s\n",
+                   "Median time to read the vector when it isn't cached", not_cached_median_ns,
+                   "Median refill bandwidth", not_cached_median_ns > 0 ?
+                   (double) (l2_fill_vector_length * (long) sizeof(int64_t)) * 1000.0 / (double) not_cached_median_ns :
+                   0.0);
+
+            if (use_perf_counters)
+                perf_attribution_print(&not_cached_attribution, &perf_counters, "read the evicted vector");
+
+            if (interference.number_of_threads) {
+                interference_print(&interference);
+                interference_print_comparison("fill half l2 cache", &idle_l2_load_cost_histogram,
+                                              &l2_load_cost_histogram);
+                interference_print_comparison("read the evicted vector", &idle_not_cached_histogram,
+                                              &not_cached_histogram);
+            }
+
+            if (overhead_profile_path != NULL)
+                overhead_profile_add(&overhead_profile, OVERHEAD_CACHE_REFILL, CORE_TO_TEST, -1,
+                                     l2_fill_vector_length * (long) sizeof(int64_t), kernels_to_run[k]->name,
+                                     &l2_load_cost_histogram);
+
+            if (pollution) {
+                histogram_init(&clean_pollution_histogram);
+                histogram_init(&dirty_pollution_histogram);
+                measure_pollution_cost(l2_fill_vector, l2_fill_vector_length, kernels_to_run[k]->function, &eviction,
+                                       pollution_buffer.address, pollution_buffer.size_bytes / (long) sizeof(int64_t),
+                                       number_of_experiments, &clean_pollution_histogram, &dirty_pollution_histogram);
+                print_pollution_cost(l2_fill_vector_length * (long) sizeof(int64_t), pollution_buffer.size_bytes,
+                                     &clean_pollution_histogram, &dirty_pollution_histogram);
+            }
+        }
+
+        if (use_perf_counters)
+            perf_counters_close(&perf_counters);
+        cache_eviction_destroy(&eviction);
+        if (buffer_type != BUFFER_STACK)
+            test_buffer_free(&fill_buffer);
+        if (pollution)
+            test_buffer_free(&pollution_buffer);
+        if (overhead_profile_path != NULL) {
+            overhead_profile_write(&overhead_profile, overhead_profile_path);
+            overhead_profile_free(&overhead_profile);
+        }
+        if (result_file_path != NULL) {
+            char antagonists[RESULT_FILE_CONFIG_VALUE_BYTES];
+            interference_describe(&interference, antagonists, sizeof(antagonists));
+
+            struct result_config result_config = {0};
+            result_config_add(&result_config, "mode", "fill");
+            result_config_add(&result_config, "core", "%d", CORE_TO_TEST);
+            result_config_add(&result_config, "experiments", "%ld", number_of_experiments);
+            result_config_add(&result_config, "vector_bytes", "%ld", l2_fill_vector_length * (long) sizeof(int64_t));
+            result_config_add(&result_config, "eviction", "%s", cache_eviction_method_name(eviction.method));
+            result_config_add(&result_config, "buffer", "%s", buffer_type_name(buffer_type));
+            result_config_add(&result_config, "antagonists", "%s", antagonists);
+            result_config_add(&result_config, "perf_counters", "%d", use_perf_counters);
+            result_config_add(&result_config, "low_noise_setup", "%d", low_noise_setup);
+
+            result_file_write(result_file_path, "l2_cache_fill_cost", &result_config, fill_series, number_of_kernels);
+            for (int k = 0; k < number_of_kernels; ++k)
+                result_series_destroy(&fill_series[k]);
+        }
     }
-    avg_l2_fill_cost_nanoseconds = avg_l2_fill_cost_nanoseconds / NUMBER_OF_EXPERIMENTS;
 
-    // Print result
-    printf("Experiment result: \n\t%s: %d\n\t%s: %lld ns\n\t%s: %lld ns\n\t%s: %lld ns\n",
-           "Number of experiments", NUMBER_OF_EXPERIMENTS,
-           "Minimum cost of fill half l2 cache", min_l2_fill_cost_nanoseconds,
-           "Maximum cost of fill half l2 cache", max_l2_fill_cost_nanoseconds,
-           "Average cost of fill half l2 cache", avg_l2_fill_cost_nanoseconds);
+    // Unlock pages
+    if (munlockall())
+        perror("munlockall failed");
+
+    return 0;
 }
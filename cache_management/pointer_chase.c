@@ -0,0 +1,72 @@
+//
+// Dependent pointer chasing over a buffer, used to measure the load latency without the help of the prefetchers
+//
+#include "pointer_chase.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Seed of the permutation, fixed so all the runs walk the buffer in the same order
+#define POINTER_CHASE_SEED 0x9e3779b97f4a7c15ULL
+
+static uint64_t next_random(uint64_t *state) {
+    /***
+     * xorshift64* generator
+     */
+
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545f4914f6cdd1dULL;
+}
+
+static void **slot_pointer(void *buffer, long slot, long granularity_bytes, int line_size_bytes) {
+    /***
+     * Get the address of the pointer stored in slot
+     */
+
+    long lines_per_slot = granularity_bytes / line_size_bytes;
+    long offset = lines_per_slot > 1 ? (slot % lines_per_slot) * line_size_bytes : 0;
+
+    return (void **) ((char *) buffer + slot * granularity_bytes + offset);
+}
+
+long pointer_chase_build(void *buffer, long size_bytes, long granularity_bytes, int line_size_bytes) {
+    long number_of_slots = size_bytes / granularity_bytes;
+    if (number_of_slots < 1) {
+        fprintf(stderr, "the pointer chase buffer is smaller than its granularity\n");
+        exit(-1);
+    }
+
+    long *order = malloc(number_of_slots * sizeof(long));
+    if (order == NULL) {
+        perror("malloc failed");
+        exit(-1);
+    }
+
+    // Sattolo's algorithm, generates a random permutation with a single cycle
+    for (long i = 0; i < number_of_slots; ++i)
+        order[i] = i;
+
+    uint64_t random_state = POINTER_CHASE_SEED;
+    for (long i = number_of_slots - 1; i > 0; --i) {
+        long j = (long) (next_random(&random_state) % (uint64_t) i);
+        long swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+
+    // Each slot points to the next one of the cycle, order[i] being the successor of slot i
+    for (long i = 0; i < number_of_slots; ++i) {
+        *slot_pointer(buffer, i, granularity_bytes, line_size_bytes) =
+                slot_pointer(buffer, order[i], granularity_bytes, line_size_bytes);
+    }
+
+    free(order);
+    return number_of_slots;
+}
+
+void **pointer_chase_start(void *buffer) {
+    return (void **) buffer;
+}
@@ -0,0 +1,18 @@
+//
+// Dependent pointer chasing over a buffer, used to measure the load latency without the help of the prefetchers
+//
+#ifndef POINTER_CHASE_H
+#define POINTER_CHASE_H
+
+// Follow count pointers of the chain starting at start (implemented in l2_cache_fill.<architecture>.S)
+extern void *chase_pointers(void **start, long count);
+
+// Build in buffer a random cyclic chain that visits each granularity_bytes slot of the first size_bytes exactly once.
+// Inside each slot, the pointer is placed at a different line_size_bytes offset, so the slots don't map to the same
+// cache sets. Return the number of slots of the chain
+long pointer_chase_build(void *buffer, long size_bytes, long granularity_bytes, int line_size_bytes);
+
+// Get the first pointer of the chain built in buffer
+void **pointer_chase_start(void *buffer);
+
+#endif // POINTER_CHASE_H
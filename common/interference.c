@@ -0,0 +1,336 @@
+//
+// Antagonist threads that load the machine while a benchmark measures
+//
+#define _GNU_SOURCE
+
+#include "interference.h"
+#include "../cache_management/cache_topology.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <limits.h>
+#include <time.h>
+
+// Size of each copy of the bandwidth mode, and number of accesses of the other modes between two checks of the stop
+// flag
+#define BANDWIDTH_CHUNK_BYTES (1024 * 1024)
+#define ACCESSES_PER_CHECK 4096
+
+const char *interference_usage =
+        "\t-L: run antagonist threads pinned to the given CPUs while measuring (it can be repeated), the costs are\n"
+        "\t    measured idle first and printed next to the loaded ones. Format mode:cpu[,cpu...], modes:\n"
+        "\t    bandwidth: streaming copies of a buffer 8 times the last level cache\n"
+        "\t    llc: random writes to the lines of a buffer of the size of the last level cache\n"
+        "\t    ipi: page write protections that send TLB shootdown IPIs to the cores of the process\n"
+        "\t    fork: process creation (posix_spawn of /bin/true)\n";
+
+static const char *mode_names[] = {"bandwidth", "llc", "ipi", "fork"};
+
+static void *bandwidth_execution(struct interference_thread *antagonist) {
+    /***
+     * Copy the first half of the buffer to the second one and back, in chunks
+     */
+
+    long half_bytes = antagonist->buffer_bytes / 2;
+
+    while (!*(antagonist->stop)) {
+        for (long offset = 0; offset < half_bytes && !*(antagonist->stop); offset += BANDWIDTH_CHUNK_BYTES) {
+            long chunk_bytes = half_bytes - offset < BANDWIDTH_CHUNK_BYTES ?
+                               half_bytes - offset : BANDWIDTH_CHUNK_BYTES;
+            memcpy(antagonist->buffer + half_bytes + offset, antagonist->buffer + offset, chunk_bytes);
+            antagonist->iterations += chunk_bytes;
+        }
+        for (long offset = 0; offset < half_bytes && !*(antagonist->stop); offset += BANDWIDTH_CHUNK_BYTES) {
+            long chunk_bytes = half_bytes - offset < BANDWIDTH_CHUNK_BYTES ?
+                               half_bytes - offset : BANDWIDTH_CHUNK_BYTES;
+            memcpy(antagonist->buffer + offset, antagonist->buffer + half_bytes + offset, chunk_bytes);
+            antagonist->iterations += chunk_bytes;
+        }
+    }
+
+    return NULL;
+}
+
+static void *llc_execution(struct interference_thread *antagonist) {
+    /***
+     * Increment a random line of the buffer, so the last level cache is filled with dirty lines of the antagonist
+     */
+
+    long number_of_lines = antagonist->buffer_bytes / 64;
+    uint64_t random_state = 0x9E3779B97F4A7C15ULL ^ (uint64_t) antagonist->cpu;
+
+    while (!*(antagonist->stop)) {
+        for (int i = 0; i < ACCESSES_PER_CHECK; ++i) {
+            // xorshift64
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 7;
+            random_state ^= random_state << 17;
+
+            antagonist->buffer[(random_state % number_of_lines) * 64]++;
+        }
+        antagonist->iterations += ACCESSES_PER_CHECK;
+    }
+
+    return NULL;
+}
+
+static void *ipi_execution(struct interference_thread *antagonist) {
+    /***
+     * Write a page and remove its write permission. Reducing the permissions flushes its translation in all the cores
+     * that run threads of this process, with an IPI to each of them (the page can't be discarded as the memory of the
+     * benchmarks is locked)
+     */
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    char *page = antagonist->buffer;
+
+    while (!*(antagonist->stop)) {
+        for (int i = 0; i < ACCESSES_PER_CHECK / 64; ++i) {
+            page[0] = 1;
+            if (mprotect(page, page_size, PROT_READ) || mprotect(page, page_size, PROT_READ | PROT_WRITE)) {
+                perror("mprotect failed");
+                exit(-1);
+            }
+        }
+        antagonist->iterations += ACCESSES_PER_CHECK / 64;
+    }
+
+    return NULL;
+}
+
+static void *fork_execution(struct interference_thread *antagonist) {
+    /***
+     * Create processes that execute /bin/true and wait for them. They are spawned with posix_spawn (vfork semantics),
+     * a fork would write protect every private page of the benchmark for copy on write and the measuring threads
+     * would take the faults inside their measures
+     */
+
+    char *const arguments[] = {"true", NULL};
+
+    while (!*(antagonist->stop)) {
+        pid_t pid;
+        int error = posix_spawn(&pid, "/bin/true", NULL, NULL, arguments, environ);
+        if (error) {
+            fprintf(stderr, "posix_spawn failed: %s\n", strerror(error));
+            exit(-1);
+        }
+
+        waitpid(pid, NULL, 0);
+        antagonist->iterations++;
+    }
+
+    return NULL;
+}
+
+static void *antagonist_execution(void *data) {
+    struct interference_thread *antagonist = data;
+
+    switch (antagonist->mode) {
+        case INTERFERENCE_BANDWIDTH:
+            return bandwidth_execution(antagonist);
+        case INTERFERENCE_LLC:
+            return llc_execution(antagonist);
+        case INTERFERENCE_IPI:
+            return ipi_execution(antagonist);
+        case INTERFERENCE_FORK:
+            return fork_execution(antagonist);
+    }
+
+    return NULL;
+}
+
+void interference_init(struct interference *interference) {
+    memset(interference, 0, sizeof(struct interference));
+}
+
+bool interference_add(struct interference *interference, const char *description) {
+    const char *colon = strchr(description, ':');
+    if (colon == NULL)
+        return false;
+
+    int mode = -1;
+    for (int i = 0; i < (int) (sizeof(mode_names) / sizeof(mode_names[0])); ++i) {
+        if (strlen(mode_names[i]) == (size_t) (colon - description) &&
+            strncmp(description, mode_names[i], colon - description) == 0)
+            mode = i;
+    }
+    if (mode < 0)
+        return false;
+
+    const char *position = colon + 1;
+    while (*position) {
+        char *end;
+        long cpu = strtol(position, &end, 0);
+        if (end == position || cpu < 0 || cpu >= CPU_SETSIZE ||
+            interference->number_of_threads >= INTERFERENCE_MAX_THREADS)
+            return false;
+
+        struct interference_thread *antagonist = &(interference->threads[interference->number_of_threads++]);
+        antagonist->mode = mode;
+        antagonist->cpu = (int) cpu;
+
+        if (*end != ',')
+            break;
+        position = end + 1;
+    }
+
+    return true;
+}
+
+void interference_start(struct interference *interference) {
+    interference->stop = false;
+    interference->running = true;
+
+    for (int i = 0; i < interference->number_of_threads; ++i) {
+        struct interference_thread *antagonist = &(interference->threads[i]);
+        antagonist->stop = &(interference->stop);
+        antagonist->iterations = 0;
+
+        // Buffer of the antagonist, allocated by the main thread and touched so the load starts at once
+        struct cache_topology topology;
+        cache_topology_detect(antagonist->cpu, &topology);
+
+        switch (antagonist->mode) {
+            case INTERFERENCE_BANDWIDTH:
+                antagonist->buffer_bytes = INTERFERENCE_BANDWIDTH_LLC_FACTOR *
+                                           cache_topology_last_level_size(&topology);
+                break;
+            case INTERFERENCE_LLC:
+                antagonist->buffer_bytes = cache_topology_last_level_size(&topology);
+                break;
+            default:
+                antagonist->buffer_bytes = sysconf(_SC_PAGESIZE);
+        }
+
+        antagonist->buffer = mmap(NULL, antagonist->buffer_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                                  -1, 0);
+        if (antagonist->buffer == MAP_FAILED) {
+            perror("mmap failed");
+            exit(-1);
+        }
+        memset(antagonist->buffer, 1, antagonist->buffer_bytes);
+
+        // The antagonists use the normal scheduler, they load the other cores without competing with the real time
+        // threads of the benchmark
+        pthread_attr_t attr;
+        cpu_set_t affinity_mask;
+
+        if (pthread_attr_init(&attr)) {
+            perror("pthread init failed");
+            exit(-1);
+        }
+
+        if (pthread_attr_setstacksize(&attr, PTHREAD_STACK_MIN + 0x4000)) {
+            perror("pthread setstacksize failed");
+            exit(-1);
+        }
+
+        if (pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED)) {
+            perror("pthread setinheritsched failed");
+            exit(-1);
+        }
+
+        CPU_ZERO(&affinity_mask);
+        CPU_SET(antagonist->cpu, &affinity_mask);
+
+        if (pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &affinity_mask)) {
+            perror("pthread setaffinity failed");
+            exit(-1);
+        }
+
+        if (pthread_create(&(antagonist->thread), &attr, antagonist_execution, antagonist)) {
+            perror("thread creation failed");
+            exit(-1);
+        }
+    }
+
+    struct timespec warm_up = {0, INTERFERENCE_WARM_UP_MILLISECONDS * 1000000L};
+    nanosleep(&warm_up, NULL);
+
+    for (int i = 0; i < interference->number_of_threads; ++i)
+        interference->threads[i].warm_up_iterations = interference->threads[i].iterations;
+
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    interference->duration_ns = -(start_time.tv_sec * 1000000000LL + start_time.tv_nsec);
+}
+
+void interference_stop(struct interference *interference) {
+    if (!interference->running)
+        return;
+
+    struct timespec stop_time;
+    clock_gettime(CLOCK_MONOTONIC, &stop_time);
+    interference->duration_ns += stop_time.tv_sec * 1000000000LL + stop_time.tv_nsec;
+
+    interference->stop = true;
+    for (int i = 0; i < interference->number_of_threads; ++i) {
+        pthread_join(interference->threads[i].thread, NULL);
+        munmap(interference->threads[i].buffer, interference->threads[i].buffer_bytes);
+        interference->threads[i].buffer = NULL;
+    }
+
+    interference->running = false;
+}
+
+void interference_describe(const struct interference *interference, char *description, size_t size) {
+    if (size == 0)
+        return;
+
+    snprintf(description, size, "%s", interference->number_of_threads ? "" : "none");
+    for (int i = 0; i < interference->number_of_threads; ++i) {
+        size_t length = strlen(description);
+        snprintf(description + length, size - length, "%s%s:%d", i ? "," : "",
+                 mode_names[interference->threads[i].mode], interference->threads[i].cpu);
+    }
+}
+
+void interference_print(const struct interference *interference) {
+    static const char *units[] = {"MB/s copied", "lines written per second", "write protections per second",
+                                  "processes per second"};
+
+    double duration_seconds = (double) interference->duration_ns / 1e9;
+
+    printf("Interference: \n");
+    for (int i = 0; i < interference->number_of_threads; ++i) {
+        const struct interference_thread *antagonist = &(interference->threads[i]);
+        double rate = duration_seconds > 0 ?
+                      (double) (antagonist->iterations - antagonist->warm_up_iterations) / duration_seconds : 0.0;
+        if (antagonist->mode == INTERFERENCE_BANDWIDTH)
+            rate /= 1e6;
+
+        printf("\t%s on CPU %d: %.0f %s\n", mode_names[antagonist->mode], antagonist->cpu, rate,
+               units[antagonist->mode]);
+    }
+}
+
+void interference_print_comparison(const char *cost_name, const struct histogram *idle_histogram,
+                                   const struct histogram *loaded_histogram) {
+    static const double percentiles[] = {50.0, 90.0, 99.0, 99.9};
+
+    printf("Cost of %s idle and under interference: \n", cost_name);
+    printf("statistic,idle_ns,loaded_ns,loaded_to_idle_ratio\n");
+
+    long long idle_values[6], loaded_values[6];
+    const char *names[6] = {"min", "p50", "p90", "p99", "p99.9", "max"};
+
+    idle_values[0] = idle_histogram->min;
+    loaded_values[0] = loaded_histogram->min;
+    for (int i = 0; i < 4; ++i) {
+        idle_values[i + 1] = histogram_percentile(idle_histogram, percentiles[i]);
+        loaded_values[i + 1] = histogram_percentile(loaded_histogram, percentiles[i]);
+    }
+    idle_values[5] = idle_histogram->max;
+    loaded_values[5] = loaded_histogram->max;
+
+    for (int i = 0; i < 6; ++i) {
+        printf("%s,%lld,%lld,%.2f\n", names[i], idle_values[i], loaded_values[i],
+               idle_values[i] ? (double) loaded_values[i] / (double) idle_values[i] : 0.0);
+    }
+}
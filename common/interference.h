@@ -0,0 +1,90 @@
+//
+// Antagonist threads that load the machine while a benchmark measures
+//
+// Each antagonist is pinned to one core and runs one of these modes:
+//  - bandwidth: streaming copies over a buffer much larger than the last level cache
+//  - llc: random read-modify-writes of the lines of a buffer of the size of the last level cache
+//  - ipi: system calls that write protect pages of the process, so TLB shootdown IPIs are sent to the cores running it
+//  - fork: process creation in a loop (posix_spawn of /bin/true, so the pages of the benchmark aren't made copy on
+//    write)
+//
+#ifndef INTERFERENCE_H
+#define INTERFERENCE_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "statistics.h"
+
+#define INTERFERENCE_MAX_THREADS 64
+
+// The bandwidth buffer is INTERFERENCE_BANDWIDTH_LLC_FACTOR times the last level cache
+#define INTERFERENCE_BANDWIDTH_LLC_FACTOR 8
+
+// Time the antagonists run before the measures start
+#define INTERFERENCE_WARM_UP_MILLISECONDS 100
+
+enum interference_mode {
+    INTERFERENCE_BANDWIDTH,
+    INTERFERENCE_LLC,
+    INTERFERENCE_IPI,
+    INTERFERENCE_FORK
+};
+
+struct interference_thread {
+    enum interference_mode mode;
+    int cpu;
+    pthread_t thread;
+
+    // Buffer of the memory modes
+    char *buffer;
+    long buffer_bytes;
+
+    // Finished iterations of the antagonist loop (bytes copied, lines written, write protections or processes)
+    uint64_t iterations;
+
+    // Iterations finished when the warm up ended
+    uint64_t warm_up_iterations;
+
+    volatile bool *stop;
+};
+
+struct interference {
+    int number_of_threads;
+    struct interference_thread threads[INTERFERENCE_MAX_THREADS];
+
+    // Time the antagonists were running
+    long long duration_ns;
+
+    volatile bool stop;
+    bool running;
+};
+
+// Initialize an interference without antagonists
+void interference_init(struct interference *interference);
+
+// Add the antagonists described by "mode:cpu[,cpu...]", one per CPU. Return false if the description is not valid
+bool interference_add(struct interference *interference, const char *description);
+
+// Start the antagonists and wait until they are loading the machine
+void interference_start(struct interference *interference);
+
+// Stop the antagonists and release their buffers
+void interference_stop(struct interference *interference);
+
+// Write the antagonists as "mode:cpu,mode:cpu..." (or "none") in description, truncated to size bytes
+void interference_describe(const struct interference *interference, char *description, size_t size);
+
+// Print the antagonists and the load they generated
+void interference_print(const struct interference *interference);
+
+// Print a cost measured with the machine idle next to the same cost measured under interference
+void interference_print_comparison(const char *cost_name, const struct histogram *idle_histogram,
+                                   const struct histogram *loaded_histogram);
+
+// Usage of the interference option
+extern const char *interference_usage;
+
+#endif // INTERFERENCE_H
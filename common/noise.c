@@ -0,0 +1,289 @@
+//
+// Detection of the platform noise that hits the samples of the benchmarks
+//
+#define _GNU_SOURCE
+
+#include "noise.h"
+#include "timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+
+// Size of the buffer where the /proc files are read
+#define NOISE_PROC_BUFFER_BYTES (1024 * 1024)
+
+// Intel MSR_SMI_COUNT
+#define MSR_SMI_COUNT 0x34
+
+static int open_file(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open failed");
+        exit(-1);
+    }
+    return fd;
+}
+
+static void read_file(int fd, char *buffer) {
+    /***
+     * Read the whole file from its beginning
+     */
+
+    long length = 0;
+    for (;;) {
+        long read_bytes = pread(fd, buffer + length, NOISE_PROC_BUFFER_BYTES - 1 - length, length);
+        if (read_bytes <= 0)
+            break;
+        length += read_bytes;
+    }
+    buffer[length] = '\0';
+}
+
+static uint64_t sum_cpu_columns(const char *text, const cpu_set_t *cpus) {
+    /***
+     * Add the counts of the columns of the given CPUs of all the lines of /proc/interrupts or /proc/softirqs
+     * The first line is the header with the name of the CPU of each column, the next ones start with a label
+     */
+
+    int column_cpus[CPU_SETSIZE];
+    int number_of_columns = 0;
+
+    const char *position = text;
+    while (*position && *position != '\n') {
+        if (strncmp(position, "CPU", 3) == 0 && number_of_columns < CPU_SETSIZE) {
+            column_cpus[number_of_columns++] = (int) strtol(position + 3, NULL, 10);
+            position += 3;
+        } else {
+            position++;
+        }
+    }
+
+    uint64_t total = 0;
+    while (*position) {
+        // Skip the label of the line
+        const char *colon = strchr(position, ':');
+        const char *end_of_line = strchr(position, '\n');
+        if (colon == NULL)
+            break;
+        if (end_of_line == NULL)
+            end_of_line = position + strlen(position);
+
+        if (colon < end_of_line) {
+            position = colon + 1;
+
+            // Lines like ERR or MIS have a single count that isn't bound to a CPU
+            for (int column = 0; column < number_of_columns; ++column) {
+                char *end;
+                uint64_t count = strtoull(position, &end, 10);
+                if (end == position || end > end_of_line)
+                    break;
+                if (CPU_ISSET(column_cpus[column], cpus))
+                    total += count;
+                position = end;
+            }
+        }
+
+        position = *end_of_line ? end_of_line + 1 : end_of_line;
+    }
+
+    return total;
+}
+
+void noise_detector_init(struct noise_detector *detector, const cpu_set_t *cpus) {
+    memset(detector, 0, sizeof(struct noise_detector));
+    detector->cpus = *cpus;
+    detector->interrupts_fd = open_file("/proc/interrupts");
+    detector->softirqs_fd = open_file("/proc/softirqs");
+
+    detector->buffer = malloc(NOISE_PROC_BUFFER_BYTES);
+    if (detector->buffer == NULL) {
+        perror("malloc failed");
+        exit(-1);
+    }
+
+    // The SMI counter is only available in Intel processors and needs the msr module and root permissions
+    detector->msr_fd = -1;
+#if defined(__x86_64__)
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, cpus))
+            continue;
+
+        char path[64];
+        snprintf(path, sizeof(path), "/dev/cpu/%d/msr", cpu);
+        detector->msr_fd = open(path, O_RDONLY);
+
+        uint64_t smi_count;
+        if (detector->msr_fd >= 0 && pread(detector->msr_fd, &smi_count, sizeof(smi_count), MSR_SMI_COUNT) !=
+                                     sizeof(smi_count)) {
+            close(detector->msr_fd);
+            detector->msr_fd = -1;
+        }
+        break;
+    }
+#endif
+}
+
+void noise_detector_close(struct noise_detector *detector) {
+    close(detector->interrupts_fd);
+    close(detector->softirqs_fd);
+    if (detector->msr_fd >= 0)
+        close(detector->msr_fd);
+    free(detector->buffer);
+    detector->buffer = NULL;
+}
+
+void noise_detector_read(struct noise_detector *detector, struct noise_counts *counts) {
+    read_file(detector->interrupts_fd, detector->buffer);
+    counts->interrupts = sum_cpu_columns(detector->buffer, &(detector->cpus));
+
+    read_file(detector->softirqs_fd, detector->buffer);
+    counts->softirqs = sum_cpu_columns(detector->buffer, &(detector->cpus));
+
+    counts->smis = 0;
+    if (detector->msr_fd >= 0 && pread(detector->msr_fd, &(counts->smis), sizeof(counts->smis), MSR_SMI_COUNT) !=
+                                 sizeof(counts->smis))
+        counts->smis = 0;
+}
+
+bool noise_counts_contaminated(const struct noise_counts *before, const struct noise_counts *after) {
+    return after->interrupts != before->interrupts || after->softirqs != before->softirqs ||
+           after->smis != before->smis;
+}
+
+static void *hwlat_execution(void *data) {
+    /***
+     * Spin reading the timer in windows of NOISE_HWLAT_WINDOW_MICROSECONDS. The gaps of a window are unexplained if
+     * no interrupt, softirq or SMI was counted during it
+     */
+
+    struct hwlat_result *result = data;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(result->cpu, &cpus);
+
+    struct noise_detector detector;
+    noise_detector_init(&detector, &cpus);
+
+    long long threshold_ticks = (long long) (NOISE_HWLAT_THRESHOLD_NANOSECONDS / timer_ns_per_tick);
+    long long window_ticks = (long long) (NOISE_HWLAT_WINDOW_MICROSECONDS * 1000.0 / timer_ns_per_tick);
+    long number_of_windows = NOISE_HWLAT_DURATION_MILLISECONDS * 1000L / NOISE_HWLAT_WINDOW_MICROSECONDS;
+
+    struct noise_counts first_counts, before, after;
+    noise_detector_read(&detector, &first_counts);
+    after = first_counts;
+
+    for (long window = 0; window < number_of_windows; ++window) {
+        before = after;
+
+        long window_gaps = 0;
+        long long window_max_gap_ticks = 0;
+
+        uint64_t window_start = timer_read();
+        uint64_t previous_timestamp = window_start;
+        uint64_t timestamp = window_start;
+
+        while ((long long) (timestamp - window_start) < window_ticks) {
+            timestamp = timer_read();
+
+            long long gap_ticks = (long long) (timestamp - previous_timestamp);
+            if (gap_ticks > threshold_ticks) {
+                window_gaps++;
+                result->total_gap_ns += timer_ticks_to_ns(gap_ticks);
+                if (gap_ticks > window_max_gap_ticks)
+                    window_max_gap_ticks = gap_ticks;
+            }
+            previous_timestamp = timestamp;
+        }
+
+        noise_detector_read(&detector, &after);
+
+        long long window_max_gap_ns = timer_ticks_to_ns(window_max_gap_ticks);
+        result->number_of_gaps += window_gaps;
+        if (window_max_gap_ns > result->max_gap_ns)
+            result->max_gap_ns = window_max_gap_ns;
+
+        if (window_gaps && !noise_counts_contaminated(&before, &after)) {
+            result->unexplained_gaps += window_gaps;
+            if (window_max_gap_ns > result->max_unexplained_gap_ns)
+                result->max_unexplained_gap_ns = window_max_gap_ns;
+        }
+
+        result->duration_ns += timer_ticks_to_ns((long long) (timestamp - window_start));
+    }
+
+    result->smis = after.smis - first_counts.smis;
+    noise_detector_close(&detector);
+
+    return NULL;
+}
+
+void noise_hwlat_run(int cpu, struct hwlat_result *result) {
+    memset(result, 0, sizeof(struct hwlat_result));
+    result->cpu = cpu;
+
+    pthread_t thread;
+    pthread_attr_t attr;
+    struct sched_param param;
+    cpu_set_t affinity_mask;
+
+    if (pthread_attr_init(&attr)) {
+        perror("pthread init failed");
+        exit(-1);
+    }
+
+    if (pthread_attr_setstacksize(&attr, PTHREAD_STACK_MIN + 0x4000)) {
+        perror("pthread setstacksize failed");
+        exit(-1);
+    }
+
+    if (pthread_attr_setschedpolicy(&attr, SCHED_FIFO)) {
+        perror("pthread setschedpolicy failed");
+        exit(-1);
+    }
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+
+    if (pthread_attr_setschedparam(&attr, &param)) {
+        perror("pthread setschedparam failed");
+        exit(-1);
+    }
+
+    if (pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED)) {
+        perror("pthread setinheritsched failed");
+        exit(-1);
+    }
+
+    CPU_ZERO(&affinity_mask);
+    CPU_SET(cpu, &affinity_mask);
+
+    if (pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &affinity_mask)) {
+        perror("pthread setaffinity failed");
+        exit(-1);
+    }
+
+    if (pthread_create(&thread, &attr, hwlat_execution, result)) {
+        perror("thread creation failed");
+        exit(-1);
+    }
+
+    pthread_join(thread, NULL);
+}
+
+void noise_hwlat_print(const struct hwlat_result *result) {
+    printf("Platform noise: \n\t%s: %d\n\t%s: %lld ms\n\t%s: %d ns\n\t%s: %ld\n\t%s: %lld ns\n\t%s: %lld ns\n"
+           "\t%s: %ld\n\t%s: %lld ns\n\t%s: %llu\n",
+           "CPU", result->cpu,
+           "Spinning time", result->duration_ns / 1000000,
+           "Gap threshold", NOISE_HWLAT_THRESHOLD_NANOSECONDS,
+           "Number of gaps", result->number_of_gaps,
+           "Maximum gap", result->max_gap_ns,
+           "Total time lost in gaps", result->total_gap_ns,
+           "Gaps without interrupts (firmware or hypervisor)", result->unexplained_gaps,
+           "Maximum gap without interrupts", result->max_unexplained_gap_ns,
+           "SMIs", (unsigned long long) result->smis);
+}
@@ -0,0 +1,77 @@
+//
+// Detection of the platform noise that hits the samples of the benchmarks
+//
+// Three sources are checked:
+//  - interrupts and softirqs handled by the tested CPUs (/proc/interrupts and /proc/softirqs)
+//  - system management interrupts, with the SMI counter MSR (0x34, x86_64) read through /dev/cpu/N/msr
+//  - gaps in a spinning loop (in the style of the kernel hwlat tracer), the gaps not explained by interrupts are
+//    caused by the firmware or the hypervisor
+// A sample is contaminated if any interrupt, softirq or SMI happened in the tested CPUs while it was taken.
+//
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Gaps of the spinning loop longer than this are reported (same default threshold as the kernel hwlat tracer)
+#define NOISE_HWLAT_THRESHOLD_NANOSECONDS 10000
+
+// Duration of the spinning loop and of each of the windows in which the interrupts are checked
+#define NOISE_HWLAT_DURATION_MILLISECONDS 1000
+#define NOISE_HWLAT_WINDOW_MICROSECONDS 1000
+
+struct noise_counts {
+    uint64_t interrupts;
+    uint64_t softirqs;
+    uint64_t smis;
+};
+
+struct noise_detector {
+    // CPUs whose noise is counted
+    cpu_set_t cpus;
+
+    // Open /proc files and buffer where they are read
+    int interrupts_fd;
+    int softirqs_fd;
+    char *buffer;
+
+    // MSR device of the first tested CPU, -1 if the SMI counter can't be read
+    int msr_fd;
+};
+
+struct hwlat_result {
+    int cpu;
+    long long duration_ns;
+
+    // Gaps longer than the threshold, and those that happened in windows without interrupts
+    long number_of_gaps;
+    long unexplained_gaps;
+    long long max_gap_ns;
+    long long max_unexplained_gap_ns;
+    long long total_gap_ns;
+
+    // SMIs counted during the loop (0 if they can't be read)
+    uint64_t smis;
+};
+
+// Prepare the detection of the noise of the given CPUs
+void noise_detector_init(struct noise_detector *detector, const cpu_set_t *cpus);
+
+// Release the resources of the detector
+void noise_detector_close(struct noise_detector *detector);
+
+// Read the current noise counts of the tested CPUs
+void noise_detector_read(struct noise_detector *detector, struct noise_counts *counts);
+
+// Check if any noise event happened between two reads
+bool noise_counts_contaminated(const struct noise_counts *before, const struct noise_counts *after);
+
+// Spin in a max priority SCHED_FIFO thread in cpu and record the gaps of the loop
+void noise_hwlat_run(int cpu, struct hwlat_result *result);
+
+// Print the result of the spinning loop
+void noise_hwlat_print(const struct hwlat_result *result);
+
+#endif // NOISE_H
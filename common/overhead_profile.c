@@ -0,0 +1,304 @@
+//
+// Machine-readable profile of the overheads measured by the benchmarks
+//
+#include "overhead_profile.h"
+#include "timer.h"
+
+#include <sys/utsname.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+const double overhead_profile_percentiles[OVERHEAD_PROFILE_NUMBER_OF_PERCENTILES] = {50.0, 90.0, 99.0, 99.9, 99.99,
+                                                                                     100.0};
+
+static const char *overhead_kind_names[NUMBER_OF_OVERHEAD_KINDS] = {"preemption", "migration", "cache_refill",
+                                                                    "wakeup"};
+
+const char *overhead_kind_name(enum overhead_kind kind) {
+    return kind < NUMBER_OF_OVERHEAD_KINDS ? overhead_kind_names[kind] : "unknown";
+}
+
+static void read_cpufreq_string(int core, const char *file, char *value, size_t size) {
+    /***
+     * Read a cpufreq attribute of the core, value is empty if it isn't available
+     */
+
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/%s", core, file);
+
+    value[0] = '\0';
+    FILE *attribute = fopen(path, "r");
+    if (attribute == NULL)
+        return;
+
+    if (fgets(value, (int) size, attribute) == NULL)
+        value[0] = '\0';
+    value[strcspn(value, "\n")] = '\0';
+    fclose(attribute);
+}
+
+static int64_t read_cpufreq_khz(int core, const char *file) {
+    char value[32];
+    read_cpufreq_string(core, file, value, sizeof(value));
+    return strtoll(value, NULL, 10);
+}
+
+static void reserve_entries(struct overhead_profile *profile, uint32_t number_of_entries) {
+    /***
+     * Grow the entries so number_of_entries more fit, doubling the capacity to keep the adds amortized. It exits if
+     * the profile would have more than OVERHEAD_PROFILE_MAX_ENTRIES entries
+     */
+
+    if (number_of_entries <= profile->capacity - profile->number_of_entries)
+        return;
+
+    uint64_t needed_entries = (uint64_t) profile->number_of_entries + number_of_entries;
+    if (needed_entries > OVERHEAD_PROFILE_MAX_ENTRIES) {
+        fprintf(stderr, "too many entries for an overhead profile (maximum %d)\n", OVERHEAD_PROFILE_MAX_ENTRIES);
+        exit(-1);
+    }
+
+    uint32_t capacity = profile->capacity ? profile->capacity : 64;
+    while (capacity < needed_entries)
+        capacity *= 2;
+
+    struct overhead_entry *entries = realloc(profile->entries, (size_t) capacity * sizeof(struct overhead_entry));
+    if (entries == NULL) {
+        perror("allocate overhead profile entries failed");
+        exit(-1);
+    }
+
+    profile->entries = entries;
+    profile->capacity = capacity;
+}
+
+void overhead_profile_init(struct overhead_profile *profile, const char *benchmark, int core) {
+    memset(profile, 0, sizeof(struct overhead_profile));
+    struct overhead_profile_metadata *metadata = &(profile->metadata);
+
+    snprintf(metadata->benchmark, sizeof(metadata->benchmark), "%s", benchmark);
+    metadata->creation_time = time(NULL);
+
+    struct utsname host;
+    if (uname(&host) == 0) {
+        snprintf(metadata->hostname, sizeof(metadata->hostname), "%s", host.nodename);
+        snprintf(metadata->kernel_release, sizeof(metadata->kernel_release), "%s", host.release);
+        snprintf(metadata->kernel_version, sizeof(metadata->kernel_version), "%s", host.version);
+        snprintf(metadata->machine, sizeof(metadata->machine), "%s", host.machine);
+    }
+
+    metadata->cpufreq_core = core;
+    read_cpufreq_string(core, "scaling_governor", metadata->cpufreq_governor, sizeof(metadata->cpufreq_governor));
+    metadata->cpufreq_min_khz = read_cpufreq_khz(core, "scaling_min_freq");
+    metadata->cpufreq_max_khz = read_cpufreq_khz(core, "scaling_max_freq");
+    metadata->cpufreq_current_khz = read_cpufreq_khz(core, "scaling_cur_freq");
+
+    snprintf(metadata->timer_backend, sizeof(metadata->timer_backend), "%s",
+             timer_backend == TIMER_BACKEND_COUNTER ? "cycle counter" : "clock_gettime");
+    metadata->ns_per_tick = timer_ns_per_tick;
+    metadata->timer_overhead_ns = timer_ticks_to_ns(timer_overhead_ticks);
+}
+
+void overhead_profile_add_config(struct overhead_profile *profile, const char *key, const char *format, ...) {
+    struct overhead_profile_metadata *metadata = &(profile->metadata);
+    if (metadata->number_of_config >= OVERHEAD_PROFILE_MAX_CONFIG) {
+        fprintf(stderr, "too many configuration parameters in the overhead profile\n");
+        exit(-1);
+    }
+
+    snprintf(metadata->config_keys[metadata->number_of_config], sizeof(metadata->config_keys[0]), "%s", key);
+
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(metadata->config_values[metadata->number_of_config], sizeof(metadata->config_values[0]), format,
+              arguments);
+    va_end(arguments);
+
+    metadata->number_of_config++;
+}
+
+void overhead_profile_add(struct overhead_profile *profile, enum overhead_kind kind, int core, int source_core,
+                          long footprint_bytes, const char *label, const struct histogram *histogram) {
+    reserve_entries(profile, 1);
+
+    struct overhead_entry *entry = &(profile->entries[profile->number_of_entries++]);
+    memset(entry, 0, sizeof(struct overhead_entry));
+
+    entry->kind = kind;
+    entry->core = core;
+    entry->source_core = source_core;
+    entry->footprint_bytes = footprint_bytes;
+    entry->number_of_samples = histogram->total_count;
+    entry->min_ns = histogram->total_count ? histogram->min : 0;
+    entry->mean_ns = histogram->mean;
+    for (int i = 0; i < OVERHEAD_PROFILE_NUMBER_OF_PERCENTILES; ++i)
+        entry->percentiles_ns[i] = histogram_percentile(histogram, overhead_profile_percentiles[i]);
+    snprintf(entry->label, sizeof(entry->label), "%s", label != NULL ? label : "");
+}
+
+static void write_json_string(FILE *file, const char *string) {
+    /***
+     * Write a string literal escaping the characters that JSON doesn't allow
+     */
+
+    fputc('"', file);
+    for (const unsigned char *character = (const unsigned char *) string; *character; ++character) {
+        if (*character == '"' || *character == '\\')
+            fprintf(file, "\\%c", *character);
+        else if (*character < 0x20)
+            fprintf(file, "\\u%04x", *character);
+        else
+            fputc(*character, file);
+    }
+    fputc('"', file);
+}
+
+static void write_json(const struct overhead_profile *profile, const char *path) {
+    const struct overhead_profile_metadata *metadata = &(profile->metadata);
+
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        perror("open overhead profile failed");
+        exit(-1);
+    }
+
+    fprintf(file, "{\n  \"format\": \"rt_benchmarks_overhead_profile\",\n  \"version\": %d,\n",
+            OVERHEAD_PROFILE_VERSION);
+    fprintf(file, "  \"metadata\": {\n    \"benchmark\": ");
+    write_json_string(file, metadata->benchmark);
+    fprintf(file, ",\n    \"creation_time\": %lld,\n    \"host\": {\"hostname\": ",
+            (long long) metadata->creation_time);
+    write_json_string(file, metadata->hostname);
+    fprintf(file, ", \"machine\": ");
+    write_json_string(file, metadata->machine);
+    fprintf(file, "},\n    \"kernel\": {\"release\": ");
+    write_json_string(file, metadata->kernel_release);
+    fprintf(file, ", \"version\": ");
+    write_json_string(file, metadata->kernel_version);
+    fprintf(file, "},\n    \"cpufreq\": {\"core\": %d, \"governor\": ", metadata->cpufreq_core);
+    write_json_string(file, metadata->cpufreq_governor);
+    fprintf(file, ", \"min_khz\": %lld, \"max_khz\": %lld, \"current_khz\": %lld},\n",
+            (long long) metadata->cpufreq_min_khz, (long long) metadata->cpufreq_max_khz,
+            (long long) metadata->cpufreq_current_khz);
+    fprintf(file, "    \"timer\": {\"backend\": ");
+    write_json_string(file, metadata->timer_backend);
+    fprintf(file, ", \"ns_per_tick\": %.6f, \"overhead_ns\": %lld},\n    \"config\": {",
+            metadata->ns_per_tick, (long long) metadata->timer_overhead_ns);
+    for (uint32_t i = 0; i < metadata->number_of_config; ++i) {
+        fprintf(file, "%s", i ? ", " : "");
+        write_json_string(file, metadata->config_keys[i]);
+        fprintf(file, ": ");
+        write_json_string(file, metadata->config_values[i]);
+    }
+    fprintf(file, "}\n  },\n  \"percentiles\": [");
+    for (int i = 0; i < OVERHEAD_PROFILE_NUMBER_OF_PERCENTILES; ++i)
+        fprintf(file, "%s%g", i ? ", " : "", overhead_profile_percentiles[i]);
+    fprintf(file, "],\n  \"entries\": [");
+
+    for (uint32_t e = 0; e < profile->number_of_entries; ++e) {
+        const struct overhead_entry *entry = &(profile->entries[e]);
+        fprintf(file, "%s\n    {\"kind\": \"%s\", \"core\": %d, \"source_core\": %d, \"footprint_bytes\": %lld, "
+                      "\"label\": ", e ? "," : "", overhead_kind_name(entry->kind), entry->core, entry->source_core,
+                (long long) entry->footprint_bytes);
+        write_json_string(file, entry->label);
+        fprintf(file, ", \"samples\": %llu, \"min_ns\": %lld, \"mean_ns\": %.1f, \"percentiles_ns\": [",
+                (unsigned long long) entry->number_of_samples, (long long) entry->min_ns, entry->mean_ns);
+        for (int i = 0; i < OVERHEAD_PROFILE_NUMBER_OF_PERCENTILES; ++i)
+            fprintf(file, "%s%lld", i ? ", " : "", (long long) entry->percentiles_ns[i]);
+        fprintf(file, "]}");
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    if (fclose(file)) {
+        perror("write overhead profile failed");
+        exit(-1);
+    }
+}
+
+static void write_binary(const struct overhead_profile *profile, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror("open overhead profile failed");
+        exit(-1);
+    }
+
+    struct overhead_profile_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, OVERHEAD_PROFILE_MAGIC, sizeof(header.magic));
+    header.version = OVERHEAD_PROFILE_VERSION;
+    header.entry_size = sizeof(struct overhead_entry);
+    header.number_of_entries = profile->number_of_entries;
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(&(profile->metadata), sizeof(struct overhead_profile_metadata), 1, file) != 1 ||
+        fwrite(profile->entries, sizeof(struct overhead_entry), profile->number_of_entries, file) !=
+        profile->number_of_entries || fclose(file)) {
+        perror("write overhead profile failed");
+        exit(-1);
+    }
+}
+
+void overhead_profile_write(const struct overhead_profile *profile, const char *path_prefix) {
+    char path[4096];
+
+    snprintf(path, sizeof(path), "%s.json", path_prefix);
+    write_json(profile, path);
+
+    snprintf(path, sizeof(path), "%s.bin", path_prefix);
+    write_binary(profile, path);
+
+    printf("Overhead profile: \n\t%s: %s.json and %s.bin\n\t%s: %u\n", "Files", path_prefix, path_prefix,
+           "Number of entries", profile->number_of_entries);
+}
+
+void overhead_profile_read(struct overhead_profile *profile, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror("open overhead profile failed");
+        exit(-1);
+    }
+
+    struct overhead_profile_header header;
+    struct overhead_profile_metadata metadata;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, OVERHEAD_PROFILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != OVERHEAD_PROFILE_VERSION || header.entry_size != sizeof(struct overhead_entry)) {
+        fprintf(stderr, "%s isn't an overhead profile of version %d\n", path, OVERHEAD_PROFILE_VERSION);
+        exit(-1);
+    }
+
+    // A corrupt number of entries must not reserve more than the file holds
+    struct stat file_stat;
+    if (fstat(fileno(file), &file_stat) || (uint64_t) file_stat.st_size < sizeof(header) + sizeof(metadata) ||
+        header.number_of_entries > ((uint64_t) file_stat.st_size - sizeof(header) - sizeof(metadata)) /
+                                   sizeof(struct overhead_entry)) {
+        fprintf(stderr, "%s is truncated\n", path);
+        exit(-1);
+    }
+
+    reserve_entries(profile, header.number_of_entries);
+
+    if (fread(&metadata, sizeof(metadata), 1, file) != 1 ||
+        fread(&(profile->entries[profile->number_of_entries]), sizeof(struct overhead_entry),
+              header.number_of_entries, file) != header.number_of_entries) {
+        fprintf(stderr, "%s is truncated\n", path);
+        exit(-1);
+    }
+    fclose(file);
+
+    if (profile->metadata.benchmark[0] == '\0')
+        profile->metadata = metadata;
+    profile->number_of_entries += header.number_of_entries;
+}
+
+void overhead_profile_free(struct overhead_profile *profile) {
+    free(profile->entries);
+    profile->entries = NULL;
+    profile->number_of_entries = 0;
+    profile->capacity = 0;
+}
@@ -0,0 +1,136 @@
+//
+// Machine-readable profile of the overheads measured by the benchmarks (preemption, migration, cache refill by
+// footprint and wake up latency), written as JSON and in a compact binary form
+//
+// Binary format: a struct overhead_profile_header, a struct overhead_profile_metadata and number_of_entries
+// struct overhead_entry records, in the byte order of the machine that wrote the file
+//
+#ifndef OVERHEAD_PROFILE_H
+#define OVERHEAD_PROFILE_H
+
+#include <stdint.h>
+
+#include "statistics.h"
+
+#define OVERHEAD_PROFILE_MAGIC "RTOVHPRF"
+#define OVERHEAD_PROFILE_VERSION 1
+
+#define OVERHEAD_PROFILE_MAX_CONFIG 16
+
+// Entries of a profile, including the ones appended by overhead_profile_read
+#define OVERHEAD_PROFILE_MAX_ENTRIES (1 << 20)
+
+// Percentiles stored for each cost, the last one is the maximum
+#define OVERHEAD_PROFILE_NUMBER_OF_PERCENTILES 6
+extern const double overhead_profile_percentiles[OVERHEAD_PROFILE_NUMBER_OF_PERCENTILES];
+
+enum overhead_kind {
+    // Switch from a thread to another one in the same core
+    OVERHEAD_PREEMPTION,
+
+    // Migration of a thread from source_core to core
+    OVERHEAD_MIGRATION,
+
+    // Extra time to reload a working set of footprint_bytes after it was evicted
+    OVERHEAD_CACHE_REFILL,
+
+    // Wake up of a thread in core signaled from source_core
+    OVERHEAD_WAKEUP,
+
+    NUMBER_OF_OVERHEAD_KINDS
+};
+
+struct overhead_entry {
+    uint32_t kind;
+
+    // Core where the cost is paid and core where it is triggered (-1 if it doesn't apply)
+    int32_t core;
+    int32_t source_core;
+    uint32_t reserved;
+
+    // Working set of the cache refill costs (0 for the other kinds)
+    int64_t footprint_bytes;
+
+    uint64_t number_of_samples;
+    int64_t min_ns;
+    double mean_ns;
+    int64_t percentiles_ns[OVERHEAD_PROFILE_NUMBER_OF_PERCENTILES];
+
+    // Variant of the cost (wake up mechanism, fill kernel...)
+    char label[32];
+};
+
+struct overhead_profile_metadata {
+    char benchmark[32];
+    int64_t creation_time;
+
+    // Host and kernel (uname)
+    char hostname[72];
+    char kernel_release[72];
+    char kernel_version[128];
+    char machine[72];
+
+    // cpufreq of the tested core (empty and 0 if cpufreq isn't available)
+    int32_t cpufreq_core;
+    char cpufreq_governor[32];
+    int64_t cpufreq_min_khz;
+    int64_t cpufreq_max_khz;
+    int64_t cpufreq_current_khz;
+
+    // Timer used for the measures
+    char timer_backend[32];
+    double ns_per_tick;
+    int64_t timer_overhead_ns;
+
+    // Configuration of the run as key and value pairs
+    uint32_t number_of_config;
+    char config_keys[OVERHEAD_PROFILE_MAX_CONFIG][32];
+    char config_values[OVERHEAD_PROFILE_MAX_CONFIG][64];
+};
+
+struct overhead_profile_header {
+    char magic[8];
+    uint32_t version;
+
+    // Size of each entry
+    uint32_t entry_size;
+
+    uint32_t number_of_entries;
+    uint32_t reserved;
+};
+
+struct overhead_profile {
+    struct overhead_profile_metadata metadata;
+    uint32_t number_of_entries;
+
+    // Entries, grown as they are added
+    struct overhead_entry *entries;
+    uint32_t capacity;
+};
+
+// Get the name of a kind
+const char *overhead_kind_name(enum overhead_kind kind);
+
+// Start an empty profile and collect the metadata of the host, the kernel, the cpufreq state of core and the timer
+// (timer_init must have been called)
+void overhead_profile_init(struct overhead_profile *profile, const char *benchmark, int core);
+
+// Add a configuration parameter of the run
+void overhead_profile_add_config(struct overhead_profile *profile, const char *key, const char *format, ...)
+        __attribute__((format(printf, 3, 4)));
+
+// Add the percentiles of a cost
+void overhead_profile_add(struct overhead_profile *profile, enum overhead_kind kind, int core, int source_core,
+                          long footprint_bytes, const char *label, const struct histogram *histogram);
+
+// Write the profile to <path_prefix>.json and <path_prefix>.bin
+void overhead_profile_write(const struct overhead_profile *profile, const char *path_prefix);
+
+// Read a binary profile and append its entries to profile, that must be zeroed before the first read (the metadata
+// of the first file read is kept). It exits if the file isn't a valid profile
+void overhead_profile_read(struct overhead_profile *profile, const char *path);
+
+// Release the entries of the profile
+void overhead_profile_free(struct overhead_profile *profile);
+
+#endif // OVERHEAD_PROFILE_H
@@ -0,0 +1,259 @@
+//
+// Hardware and software counters of the calling thread read around each measured region (perf_event_open)
+//
+#define _GNU_SOURCE
+
+#include "perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+struct perf_counter_definition {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+};
+
+static const struct perf_counter_definition perf_counter_definitions[NUMBER_OF_PERF_COUNTERS] = {
+        {"cycles",           PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"cache_misses",     PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        {"dtlb_misses",      PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        {"context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+        {"cpu_migrations",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS},
+        {"page_faults",      PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}
+};
+
+const char *perf_counter_name(enum perf_counter_id counter) {
+    return perf_counter_definitions[counter].name;
+}
+
+static int open_counter(enum perf_counter_id counter, int group_fd) {
+    /***
+     * Open a counter of the calling thread in any CPU. The kernel events are counted if it is allowed
+     */
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = perf_counter_definitions[counter].type;
+    attr.config = perf_counter_definitions[counter].config;
+    attr.exclude_hv = 1;
+
+    // Any software counter can end up as the leader of their group (the first one that opens), so all of them use the
+    // group read format
+    if (counter >= PERF_COUNTER_FIRST_SOFTWARE)
+        attr.read_format = PERF_FORMAT_GROUP;
+
+#if defined(__aarch64__)
+    // Ask for user space access to the counter (perf_user_access sysctl)
+    attr.config1 = 0x2;
+#endif
+
+    int fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+
+    // Without permission to count kernel events (perf_event_paranoid), count only the user space ones
+    if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+        attr.exclude_kernel = 1;
+        fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+
+    return fd;
+}
+
+void perf_counters_open(struct perf_counters *counters) {
+    memset(counters, 0, sizeof(struct perf_counters));
+    counters->software_group_fd = -1;
+
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i) {
+        bool software = i >= PERF_COUNTER_FIRST_SOFTWARE;
+
+        counters->fds[i] = open_counter(i, software ? counters->software_group_fd : -1);
+        if (counters->fds[i] < 0) {
+            fprintf(stderr, "perf counter %s not available: %s\n", perf_counter_name(i), strerror(errno));
+            continue;
+        }
+        counters->enabled = true;
+
+        if (software) {
+            if (counters->software_group_fd < 0)
+                counters->software_group_fd = counters->fds[i];
+            counters->software_group_index[i] = counters->software_group_size++;
+            continue;
+        }
+
+        // Map the page of the event to read it from user space
+        void *page = mmap(NULL, page_size, PROT_READ, MAP_SHARED, counters->fds[i], 0);
+        if (page != MAP_FAILED) {
+            if (((struct perf_event_mmap_page *) page)->cap_user_rdpmc)
+                counters->pages[i] = page;
+            else
+                munmap(page, page_size);
+        }
+    }
+}
+
+static inline uint64_t read_pmc(uint32_t index) {
+    /***
+     * Read the hardware counter index (as given by the mmap'd page minus one) from user space
+     */
+
+#if defined(__x86_64__)
+    uint32_t low, high;
+    __asm__ __volatile__("rdpmc" : "=a" (low), "=d" (high) : "c" (index));
+    return ((uint64_t) high << 32) | low;
+#elif defined(__aarch64__)
+    uint64_t value;
+    if (index == 31) {
+        __asm__ __volatile__("mrs %0, pmccntr_el0" : "=r" (value));
+    } else {
+        __asm__ __volatile__("msr pmselr_el0, %0\n\tisb" : : "r" ((uint64_t) index));
+        __asm__ __volatile__("mrs %0, pmxevcntr_el0" : "=r" (value));
+    }
+    return value;
+#else
+    (void) index;
+    return 0;
+#endif
+}
+
+static bool read_user_counter(struct perf_event_mmap_page *page, int64_t *value) {
+    /***
+     * Read the counter through its mmap'd page (see include/uapi/linux/perf_event.h). Return false if the counter
+     * isn't in the PMU at the moment and it must be read with read()
+     */
+
+    uint32_t sequence;
+    int64_t count;
+    bool in_pmu;
+
+    do {
+        sequence = page->lock;
+        __asm__ __volatile__("" : : : "memory");
+
+        uint32_t index = page->index;
+        count = page->offset;
+        in_pmu = page->cap_user_rdpmc && index;
+
+        if (in_pmu) {
+            int64_t pmc = (int64_t) read_pmc(index - 1);
+
+            // Sign extend the counter to the width of the PMU register
+            pmc <<= 64 - page->pmc_width;
+            pmc >>= 64 - page->pmc_width;
+            count += pmc;
+        }
+
+        __asm__ __volatile__("" : : : "memory");
+    } while (page->lock != sequence);
+
+    *value = count;
+    return in_pmu;
+}
+
+void perf_counters_read(const struct perf_counters *counters, int64_t *values) {
+    for (int i = 0; i < PERF_COUNTER_FIRST_SOFTWARE; ++i) {
+        values[i] = 0;
+        if (counters->fds[i] < 0)
+            continue;
+
+        if (counters->pages[i] != NULL && read_user_counter(counters->pages[i], &(values[i])))
+            continue;
+
+        uint64_t value;
+        if (read(counters->fds[i], &value, sizeof(value)) == sizeof(value))
+            values[i] = (int64_t) value;
+    }
+
+    // Group read format: number of counters followed by their values
+    uint64_t group_values[1 + NUMBER_OF_PERF_COUNTERS];
+    bool group_read = counters->software_group_fd >= 0 &&
+                      read(counters->software_group_fd, group_values, sizeof(group_values)) > 0;
+
+    for (int i = PERF_COUNTER_FIRST_SOFTWARE; i < NUMBER_OF_PERF_COUNTERS; ++i) {
+        values[i] = 0;
+        if (group_read && counters->fds[i] >= 0)
+            values[i] = (int64_t) group_values[1 + counters->software_group_index[i]];
+    }
+}
+
+void perf_counters_close(struct perf_counters *counters) {
+    long page_size = sysconf(_SC_PAGESIZE);
+
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i) {
+        if (counters->pages[i] != NULL)
+            munmap(counters->pages[i], page_size);
+        if (counters->fds[i] >= 0)
+            close(counters->fds[i]);
+        counters->pages[i] = NULL;
+        counters->fds[i] = -1;
+    }
+
+    counters->software_group_fd = -1;
+    counters->enabled = false;
+}
+
+void perf_counters_print_info(const struct perf_counters *counters) {
+    printf("Performance counters: \n");
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i) {
+        printf("\t%s: %s\n", perf_counter_name(i), counters->fds[i] < 0 ? "not available" :
+                                                    counters->pages[i] != NULL ? "user space read" : "read()");
+    }
+}
+
+void perf_attribution_init(struct perf_attribution *attribution) {
+    memset(attribution, 0, sizeof(struct perf_attribution));
+}
+
+void perf_attribution_record_deltas(struct perf_attribution *attribution, long long latency_ns, const int64_t *deltas) {
+    // Band of the latency, the values lower than 2 ns (including negative ones) are in the first one
+    int band = latency_ns > 1 ? 63 - __builtin_clzll((unsigned long long) latency_ns) : 0;
+    if (band >= PERF_ATTRIBUTION_BANDS)
+        band = PERF_ATTRIBUTION_BANDS - 1;
+
+    attribution->counts[band]++;
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i)
+        attribution->sums[band][i] += (double) deltas[i];
+}
+
+void perf_attribution_record(struct perf_attribution *attribution, long long latency_ns, const int64_t *start,
+                             const int64_t *end) {
+    int64_t deltas[NUMBER_OF_PERF_COUNTERS];
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i)
+        deltas[i] = end[i] - start[i];
+
+    perf_attribution_record_deltas(attribution, latency_ns, deltas);
+}
+
+void perf_attribution_print(const struct perf_attribution *attribution, const struct perf_counters *counters,
+                            const char *cost_name) {
+    printf("Counter attribution of %s (mean counter deltas per sample of each latency band): \n", cost_name);
+    printf("band_min_ns,band_max_ns,samples");
+    for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i) {
+        if (counters->fds[i] >= 0)
+            printf(",%s", perf_counter_name(i));
+    }
+    printf("\n");
+
+    for (int band = 0; band < PERF_ATTRIBUTION_BANDS; ++band) {
+        if (attribution->counts[band] == 0)
+            continue;
+
+        printf("%llu,%llu,%llu", band ? 1ULL << band : 0ULL, (1ULL << (band + 1)) - 1,
+               (unsigned long long) attribution->counts[band]);
+        for (int i = 0; i < NUMBER_OF_PERF_COUNTERS; ++i) {
+            if (counters->fds[i] >= 0)
+                printf(",%.1f", attribution->sums[band][i] / (double) attribution->counts[band]);
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,86 @@
+//
+// Hardware and software counters of the calling thread read around each measured region (perf_event_open)
+//
+// The hardware counters are read in user space with rdpmc (x86_64) or the PMU registers (aarch64) through the mmap'd
+// page of each event when the kernel allows it, in other case with read(). The software counters (context switches,
+// CPU migrations and page faults) are always read with a single read() of their group.
+//
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+enum perf_counter_id {
+    PERF_COUNTER_CYCLES,
+    PERF_COUNTER_INSTRUCTIONS,
+    PERF_COUNTER_CACHE_MISSES,
+    PERF_COUNTER_DTLB_MISSES,
+    PERF_COUNTER_CONTEXT_SWITCHES,
+    PERF_COUNTER_CPU_MIGRATIONS,
+    PERF_COUNTER_PAGE_FAULTS,
+    NUMBER_OF_PERF_COUNTERS
+};
+
+// Number of the first software counter, they are opened as a group
+#define PERF_COUNTER_FIRST_SOFTWARE PERF_COUNTER_CONTEXT_SWITCHES
+
+// The attribution divides the samples in power of two latency bands, from 1 ns up to 2^(PERF_ATTRIBUTION_BANDS - 1)
+#define PERF_ATTRIBUTION_BANDS 40
+
+struct perf_event_mmap_page;
+
+struct perf_counters {
+    // File descriptor of each counter, -1 if it couldn't be opened
+    int fds[NUMBER_OF_PERF_COUNTERS];
+
+    // Mapped page of each hardware counter, NULL if it can't be read from user space
+    struct perf_event_mmap_page *pages[NUMBER_OF_PERF_COUNTERS];
+
+    // Leader of the group of software counters (the first one that could be opened), and position of each software
+    // counter in the group
+    int software_group_fd;
+    int software_group_index[NUMBER_OF_PERF_COUNTERS];
+    int software_group_size;
+
+    // Some counter could be opened
+    bool enabled;
+};
+
+// Mean counter deltas of the samples of each latency band
+struct perf_attribution {
+    uint64_t counts[PERF_ATTRIBUTION_BANDS];
+    double sums[PERF_ATTRIBUTION_BANDS][NUMBER_OF_PERF_COUNTERS];
+};
+
+// Name of a counter
+const char *perf_counter_name(enum perf_counter_id counter);
+
+// Open the counters of the calling thread (they follow it across CPUs). The counters that are not supported or not
+// allowed are skipped with a warning
+void perf_counters_open(struct perf_counters *counters);
+
+// Read the current value of all the counters (0 for the counters that couldn't be opened)
+void perf_counters_read(const struct perf_counters *counters, int64_t *values);
+
+// Close the counters
+void perf_counters_close(struct perf_counters *counters);
+
+// Print which counters are available and how they are read
+void perf_counters_print_info(const struct perf_counters *counters);
+
+// Initialize an empty attribution
+void perf_attribution_init(struct perf_attribution *attribution);
+
+// Record the counter deltas (end - start) of a sample with the given latency
+void perf_attribution_record(struct perf_attribution *attribution, long long latency_ns, const int64_t *start,
+                             const int64_t *end);
+
+// Add the deltas of a sample that are already calculated
+void perf_attribution_record_deltas(struct perf_attribution *attribution, long long latency_ns, const int64_t *deltas);
+
+// Print the mean counter deltas of each latency band that has samples
+void perf_attribution_print(const struct perf_attribution *attribution, const struct perf_counters *counters,
+                            const char *cost_name);
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,684 @@
+//
+// Preflight of the benchmarks: the settings of the machine that add variance to the costs measured in the tested CPUs
+//
+#define _GNU_SOURCE
+
+#include "preflight.h"
+#include "timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <signal.h>
+#include <dirent.h>
+#include <pthread.h>
+
+#define CPU_SYSFS_DIRECTORY "/sys/devices/system/cpu"
+#define TRANSPARENT_HUGE_PAGES_DIRECTORY "/sys/kernel/mm/transparent_hugepage"
+
+// Value of /dev/cpu_dma_latency without any request (PM_QOS_CPU_LATENCY_DEFAULT_VALUE of the kernel)
+#define PM_QOS_DEFAULT_LATENCY_MICROSECONDS 2000000000
+
+#define SETTING_PATH_SIZE 96
+#define SETTING_VALUE_SIZE 128
+
+// Setting changed by the low noise setup, with its previous value
+struct preflight_setting {
+    char path[SETTING_PATH_SIZE];
+    char value[SETTING_VALUE_SIZE];
+};
+
+static struct preflight_setting changed_settings[PREFLIGHT_MAX_SETTINGS];
+static int number_of_changed_settings = 0;
+static bool restore_registered = false;
+
+// Process that applied the setup, the forked children inherit the handlers but must not restore it
+static pid_t setup_process;
+
+static bool read_string(const char *path, char *value, size_t size) {
+    /***
+     * Read the first line of a sysfs or procfs file, false if it can't be read or doesn't fit in value
+     */
+
+    value[0] = '\0';
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+
+    bool valid = fgets(value, (int) size, file) != NULL;
+    fclose(file);
+    if (!valid)
+        value[0] = '\0';
+
+    size_t length = strcspn(value, "\n");
+    if (value[length] != '\n' && length == size - 1)
+        return false;
+    value[length] = '\0';
+
+    return true;
+}
+
+static long long read_long(const char *path, long long default_value) {
+    char value[32];
+    return read_string(path, value, sizeof(value)) && value[0] ? strtoll(value, NULL, 10) : default_value;
+}
+
+static bool write_string(const char *path, const char *value) {
+    /***
+     * Write a sysfs or procfs file. Only async-signal-safe calls are used, it is called from the signal handler
+     */
+
+    int fd = open(path, O_WRONLY);
+    if (fd < 0)
+        return false;
+
+    size_t length = strlen(value);
+    bool written = write(fd, value, length) == (ssize_t) length;
+    return close(fd) == 0 && written;
+}
+
+static void select_value(char *value) {
+    /***
+     * Keep the selected value of a setting like "always [madvise] never"
+     */
+
+    char *start = strchr(value, '['), *end = start != NULL ? strchr(start, ']') : NULL;
+    if (end == NULL)
+        return;
+
+    memmove(value, start + 1, end - start - 1);
+    value[end - start - 1] = '\0';
+}
+
+static bool parse_cpu_list(const char *list, cpu_set_t *cpus) {
+    /***
+     * Get the CPUs of a list like 0-3,6. Return false if the list has no CPU
+     */
+
+    CPU_ZERO(cpus);
+    const char *position = list;
+
+    while (*position) {
+        char *end;
+        long first = strtol(position, &end, 10), last = first;
+        if (end == position)
+            break;
+
+        if (*end == '-') {
+            position = end + 1;
+            last = strtol(position, &end, 10);
+        }
+
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+            CPU_SET(cpu, cpus);
+
+        if (*end != ',')
+            break;
+        position = end + 1;
+    }
+
+    return CPU_COUNT(cpus) > 0;
+}
+
+static void format_cpu_list(const cpu_set_t *cpus, char *list, size_t size) {
+    /***
+     * Write the CPUs as a list like 0-3,6
+     */
+
+    size_t length = 0;
+    list[0] = '\0';
+
+    for (int cpu = 0; cpu < CPU_SETSIZE && length < size; ++cpu) {
+        if (!CPU_ISSET(cpu, cpus))
+            continue;
+
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, cpus))
+            last++;
+
+        if (last == cpu)
+            length += snprintf(list + length, size - length, "%s%d", length ? "," : "", cpu);
+        else
+            length += snprintf(list + length, size - length, "%s%d-%d", length ? "," : "", cpu, last);
+        cpu = last;
+    }
+}
+
+static bool cpus_included(const cpu_set_t *cpus, const cpu_set_t *set) {
+    cpu_set_t intersection;
+    CPU_AND(&intersection, cpus, set);
+    return CPU_EQUAL(&intersection, cpus);
+}
+
+static bool cpus_intersect(const cpu_set_t *cpus, const cpu_set_t *set) {
+    cpu_set_t intersection;
+    CPU_AND(&intersection, cpus, set);
+    return CPU_COUNT(&intersection) > 0;
+}
+
+static void add_issue(struct preflight_report *report, const char *format, ...) {
+    if (report->number_of_issues == PREFLIGHT_MAX_ISSUES)
+        return;
+
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(report->issues[report->number_of_issues++], PREFLIGHT_ISSUE_SIZE, format, arguments);
+    va_end(arguments);
+}
+
+static bool kernel_parameter(const char *name, char *value, size_t size) {
+    /***
+     * Get the value of a parameter of the kernel command line, false if it isn't given
+     */
+
+    char command_line[4096];
+    value[0] = '\0';
+    if (!read_string("/proc/cmdline", command_line, sizeof(command_line)))
+        return false;
+
+    size_t name_length = strlen(name);
+    for (char *token = strtok(command_line, " "); token != NULL; token = strtok(NULL, " ")) {
+        if (strncmp(token, name, name_length) != 0 || (token[name_length] != '=' && token[name_length] != '\0'))
+            continue;
+
+        if (token[name_length] == '=')
+            snprintf(value, size, "%s", token + name_length + 1);
+        return true;
+    }
+
+    return false;
+}
+
+static void check_cpu_list(struct preflight_report *report, const char *name, const char *list, const char *issue) {
+    /***
+     * Check that a setting with a CPU list includes all the tested CPUs
+     */
+
+    cpu_set_t set;
+    bool has_cpus = parse_cpu_list(list, &set);
+    printf("\t%s: %s\n", name, has_cpus ? list : "none");
+
+    if (!has_cpus || !cpus_included(&(report->cpus), &set))
+        add_issue(report, "%s", issue);
+}
+
+static void check_isolation(struct preflight_report *report) {
+    char list[256];
+
+    read_string(CPU_SYSFS_DIRECTORY "/isolated", list, sizeof(list));
+    check_cpu_list(report, "isolcpus", list, "the tested CPUs aren't isolated from the scheduler (isolcpus)");
+
+    // It is "(null)" if the kernel doesn't support it
+    read_string(CPU_SYSFS_DIRECTORY "/nohz_full", list, sizeof(list));
+    check_cpu_list(report, "nohz_full", list, "the scheduler tick isn't stopped in the tested CPUs (nohz_full)");
+
+    // Without a list, the callbacks of all the CPUs are offloaded
+    if (kernel_parameter("rcu_nocbs", list, sizeof(list)) && list[0] == '\0')
+        printf("\t%s: %s\n", "rcu_nocbs", "all");
+    else
+        check_cpu_list(report, "rcu_nocbs", list, "the RCU callbacks run in the tested CPUs (rcu_nocbs)");
+}
+
+static void check_irqs(struct preflight_report *report) {
+    DIR *irqs = opendir("/proc/irq");
+    if (irqs == NULL) {
+        printf("\t%s: %s\n", "IRQ affinity", "not available");
+        return;
+    }
+
+    int number_of_irqs = 0, irqs_in_tested_cpus = 0;
+    struct dirent *entry;
+    while ((entry = readdir(irqs)) != NULL) {
+        if (!isdigit((unsigned char) entry->d_name[0]))
+            continue;
+
+        // The effective affinity is empty for the IRQs without handler or if the interrupt controller doesn't report it
+        char path[PATH_MAX], list[SETTING_VALUE_SIZE];
+        cpu_set_t affinity;
+        snprintf(path, sizeof(path), "/proc/irq/%s/effective_affinity_list", entry->d_name);
+        if (!read_string(path, list, sizeof(list)) || !parse_cpu_list(list, &affinity)) {
+            snprintf(path, sizeof(path), "/proc/irq/%s/smp_affinity_list", entry->d_name);
+            if (!read_string(path, list, sizeof(list)) || !parse_cpu_list(list, &affinity))
+                continue;
+        }
+
+        number_of_irqs++;
+        if (cpus_intersect(&(report->cpus), &affinity))
+            irqs_in_tested_cpus++;
+    }
+    closedir(irqs);
+
+    printf("\t%s: %d of %d\n", "IRQs that can run in the tested CPUs", irqs_in_tested_cpus, number_of_irqs);
+    if (irqs_in_tested_cpus)
+        add_issue(report, "%d IRQs can be handled in the tested CPUs", irqs_in_tested_cpus);
+}
+
+static void check_cpufreq(struct preflight_report *report, int cpu) {
+    char path[PATH_MAX], governor[32];
+
+    snprintf(path, sizeof(path), CPU_SYSFS_DIRECTORY "/cpu%d/cpufreq/scaling_governor", cpu);
+    if (!read_string(path, governor, sizeof(governor))) {
+        printf("\tcpufreq of CPU %d: %s\n", cpu, "not available");
+        return;
+    }
+
+    snprintf(path, sizeof(path), CPU_SYSFS_DIRECTORY "/cpu%d/cpufreq/scaling_min_freq", cpu);
+    long long min_khz = read_long(path, 0);
+    snprintf(path, sizeof(path), CPU_SYSFS_DIRECTORY "/cpu%d/cpufreq/scaling_max_freq", cpu);
+    long long max_khz = read_long(path, 0);
+    snprintf(path, sizeof(path), CPU_SYSFS_DIRECTORY "/cpu%d/cpufreq/scaling_cur_freq", cpu);
+    long long current_khz = read_long(path, 0);
+
+    printf("\tcpufreq of CPU %d: %s governor, %lld-%lld kHz (%lld kHz now)\n", cpu, governor, min_khz, max_khz,
+           current_khz);
+    if (min_khz != max_khz)
+        add_issue(report, "the frequency of CPU %d isn't locked (%s governor, %lld-%lld kHz)", cpu, governor, min_khz,
+                  max_khz);
+}
+
+static void check_boost(struct preflight_report *report) {
+    const char *boost;
+    long long value;
+
+    if ((value = read_long(CPU_SYSFS_DIRECTORY "/cpufreq/boost", -1)) >= 0)
+        boost = value ? "enabled" : "disabled";
+    else if ((value = read_long(CPU_SYSFS_DIRECTORY "/intel_pstate/no_turbo", -1)) >= 0)
+        boost = value ? "disabled" : "enabled";
+    else
+        boost = "not available";
+
+    printf("\t%s: %s\n", "Turbo/boost", boost);
+    if (strcmp(boost, "enabled") == 0)
+        add_issue(report, "the turbo/boost is enabled, the frequency depends on the temperature and the other CPUs");
+}
+
+static void check_cstates(struct preflight_report *report, int cpu) {
+    char path[PATH_MAX], name[32], states[256] = "";
+    size_t length = 0;
+    int state;
+
+    for (state = 0; ; ++state) {
+        snprintf(path, sizeof(path), CPU_SYSFS_DIRECTORY "/cpu%d/cpuidle/state%d/name", cpu, state);
+        if (!read_string(path, name, sizeof(name)))
+            break;
+
+        snprintf(path, sizeof(path), CPU_SYSFS_DIRECTORY "/cpu%d/cpuidle/state%d/disable", cpu, state);
+        if (read_long(path, 0))
+            continue;
+
+        snprintf(path, sizeof(path), CPU_SYSFS_DIRECTORY "/cpu%d/cpuidle/state%d/latency", cpu, state);
+        long long latency = read_long(path, 0);
+        if (length < sizeof(states))
+            length += snprintf(states + length, sizeof(states) - length, "%s%s (%lld us)", length ? ", " : "", name,
+                               latency);
+
+        if (latency > PREFLIGHT_MAX_CSTATE_LATENCY_MICROSECONDS)
+            add_issue(report, "CPU %d can enter %s, with an exit latency of %lld us", cpu, name, latency);
+    }
+
+    printf("\tC-states of CPU %d: %s\n", cpu, state == 0 ? "not available" : (length ? states : "all disabled"));
+}
+
+static void check_pm_qos(void) {
+    /***
+     * Latency limit requested to the CPU idle governor by all the processes, it needs root
+     */
+
+    int fd = open("/dev/cpu_dma_latency", O_RDONLY);
+    if (fd < 0)
+        return;
+
+    int32_t latency;
+    if (read(fd, &latency, sizeof(latency)) == sizeof(latency)) {
+        // The default value means no limit
+        if (latency >= PM_QOS_DEFAULT_LATENCY_MICROSECONDS)
+            printf("\t%s: %s\n", "PM QoS CPU latency limit", "none");
+        else
+            printf("\t%s: %d us\n", "PM QoS CPU latency limit", latency);
+    }
+    close(fd);
+}
+
+static void check_rt_throttling(struct preflight_report *report) {
+    long long runtime_us = read_long("/proc/sys/kernel/sched_rt_runtime_us", -1);
+    long long period_us = read_long("/proc/sys/kernel/sched_rt_period_us", 0);
+
+    printf("\t%s: %lld (period %lld us)\n", "sched_rt_runtime_us", runtime_us, period_us);
+    if (runtime_us >= 0)
+        add_issue(report, "the RT throttling is enabled, the RT tasks can only run %lld us every %lld us", runtime_us,
+                  period_us);
+}
+
+static void check_transparent_huge_pages(struct preflight_report *report) {
+    char enabled[64], defrag[64];
+
+    if (!read_string(TRANSPARENT_HUGE_PAGES_DIRECTORY "/enabled", enabled, sizeof(enabled))) {
+        printf("\t%s: %s\n", "Transparent huge pages", "not available");
+        return;
+    }
+    select_value(enabled);
+    read_string(TRANSPARENT_HUGE_PAGES_DIRECTORY "/defrag", defrag, sizeof(defrag));
+    select_value(defrag);
+
+    printf("\t%s: %s (defrag %s)\n\t%s: %lld pages every %lld ms, %lld full scans, %lld pages collapsed\n",
+           "Transparent huge pages", enabled, defrag, "khugepaged",
+           read_long(TRANSPARENT_HUGE_PAGES_DIRECTORY "/khugepaged/pages_to_scan", 0),
+           read_long(TRANSPARENT_HUGE_PAGES_DIRECTORY "/khugepaged/scan_sleep_millisecs", 0),
+           read_long(TRANSPARENT_HUGE_PAGES_DIRECTORY "/khugepaged/full_scans", 0),
+           read_long(TRANSPARENT_HUGE_PAGES_DIRECTORY "/khugepaged/pages_collapsed", 0));
+
+    if (strcmp(enabled, "always") == 0)
+        add_issue(report, "the transparent huge pages are always enabled, khugepaged can collapse the memory of the "
+                          "benchmark while it runs");
+}
+
+void preflight_check(const cpu_set_t *cpus, struct preflight_report *report) {
+    memset(report, 0, sizeof(struct preflight_report));
+    report->cpus = *cpus;
+
+    char list[256];
+    format_cpu_list(cpus, list, sizeof(list));
+    printf("Preflight: \n\t%s: %s\n", "Tested CPUs", list);
+
+    check_isolation(report);
+    check_irqs(report);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, cpus))
+            check_cpufreq(report, cpu);
+    }
+    check_boost(report);
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, cpus))
+            check_cstates(report, cpu);
+    }
+    check_pm_qos();
+    check_rt_throttling(report);
+    check_transparent_huge_pages(report);
+
+    for (int i = 0; i < report->number_of_issues; ++i)
+        printf("\t%s: %s\n", "Issue", report->issues[i]);
+    printf("\t%s: %d\n", "Number of issues", report->number_of_issues);
+}
+
+void preflight_print_causes(const struct preflight_report *report) {
+    if (report->number_of_issues == 0) {
+        fprintf(stderr, "no issue was found in the preflight, check the load of the tested CPUs\n");
+        return;
+    }
+
+    fprintf(stderr, "possible causes found in the preflight:\n");
+    for (int i = 0; i < report->number_of_issues; ++i)
+        fprintf(stderr, "\t%s\n", report->issues[i]);
+}
+
+void preflight_restore(void) {
+    if (getpid() != setup_process)
+        return;
+
+    // The last changes are undone first, as they can depend on the previous ones
+    while (number_of_changed_settings > 0) {
+        number_of_changed_settings--;
+        write_string(changed_settings[number_of_changed_settings].path,
+                     changed_settings[number_of_changed_settings].value);
+    }
+}
+
+static void restore_on_signal(int signal_number) {
+    preflight_restore();
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+static int change_setting(const char *path, const char *value, bool report_failure) {
+    /***
+     * Write a setting and keep its previous value. Return 1 if it was changed, 0 if it already had the value or doesn't
+     * exist and -1 if it couldn't be changed
+     */
+
+    char previous[SETTING_VALUE_SIZE];
+    if (!read_string(path, previous, sizeof(previous))) {
+        if (errno == ENOENT)
+            return 0;
+        if (report_failure)
+            fprintf(stderr, "%s can't be read\n", path);
+        return -1;
+    }
+
+    select_value(previous);
+    if (strcmp(previous, value) == 0)
+        return 0;
+
+    if (number_of_changed_settings == PREFLIGHT_MAX_SETTINGS || strlen(path) >= SETTING_PATH_SIZE) {
+        fprintf(stderr, "%s can't be restored, it isn't changed\n", path);
+        return -1;
+    }
+
+    // Kept before writing it, so a signal received meanwhile also restores it
+    struct preflight_setting *setting = &(changed_settings[number_of_changed_settings]);
+    snprintf(setting->path, sizeof(setting->path), "%s", path);
+    snprintf(setting->value, sizeof(setting->value), "%s", previous);
+    number_of_changed_settings++;
+
+    if (!write_string(path, value)) {
+        number_of_changed_settings--;
+        if (report_failure)
+            fprintf(stderr, "%s can't be written\n", path);
+        return -1;
+    }
+
+    return 1;
+}
+
+static void register_restore(void) {
+    if (restore_registered)
+        return;
+    setup_process = getpid();
+
+    if (atexit(preflight_restore)) {
+        perror("atexit failed");
+        exit(-1);
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = restore_on_signal;
+    sigemptyset(&(action.sa_mask));
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGHUP, &action, NULL);
+
+    restore_registered = true;
+}
+
+void preflight_apply(const cpu_set_t *cpus) {
+    int changed = 0, failed = 0, irqs_moved = 0, irqs_not_moved = 0, result;
+    char path[PATH_MAX], value[SETTING_VALUE_SIZE];
+
+    register_restore();
+
+    // Move the IRQs to the online CPUs that aren't tested. Many of them can't be moved (per CPU or managed IRQs)
+    cpu_set_t online, housekeeping;
+    CPU_ZERO(&housekeeping);
+    if (read_string(CPU_SYSFS_DIRECTORY "/online", value, sizeof(value)) && parse_cpu_list(value, &online)) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &online) && !CPU_ISSET(cpu, cpus))
+                CPU_SET(cpu, &housekeeping);
+        }
+    }
+
+    DIR *irqs = CPU_COUNT(&housekeeping) ? opendir("/proc/irq") : NULL;
+    if (irqs != NULL) {
+        char housekeeping_list[SETTING_VALUE_SIZE];
+        format_cpu_list(&housekeeping, housekeeping_list, sizeof(housekeeping_list));
+
+        struct dirent *entry;
+        while ((entry = readdir(irqs)) != NULL) {
+            cpu_set_t affinity;
+            snprintf(path, sizeof(path), "/proc/irq/%s/smp_affinity_list", entry->d_name);
+            if (!isdigit((unsigned char) entry->d_name[0]) || !read_string(path, value, sizeof(value)) ||
+                !parse_cpu_list(value, &affinity) || !cpus_intersect(cpus, &affinity))
+                continue;
+
+            result = change_setting(path, housekeeping_list, false);
+            irqs_moved += result > 0;
+            irqs_not_moved += result < 0;
+        }
+        closedir(irqs);
+    } else {
+        fprintf(stderr, "the IRQs can't be moved out of the tested CPUs\n");
+    }
+
+    // Disable the turbo/boost before locking the frequency, the maximum frequency can change with it
+    result = change_setting(CPU_SYSFS_DIRECTORY "/cpufreq/boost", "0", true);
+    if (result == 0)
+        result = change_setting(CPU_SYSFS_DIRECTORY "/intel_pstate/no_turbo", "1", true);
+    changed += result > 0;
+    failed += result < 0;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, cpus))
+            continue;
+
+        // Performance governor and the minimum frequency locked to the maximum one
+        snprintf(path, sizeof(path), CPU_SYSFS_DIRECTORY "/cpu%d/cpufreq/scaling_governor", cpu);
+        result = change_setting(path, "performance", true);
+        changed += result > 0;
+        failed += result < 0;
+
+        snprintf(path, sizeof(path), CPU_SYSFS_DIRECTORY "/cpu%d/cpufreq/scaling_max_freq", cpu);
+        if (read_string(path, value, sizeof(value))) {
+            snprintf(path, sizeof(path), CPU_SYSFS_DIRECTORY "/cpu%d/cpufreq/scaling_min_freq", cpu);
+            result = change_setting(path, value, true);
+            changed += result > 0;
+            failed += result < 0;
+        }
+
+        // C-states with an exit latency over the limit
+        for (int state = 0; ; ++state) {
+            snprintf(path, sizeof(path), CPU_SYSFS_DIRECTORY "/cpu%d/cpuidle/state%d/latency", cpu, state);
+            long long latency = read_long(path, -1);
+            if (latency < 0)
+                break;
+            if (latency <= PREFLIGHT_MAX_CSTATE_LATENCY_MICROSECONDS)
+                continue;
+
+            snprintf(path, sizeof(path), CPU_SYSFS_DIRECTORY "/cpu%d/cpuidle/state%d/disable", cpu, state);
+            result = change_setting(path, "1", true);
+            changed += result > 0;
+            failed += result < 0;
+        }
+    }
+
+    result = change_setting("/proc/sys/kernel/sched_rt_runtime_us", "-1", true);
+    changed += result > 0;
+    failed += result < 0;
+
+    // The benchmarks that use transparent huge pages request them with madvise
+    if (read_string(TRANSPARENT_HUGE_PAGES_DIRECTORY "/enabled", value, sizeof(value))) {
+        select_value(value);
+        if (strcmp(value, "always") == 0) {
+            result = change_setting(TRANSPARENT_HUGE_PAGES_DIRECTORY "/enabled", "madvise", true);
+            changed += result > 0;
+            failed += result < 0;
+        }
+    }
+
+    printf("Low noise setup: \n\t%s: %d\n\t%s: %d\n\t%s: %d\n\t%s: %d\n", "Settings changed", changed,
+           "Settings that couldn't be changed", failed, "IRQs moved out of the tested CPUs", irqs_moved,
+           "IRQs that couldn't be moved", irqs_not_moved);
+}
+
+static void *warm_up_execution(void *data) {
+    struct preflight_warm_up_result *result = (struct preflight_warm_up_result *) data;
+    long long fastest_work_ns = LLONG_MAX;
+    int stable_windows = 0;
+    uint64_t value = 1;
+
+    uint64_t start = timer_read();
+    while (true) {
+        // Dependent multiplications, their time only depends on the frequency
+        uint64_t before = timer_read();
+        for (long i = 0; i < PREFLIGHT_WARM_UP_WORK_ITERATIONS; ++i)
+            value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t after = timer_read();
+
+        // While the frequency ramps up the work gets faster. The slower windows are the ones hit by interrupts
+        long long work_ns = timer_interval_ns(before, after);
+        if (fastest_work_ns == LLONG_MAX)
+            result->first_work_ns = work_ns;
+        if (work_ns * 100.0 < (100.0 - PREFLIGHT_WARM_UP_TOLERANCE_PERCENT) * fastest_work_ns)
+            stable_windows = 0;
+        else
+            stable_windows++;
+        if (work_ns < fastest_work_ns)
+            fastest_work_ns = work_ns;
+
+        result->fastest_work_ns = fastest_work_ns;
+        result->duration_ns = timer_interval_ns(start, after);
+
+        if (stable_windows >= PREFLIGHT_WARM_UP_STABLE_WINDOWS) {
+            result->stable = true;
+            break;
+        }
+        if (result->duration_ns >= PREFLIGHT_WARM_UP_TIMEOUT_MILLISECONDS * 1000000LL)
+            break;
+    }
+
+    // Keep the result of the work so it isn't removed by the compiler
+    return (void *) (uintptr_t) (value & 1);
+}
+
+void preflight_warm_up(const cpu_set_t *cpus) {
+    int number_of_cpus = CPU_COUNT(cpus);
+    struct preflight_warm_up_result *results = calloc(number_of_cpus, sizeof(struct preflight_warm_up_result));
+    pthread_t *threads = malloc(number_of_cpus * sizeof(pthread_t));
+    if (results == NULL || threads == NULL) {
+        perror("malloc failed");
+        exit(-1);
+    }
+
+    // All the tested CPUs are warmed up at the same time, their frequencies can depend on each other
+    int i = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && i < number_of_cpus; ++cpu) {
+        if (!CPU_ISSET(cpu, cpus))
+            continue;
+
+        pthread_attr_t attr;
+        cpu_set_t affinity_mask;
+        CPU_ZERO(&affinity_mask);
+        CPU_SET(cpu, &affinity_mask);
+
+        // Small stack, the memory can be locked
+        if (pthread_attr_init(&attr) || pthread_attr_setstacksize(&attr, PTHREAD_STACK_MIN + 0x4000) ||
+            pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &affinity_mask)) {
+            perror("pthread attributes failed");
+            exit(-1);
+        }
+
+        results[i].cpu = cpu;
+        if (pthread_create(&threads[i], &attr, warm_up_execution, &results[i])) {
+            perror("thread creation failed");
+            exit(-1);
+        }
+        pthread_attr_destroy(&attr);
+        i++;
+    }
+
+    printf("Warm up: \n");
+    for (i = 0; i < number_of_cpus; ++i) {
+        pthread_join(threads[i], NULL);
+        printf("\tCPU %d: %s after %.1f ms, work of %lld ns (%lld ns at the start)\n", results[i].cpu,
+               results[i].stable ? "stable" : "not stable", results[i].duration_ns / 1e6,
+               results[i].fastest_work_ns, results[i].first_work_ns);
+    }
+
+    free(results);
+    free(threads);
+}
@@ -0,0 +1,79 @@
+//
+// Preflight of the benchmarks: the settings of the machine that add variance to the costs measured in the tested CPUs
+//
+// Checked settings:
+//  - isolation of the tested CPUs: isolcpus, nohz_full and rcu_nocbs
+//  - IRQs whose affinity includes the tested CPUs
+//  - cpufreq governor, frequency locking and turbo/boost
+//  - C-states enabled in the tested CPUs
+//  - RT throttling (sched_rt_runtime_us)
+//  - transparent huge pages and khugepaged activity
+// The isolation is set in the kernel command line, so it is only reported. The low noise setup (needs root) moves the
+// IRQs to the other CPUs, disables the turbo/boost, sets the performance governor and locks the frequency of the tested
+// CPUs, disables their C-states with an exit latency over the limit, disables the RT throttling and restricts the
+// transparent huge pages to madvise regions. The previous values are written back at exit, or on SIGINT, SIGTERM or
+// SIGHUP.
+//
+// Before sampling, a warm up keeps the tested CPUs busy until a fixed amount of work stops getting faster, so the
+// samples aren't taken while the frequency is still ramping up.
+//
+#ifndef PREFLIGHT_H
+#define PREFLIGHT_H
+
+#include <sched.h>
+#include <stdbool.h>
+
+// Issues kept in a report, and length of their descriptions
+#define PREFLIGHT_MAX_ISSUES 32
+#define PREFLIGHT_ISSUE_SIZE 160
+
+// C-states of the tested CPUs with a bigger exit latency are reported, and disabled by the low noise setup
+#define PREFLIGHT_MAX_CSTATE_LATENCY_MICROSECONDS 10
+
+// Settings that can be changed by the low noise setup (the affinity of each IRQ is one setting)
+#define PREFLIGHT_MAX_SETTINGS 1024
+
+// Warm up: iterations of the work whose time is measured, consecutive measures not faster than the fastest one (within
+// the tolerance) needed to consider the frequency stable, and maximum duration
+#define PREFLIGHT_WARM_UP_WORK_ITERATIONS (1 << 20)
+#define PREFLIGHT_WARM_UP_STABLE_WINDOWS 20
+#define PREFLIGHT_WARM_UP_TOLERANCE_PERCENT 1.0
+#define PREFLIGHT_WARM_UP_TIMEOUT_MILLISECONDS 3000
+
+struct preflight_report {
+    cpu_set_t cpus;
+
+    // Settings that can disturb the measures of the tested CPUs
+    int number_of_issues;
+    char issues[PREFLIGHT_MAX_ISSUES][PREFLIGHT_ISSUE_SIZE];
+};
+
+struct preflight_warm_up_result {
+    int cpu;
+
+    // If the time of the work became stable before the timeout
+    bool stable;
+
+    // Duration of the warm up, time of the work at its start and fastest time of the work
+    long long duration_ns;
+    long long first_work_ns;
+    long long fastest_work_ns;
+};
+
+// Check the settings that add noise to the given CPUs, print them and the issues found
+void preflight_check(const cpu_set_t *cpus, struct preflight_report *report);
+
+// Print the issues of a report as the possible causes of an unexpected behaviour of a test
+void preflight_print_causes(const struct preflight_report *report);
+
+// Apply the low noise setup to the given CPUs and print the settings changed. The settings that can't be changed are
+// reported and skipped. The previous values are restored at exit
+void preflight_apply(const cpu_set_t *cpus);
+
+// Write back the settings changed by preflight_apply
+void preflight_restore(void);
+
+// Keep the given CPUs busy until their frequency is stable and print the result. It needs timer_init
+void preflight_warm_up(const cpu_set_t *cpus);
+
+#endif // PREFLIGHT_H
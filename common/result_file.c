@@ -0,0 +1,179 @@
+//
+// Versioned file with the raw costs of a benchmark run
+//
+#include "result_file.h"
+
+#include <sys/utsname.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+void result_series_init(struct result_series *series, const char *name, uint64_t capacity) {
+    memset(series, 0, sizeof(struct result_series));
+    snprintf(series->name, sizeof(series->name), "%s", name);
+
+    series->samples = malloc((capacity ? capacity : 1) * sizeof(int64_t));
+    if (series->samples == NULL) {
+        perror("malloc failed");
+        exit(-1);
+    }
+    series->capacity = capacity;
+}
+
+void result_series_reset(struct result_series *series) {
+    series->number_of_samples = 0;
+    series->dropped_samples = 0;
+}
+
+void result_series_destroy(struct result_series *series) {
+    free(series->samples);
+    series->samples = NULL;
+    series->capacity = 0;
+    series->number_of_samples = 0;
+}
+
+void result_config_add(struct result_config *config, const char *key, const char *format, ...) {
+    if (config->number_of_config >= RESULT_FILE_MAX_CONFIG) {
+        fprintf(stderr, "too many configuration parameters in the result file\n");
+        exit(-1);
+    }
+
+    snprintf(config->keys[config->number_of_config], sizeof(config->keys[0]), "%s", key);
+
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(config->values[config->number_of_config], sizeof(config->values[0]), format, arguments);
+    va_end(arguments);
+
+    config->number_of_config++;
+}
+
+bool result_config_equal(const struct result_config *config, const struct result_config *other) {
+    if (config->number_of_config != other->number_of_config)
+        return false;
+
+    for (uint32_t i = 0; i < config->number_of_config; ++i) {
+        if (strcmp(config->keys[i], other->keys[i]) != 0 || strcmp(config->values[i], other->values[i]) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+void result_file_write(const char *path, const char *benchmark, const struct result_config *config,
+                       const struct result_series *series, int number_of_series) {
+    if (number_of_series > RESULT_FILE_MAX_SERIES) {
+        fprintf(stderr, "too many series for a result file (maximum %d)\n", RESULT_FILE_MAX_SERIES);
+        exit(-1);
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror("open result file failed");
+        exit(-1);
+    }
+
+    struct result_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RESULT_FILE_MAGIC, sizeof(header.magic));
+    header.version = RESULT_FILE_VERSION;
+    header.number_of_series = number_of_series;
+    snprintf(header.benchmark, sizeof(header.benchmark), "%s", benchmark);
+    header.creation_time = time(NULL);
+    header.config = *config;
+
+    struct utsname host;
+    if (uname(&host) == 0) {
+        snprintf(header.hostname, sizeof(header.hostname), "%s", host.nodename);
+        snprintf(header.kernel_release, sizeof(header.kernel_release), "%s", host.release);
+    }
+
+    bool failed = fwrite(&header, sizeof(header), 1, file) != 1;
+    for (int i = 0; i < number_of_series && !failed; ++i) {
+        struct result_series_header series_header;
+        memset(&series_header, 0, sizeof(series_header));
+        memcpy(series_header.name, series[i].name, sizeof(series_header.name));
+        series_header.number_of_samples = series[i].number_of_samples;
+        series_header.dropped_samples = series[i].dropped_samples;
+
+        failed = fwrite(&series_header, sizeof(series_header), 1, file) != 1 ||
+                 fwrite(series[i].samples, sizeof(int64_t), series[i].number_of_samples, file) !=
+                 series[i].number_of_samples;
+    }
+
+    if (fclose(file) || failed) {
+        perror("write result file failed");
+        exit(-1);
+    }
+
+    printf("Result file: \n\t%s: %s\n\t%s: %d\n", "File", path, "Number of series", number_of_series);
+}
+
+void result_file_read(const char *path, struct result_run *run) {
+    memset(run, 0, sizeof(struct result_run));
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror("open result file failed");
+        exit(-1);
+    }
+
+    if (fread(&(run->header), sizeof(run->header), 1, file) != 1 ||
+        memcmp(run->header.magic, RESULT_FILE_MAGIC, sizeof(run->header.magic)) != 0) {
+        fprintf(stderr, "%s isn't a result file\n", path);
+        exit(-1);
+    }
+
+    if (run->header.version != RESULT_FILE_VERSION || run->header.number_of_series > RESULT_FILE_MAX_SERIES) {
+        fprintf(stderr, "%s has version %u, only version %d is supported\n", path, run->header.version,
+                RESULT_FILE_VERSION);
+        exit(-1);
+    }
+
+    // Keep the strings terminated even if the file is corrupt
+    if (run->header.config.number_of_config > RESULT_FILE_MAX_CONFIG) {
+        fprintf(stderr, "%s has an invalid configuration\n", path);
+        exit(-1);
+    }
+    for (uint32_t i = 0; i < run->header.config.number_of_config; ++i) {
+        run->header.config.keys[i][sizeof(run->header.config.keys[0]) - 1] = '\0';
+        run->header.config.values[i][sizeof(run->header.config.values[0]) - 1] = '\0';
+    }
+
+    for (uint32_t i = 0; i < run->header.number_of_series; ++i) {
+        struct result_series_header series_header;
+        if (fread(&series_header, sizeof(series_header), 1, file) != 1) {
+            fprintf(stderr, "%s is truncated\n", path);
+            exit(-1);
+        }
+        series_header.name[sizeof(series_header.name) - 1] = '\0';
+
+        struct result_series *series = &(run->series[i]);
+        result_series_init(series, series_header.name, series_header.number_of_samples);
+        series->number_of_samples = series_header.number_of_samples;
+        series->dropped_samples = series_header.dropped_samples;
+        if (fread(series->samples, sizeof(int64_t), series->number_of_samples, file) != series->number_of_samples) {
+            fprintf(stderr, "%s is truncated\n", path);
+            exit(-1);
+        }
+    }
+
+    fclose(file);
+}
+
+const struct result_series *result_run_find(const struct result_run *run, const char *name) {
+    for (uint32_t i = 0; i < run->header.number_of_series; ++i) {
+        if (strcmp(run->series[i].name, name) == 0)
+            return &(run->series[i]);
+    }
+
+    return NULL;
+}
+
+void result_run_destroy(struct result_run *run) {
+    for (uint32_t i = 0; i < run->header.number_of_series; ++i)
+        result_series_destroy(&(run->series[i]));
+}
@@ -0,0 +1,106 @@
+//
+// Versioned file with the raw costs of a benchmark run, used to compare runs (comparison/compare_results)
+//
+// File format: a struct result_file_header followed, for each series, by a struct result_series_header and its
+// number_of_samples costs in nanoseconds (int64_t), in the byte order of the machine that wrote the file
+//
+#ifndef RESULT_FILE_H
+#define RESULT_FILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define RESULT_FILE_MAGIC "RTRESULT"
+#define RESULT_FILE_VERSION 2
+#define RESULT_FILE_MAX_SERIES 16
+#define RESULT_FILE_MAX_CONFIG 16
+#define RESULT_FILE_CONFIG_VALUE_BYTES 64
+
+// Samples kept of a series without a known number of experiments (runs limited by time)
+#define RESULT_SERIES_DEFAULT_CAPACITY 1000000
+
+// Configuration of the run as key and value pairs (mode, experiments, antagonists...), only runs with the same
+// configuration are compared
+struct result_config {
+    uint32_t number_of_config;
+    char keys[RESULT_FILE_MAX_CONFIG][32];
+    char values[RESULT_FILE_MAX_CONFIG][RESULT_FILE_CONFIG_VALUE_BYTES];
+};
+
+struct result_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t number_of_series;
+
+    // Benchmark that wrote the file, host, kernel release and time of the run
+    char benchmark[32];
+    char hostname[72];
+    char kernel_release[72];
+    int64_t creation_time;
+
+    struct result_config config;
+};
+
+struct result_series_header {
+    // Name of the cost ("preemption", "migration", "fill_64_bits"...)
+    char name[32];
+
+    uint64_t number_of_samples;
+
+    // Samples that didn't fit in the series
+    uint64_t dropped_samples;
+};
+
+// Costs of a series, allocated once so recording never allocates
+struct result_series {
+    char name[32];
+    int64_t *samples;
+    uint64_t number_of_samples;
+    uint64_t capacity;
+    uint64_t dropped_samples;
+};
+
+// Series read from a file
+struct result_run {
+    struct result_file_header header;
+    struct result_series series[RESULT_FILE_MAX_SERIES];
+};
+
+// Allocate a series for capacity samples. It exits if the memory can't be allocated
+void result_series_init(struct result_series *series, const char *name, uint64_t capacity);
+
+// Record a cost, it is dropped if the series is full
+static inline void result_series_record(struct result_series *series, int64_t value) {
+    if (series->number_of_samples < series->capacity)
+        series->samples[series->number_of_samples++] = value;
+    else
+        series->dropped_samples++;
+}
+
+// Discard the recorded samples
+void result_series_reset(struct result_series *series);
+
+// Free the samples of a series
+void result_series_destroy(struct result_series *series);
+
+// Add a configuration parameter of the run. It exits if there are too many
+void result_config_add(struct result_config *config, const char *key, const char *format, ...)
+        __attribute__((format(printf, 3, 4)));
+
+// Check if two runs have the same configuration
+bool result_config_equal(const struct result_config *config, const struct result_config *other);
+
+// Write the series of a run with its configuration. It exits if the file can't be written
+void result_file_write(const char *path, const char *benchmark, const struct result_config *config,
+                       const struct result_series *series, int number_of_series);
+
+// Read a file written by result_file_write. It exits if the file isn't valid
+void result_file_read(const char *path, struct result_run *run);
+
+// Find a series of a run by name, NULL if it isn't in the run
+const struct result_series *result_run_find(const struct result_run *run, const char *name);
+
+// Free the series of a run
+void result_run_destroy(struct result_run *run);
+
+#endif // RESULT_FILE_H
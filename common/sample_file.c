@@ -0,0 +1,106 @@
+//
+// Binary file where the raw samples are streamed through a sliding mmap window
+//
+#include "sample_file.h"
+#include "timer.h"
+
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static void map_window(struct sample_file *file) {
+    /***
+     * Grow the file and map the window that starts at window_offset
+     */
+
+    if (ftruncate(file->fd, file->window_offset + SAMPLE_FILE_WINDOW_BYTES)) {
+        perror("ftruncate failed");
+        exit(-1);
+    }
+
+    file->window = mmap(NULL, SAMPLE_FILE_WINDOW_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd,
+                        file->window_offset);
+    if (file->window == MAP_FAILED) {
+        perror("mmap failed");
+        exit(-1);
+    }
+
+    file->window_used = 0;
+}
+
+static void unmap_window(struct sample_file *file) {
+    /***
+     * Write back and release the current window, so the memory used doesn't grow with the file
+     */
+
+    msync(file->window, SAMPLE_FILE_WINDOW_BYTES, MS_ASYNC);
+    munmap(file->window, SAMPLE_FILE_WINDOW_BYTES);
+    file->window = NULL;
+}
+
+static void append(struct sample_file *file, const void *data, long size) {
+    /***
+     * Copy the data to the window. The window is moved by whole windows, so its offset stays a multiple of the page
+     * size whatever the record size is, and a record that doesn't fit in the rest of the window is split between
+     * this window and the next one
+     */
+
+    const char *bytes = data;
+
+    while (size > 0) {
+        if (file->window_used == SAMPLE_FILE_WINDOW_BYTES) {
+            unmap_window(file);
+            file->window_offset += SAMPLE_FILE_WINDOW_BYTES;
+            map_window(file);
+        }
+
+        long chunk = SAMPLE_FILE_WINDOW_BYTES - file->window_used;
+        if (chunk > size)
+            chunk = size;
+
+        memcpy(file->window + file->window_used, bytes, chunk);
+        file->window_used += chunk;
+        bytes += chunk;
+        size -= chunk;
+    }
+}
+
+void sample_file_open(struct sample_file *file, const char *path, const char *benchmark) {
+    memset(file, 0, sizeof(struct sample_file));
+
+    file->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file->fd < 0) {
+        perror("open sample file failed");
+        exit(-1);
+    }
+
+    map_window(file);
+
+    struct sample_file_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SAMPLE_FILE_MAGIC, sizeof(header.magic));
+    header.version = SAMPLE_FILE_VERSION;
+    header.record_size = sizeof(struct ring_sample);
+    header.ns_per_tick = timer_ns_per_tick;
+    header.timer_overhead_ticks = timer_overhead_ticks;
+    snprintf(header.benchmark, sizeof(header.benchmark), "%s", benchmark);
+
+    append(file, &header, sizeof(header));
+}
+
+void sample_file_write(struct sample_file *file, const struct ring_sample *sample) {
+    append(file, sample, sizeof(struct ring_sample));
+    file->number_of_records++;
+}
+
+void sample_file_close(struct sample_file *file) {
+    long file_size = file->window_offset + file->window_used;
+
+    unmap_window(file);
+    if (ftruncate(file->fd, file_size))
+        perror("ftruncate failed");
+    close(file->fd);
+}
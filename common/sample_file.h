@@ -0,0 +1,57 @@
+//
+// Binary file where the raw samples are streamed through a sliding mmap window
+//
+// File format: a struct sample_file_header followed by struct ring_sample records
+//
+#ifndef SAMPLE_FILE_H
+#define SAMPLE_FILE_H
+
+#include <stdint.h>
+
+#include "sample_ring.h"
+
+#define SAMPLE_FILE_MAGIC "RTSAMPLE"
+#define SAMPLE_FILE_VERSION 2
+
+// Size of the file region mapped at a time (a multiple of the page size, records may span two windows)
+#define SAMPLE_FILE_WINDOW_BYTES (16L * 1024 * 1024)
+
+struct sample_file_header {
+    char magic[8];
+    uint32_t version;
+
+    // Size of each record
+    uint32_t record_size;
+
+    // Conversion of the timestamps of the records to nanoseconds, and timer overhead in ticks
+    double ns_per_tick;
+    int64_t timer_overhead_ticks;
+
+    // Name of the benchmark that wrote the file
+    char benchmark[32];
+};
+
+struct sample_file {
+    int fd;
+
+    // Mapped window and its position in the file (always a multiple of SAMPLE_FILE_WINDOW_BYTES)
+    char *window;
+    long window_offset;
+
+    // Bytes written in the window
+    long window_used;
+
+    // Number of records written
+    uint64_t number_of_records;
+};
+
+// Create the file and write its header
+void sample_file_open(struct sample_file *file, const char *path, const char *benchmark);
+
+// Append a record to the file
+void sample_file_write(struct sample_file *file, const struct ring_sample *sample);
+
+// Truncate the file to the written records and close it
+void sample_file_close(struct sample_file *file);
+
+#endif // SAMPLE_FILE_H
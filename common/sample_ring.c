@@ -0,0 +1,24 @@
+//
+// Single-producer single-consumer ring buffer of raw samples
+//
+#include "sample_ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct sample_ring *sample_ring_create(void) {
+    struct sample_ring *ring = aligned_alloc(CACHE_LINE_SIZE_BYTES, sizeof(struct sample_ring));
+    if (ring == NULL) {
+        perror("aligned_alloc failed");
+        exit(-1);
+    }
+
+    // Touch all the ring so it is backed by memory before the measures
+    memset(ring, 0, sizeof(struct sample_ring));
+    return ring;
+}
+
+void sample_ring_destroy(struct sample_ring *ring) {
+    free(ring);
+}
@@ -0,0 +1,98 @@
+//
+// Single-producer single-consumer ring buffer of raw samples
+//
+// Each measuring thread owns its ring, the producer and consumer indexes are in different cache lines and the rings are
+// allocated apart, so the measuring threads never share a line. The producer never blocks: if the ring is full the
+// sample is dropped and counted.
+//
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "perf_counters.h"
+
+// Number of samples of each ring (power of two)
+#define SAMPLE_RING_CAPACITY 8192
+
+#define CACHE_LINE_SIZE_BYTES 64
+
+// Flags of the samples: some interrupt, softirq or SMI happened while the sample was taken (see noise.h)
+#define RING_SAMPLE_CONTAMINATED 0x1
+
+// Raw sample, its meaning depends on the benchmark
+struct ring_sample {
+    // Thread that took the sample
+    uint32_t thread;
+
+    // Flags of the sample (RING_SAMPLE_*)
+    uint32_t flags;
+
+    // Number of the experiment
+    uint64_t sequence;
+
+    // Timestamps or values of the sample
+    uint64_t values[2];
+
+    // Deltas of the performance counters during the sample (zero if they aren't used)
+    int64_t counters[NUMBER_OF_PERF_COUNTERS];
+};
+
+struct sample_ring {
+    // Next position to write, only modified by the producer
+    uint64_t head __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
+
+    // Samples dropped because the ring was full, only modified by the producer
+    uint64_t dropped;
+
+    // Next position to read, only modified by the consumer
+    uint64_t tail __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
+
+    struct ring_sample samples[SAMPLE_RING_CAPACITY] __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
+};
+
+// Allocate an empty ring
+struct sample_ring *sample_ring_create(void);
+
+// Release a ring
+void sample_ring_destroy(struct sample_ring *ring);
+
+static inline bool sample_ring_push(struct sample_ring *ring, const struct ring_sample *sample) {
+    /***
+     * Add a sample to the ring (producer side). Return false if it is full and the sample has been dropped
+     */
+
+    uint64_t head = ring->head;
+    if (head - __atomic_load_n(&(ring->tail), __ATOMIC_ACQUIRE) >= SAMPLE_RING_CAPACITY) {
+        ring->dropped++;
+        return false;
+    }
+
+    ring->samples[head & (SAMPLE_RING_CAPACITY - 1)] = *sample;
+    __atomic_store_n(&(ring->head), head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+static inline const struct ring_sample *sample_ring_peek(struct sample_ring *ring) {
+    /***
+     * Get the oldest sample of the ring without removing it (consumer side), or NULL if it is empty
+     */
+
+    uint64_t tail = ring->tail;
+    if (tail == __atomic_load_n(&(ring->head), __ATOMIC_ACQUIRE))
+        return NULL;
+
+    return &(ring->samples[tail & (SAMPLE_RING_CAPACITY - 1)]);
+}
+
+static inline void sample_ring_pop(struct sample_ring *ring) {
+    /***
+     * Remove the oldest sample of the ring (consumer side), it must have been obtained with sample_ring_peek
+     */
+
+    __atomic_store_n(&(ring->tail), ring->tail + 1, __ATOMIC_RELEASE);
+}
+
+#endif // SAMPLE_RING_H
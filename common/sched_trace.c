@@ -0,0 +1,511 @@
+//
+// Scheduler tracepoints of one CPU read from the raw ftrace ring buffer (tracefs)
+//
+#define _GNU_SOURCE
+
+#include "sched_trace.h"
+#include "timer.h"
+
+#include <sys/mount.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+
+// Mount points where tracefs is looked for, the first one is used to mount it if it isn't mounted
+static const char *tracefs_paths[] = {"/sys/kernel/tracing", "/sys/kernel/debug/tracing"};
+
+// Size of the buffer where the format files are read
+#define SCHED_TRACE_FORMAT_BYTES 8192
+
+// Header of the events of the ring buffer (include/linux/ring_buffer.h)
+#define RINGBUF_TYPE_DATA_TYPE_LEN_MAX 28
+#define RINGBUF_TYPE_PADDING 29
+#define RINGBUF_TYPE_TIME_EXTEND 30
+#define RINGBUF_TYPE_TIME_STAMP 31
+#define RINGBUF_TIME_SHIFT 27
+#define RINGBUF_TIME_STAMP_BITS 59
+
+// Flags stored in the high bits of the commit field of the pages
+#define RINGBUF_COMMIT_MASK ((1UL << 30) - 1)
+
+// Number of timer and clock reads of the calibration, the pair with the narrowest bracket is kept
+#define SCHED_TRACE_CALIBRATION_READS 100
+
+struct sched_trace_event_description {
+    const char *system;
+    const char *name;
+    const char *field_names[SCHED_TRACE_MAX_FIELDS];
+
+    // The events that aren't required may not exist (local_timer_entry only exists in x86)
+    bool required;
+};
+
+static const struct sched_trace_event_description event_descriptions[NUMBER_OF_SCHED_TRACE_EVENTS] = {
+        [SCHED_TRACE_SWITCH] = {"sched", "sched_switch", {"prev_pid", "next_pid"}, true},
+        [SCHED_TRACE_WAKEUP] = {"sched", "sched_wakeup", {"pid", "target_cpu"}, true},
+        [SCHED_TRACE_IRQ] = {"irq", "irq_handler_entry", {"irq", NULL}, true},
+        [SCHED_TRACE_SOFTIRQ] = {"irq", "softirq_entry", {"vec", NULL}, true},
+        [SCHED_TRACE_LOCAL_TIMER] = {"irq_vectors", "local_timer_entry", {"vector", NULL}, false},
+        [SCHED_TRACE_SYSCALL_ENTER] = {"raw_syscalls", "sys_enter", {"id", NULL}, true},
+        [SCHED_TRACE_SYSCALL_EXIT] = {"raw_syscalls", "sys_exit", {"id", "ret"}, true}
+};
+
+static bool write_file(const char *directory, const char *file, const char *value) {
+    /***
+     * Write value in directory/file, return false if it can't be written
+     */
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", directory, file);
+
+    int fd = open(path, O_WRONLY | O_TRUNC);
+    if (fd < 0)
+        return false;
+
+    bool written = write(fd, value, strlen(value)) == (ssize_t) strlen(value);
+    close(fd);
+    return written;
+}
+
+static void write_file_or_exit(const char *directory, const char *file, const char *value) {
+    if (!write_file(directory, file, value)) {
+        fprintf(stderr, "%s/%s can't be written\n", directory, file);
+        perror("write failed");
+        exit(-1);
+    }
+}
+
+static bool read_file(const char *path, char *buffer, long size) {
+    /***
+     * Read a whole text file, return false if it can't be read
+     */
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    long length = 0;
+    for (;;) {
+        long read_bytes = read(fd, buffer + length, size - 1 - length);
+        if (read_bytes <= 0)
+            break;
+        length += read_bytes;
+    }
+    buffer[length] = '\0';
+
+    close(fd);
+    return true;
+}
+
+static bool find_field(const char *format, const char *name, struct sched_trace_field *field) {
+    /***
+     * Get the offset and size of a field from the text of a format file, where each field is described as
+     * "field:<type> <name>;\toffset:<offset>;\tsize:<size>;"
+     */
+
+    const char *position = format;
+    while ((position = strstr(position, "field:")) != NULL) {
+        const char *end = strchr(position, ';');
+        if (end == NULL)
+            return false;
+
+        // The name is the last word before the semicolon (arrays aren't needed)
+        const char *name_start = end;
+        while (name_start > position && name_start[-1] != ' ')
+            name_start--;
+
+        if ((long) strlen(name) == end - name_start && strncmp(name_start, name, end - name_start) == 0) {
+            const char *offset = strstr(end, "offset:");
+            const char *size = strstr(end, "size:");
+            if (offset == NULL || size == NULL)
+                return false;
+
+            field->offset = (int) strtol(offset + 7, NULL, 10);
+            field->size = (int) strtol(size + 5, NULL, 10);
+            return true;
+        }
+
+        position = end;
+    }
+
+    return false;
+}
+
+static const char *find_tracefs(void) {
+    /***
+     * Get the mount point of tracefs, mounting it if needed
+     */
+
+    char path[PATH_MAX];
+    for (unsigned i = 0; i < sizeof(tracefs_paths) / sizeof(tracefs_paths[0]); ++i) {
+        snprintf(path, sizeof(path), "%s/trace", tracefs_paths[i]);
+        if (access(path, F_OK) == 0)
+            return tracefs_paths[i];
+    }
+
+    if (mount("nodev", tracefs_paths[0], "tracefs", 0, NULL)) {
+        perror("tracefs mount failed");
+        exit(-1);
+    }
+
+    return tracefs_paths[0];
+}
+
+static void read_formats(struct sched_trace *trace, const char *tracefs) {
+    /***
+     * Get the id and the location of the fields of each event, and the layout of the pages of the ring buffer
+     */
+
+    char path[PATH_MAX];
+    char format[SCHED_TRACE_FORMAT_BYTES];
+
+    for (int type = 0; type < NUMBER_OF_SCHED_TRACE_EVENTS; ++type) {
+        const struct sched_trace_event_description *description = &(event_descriptions[type]);
+        trace->event_ids[type] = -1;
+
+        snprintf(path, sizeof(path), "%s/events/%s/%s/format", tracefs, description->system, description->name);
+        if (!read_file(path, format, sizeof(format))) {
+            if (description->required) {
+                fprintf(stderr, "the tracepoint %s:%s isn't available\n", description->system, description->name);
+                exit(-1);
+            }
+            continue;
+        }
+
+        const char *id = strstr(format, "ID:");
+        struct sched_trace_field common_pid;
+        if (id == NULL || !find_field(format, "common_pid", &common_pid)) {
+            fprintf(stderr, "the format of %s:%s is not valid\n", description->system, description->name);
+            exit(-1);
+        }
+        trace->event_ids[type] = (int) strtol(id + 3, NULL, 10);
+        trace->common_pid_offset = common_pid.offset;
+
+        for (int i = 0; i < SCHED_TRACE_MAX_FIELDS; ++i) {
+            trace->fields[type][i].size = 0;
+            if (description->field_names[i] != NULL &&
+                !find_field(format, description->field_names[i], &(trace->fields[type][i]))) {
+                fprintf(stderr, "the field %s of %s:%s doesn't exist\n", description->field_names[i],
+                        description->system, description->name);
+                exit(-1);
+            }
+        }
+    }
+
+    // Layout of the pages: a timestamp, the commit (size of the data and flags) and the data
+    struct sched_trace_field commit, data;
+    snprintf(path, sizeof(path), "%s/events/header_page", tracefs);
+    if (!read_file(path, format, sizeof(format)) || !find_field(format, "commit", &commit) ||
+        !find_field(format, "data", &data)) {
+        fprintf(stderr, "the header of the ring buffer pages can't be read\n");
+        exit(-1);
+    }
+    trace->commit_offset = commit.offset;
+    trace->commit_size = commit.size;
+    trace->data_offset = data.offset;
+    trace->page_bytes = data.offset + data.size;
+}
+
+static void calibrate_clock(uint64_t *ticks, uint64_t *nanoseconds) {
+    /***
+     * Take a pair of timestamps of the timer and of CLOCK_MONOTONIC (the trace clock) at the same time
+     */
+
+    uint64_t narrowest_bracket = UINT64_MAX;
+
+    for (int i = 0; i < SCHED_TRACE_CALIBRATION_READS; ++i) {
+        struct timespec now;
+        uint64_t before = timer_read();
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t after = timer_read();
+
+        if (after - before < narrowest_bracket) {
+            narrowest_bracket = after - before;
+            *ticks = before + (after - before) / 2;
+            *nanoseconds = (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+        }
+    }
+}
+
+void sched_trace_start(struct sched_trace *trace, int cpu) {
+    memset(trace, 0, sizeof(struct sched_trace));
+    trace->cpu = cpu;
+
+    const char *tracefs = find_tracefs();
+    read_formats(trace, tracefs);
+
+    // The instance has its own buffer and settings, so the global tracing is not modified
+    snprintf(trace->instance_path, sizeof(trace->instance_path), "%s/instances/%s", tracefs, SCHED_TRACE_INSTANCE);
+    if (mkdir(trace->instance_path, 0755) && errno != EEXIST) {
+        perror("tracefs instance creation failed");
+        exit(-1);
+    }
+
+    write_file_or_exit(trace->instance_path, "tracing_on", "0");
+    write_file_or_exit(trace->instance_path, "trace_clock", "mono");
+
+    // Keep the first events when the buffer is full, the lost ones are counted
+    write_file_or_exit(trace->instance_path, "options/overwrite", "0");
+
+    // Only the traced CPU records events, and only its buffer is enlarged. The mask is written as comma separated
+    // groups of 32 bits, the most significant first
+    char value[PATH_MAX];
+    int length = 0;
+    for (int group = cpu / 32; group >= 0; --group)
+        length += snprintf(value + length, sizeof(value) - length, group ? "%08x," : "%08x",
+                           group == cpu / 32 ? 1U << (cpu % 32) : 0U);
+    write_file_or_exit(trace->instance_path, "tracing_cpumask", value);
+
+    char file[PATH_MAX];
+    snprintf(file, sizeof(file), "per_cpu/cpu%d/buffer_size_kb", cpu);
+    snprintf(value, sizeof(value), "%d", SCHED_TRACE_BUFFER_KILOBYTES);
+    write_file_or_exit(trace->instance_path, file, value);
+
+    for (int type = 0; type < NUMBER_OF_SCHED_TRACE_EVENTS; ++type) {
+        if (trace->event_ids[type] < 0)
+            continue;
+
+        snprintf(file, sizeof(file), "events/%s/%s/enable", event_descriptions[type].system,
+                 event_descriptions[type].name);
+        write_file_or_exit(trace->instance_path, file, "1");
+    }
+
+    // Clear the events of a previous run of the instance
+    write_file_or_exit(trace->instance_path, "trace", "");
+
+    calibrate_clock(&(trace->start_ticks), &(trace->start_ns));
+    write_file_or_exit(trace->instance_path, "tracing_on", "1");
+}
+
+static long read_field(const unsigned char *record, const struct sched_trace_field *field) {
+    /***
+     * Read a signed integer field of a record
+     */
+
+    switch (field->size) {
+        case 1:
+            return *(const int8_t *) (record + field->offset);
+        case 2: {
+            int16_t value;
+            memcpy(&value, record + field->offset, sizeof(value));
+            return value;
+        }
+        case 4: {
+            int32_t value;
+            memcpy(&value, record + field->offset, sizeof(value));
+            return value;
+        }
+        case 8: {
+            int64_t value;
+            memcpy(&value, record + field->offset, sizeof(value));
+            return (long) value;
+        }
+        default:
+            return 0;
+    }
+}
+
+static void add_record(struct sched_trace *trace, const unsigned char *record, long record_bytes,
+                       uint64_t timestamp_ns) {
+    /***
+     * Decode the record of an event and append it to the events of the trace if it is one of the traced events
+     */
+
+    if (record_bytes < 2)
+        return;
+
+    uint16_t common_type;
+    memcpy(&common_type, record, sizeof(common_type));
+
+    for (int type = 0; type < NUMBER_OF_SCHED_TRACE_EVENTS; ++type) {
+        if (trace->event_ids[type] != common_type)
+            continue;
+
+        if (trace->number_of_events == trace->capacity) {
+            trace->capacity = trace->capacity ? trace->capacity * 2 : 65536;
+            trace->events = realloc(trace->events, trace->capacity * sizeof(struct sched_trace_event));
+            if (trace->events == NULL) {
+                perror("realloc failed");
+                exit(-1);
+            }
+        }
+
+        struct sched_trace_event *event = &(trace->events[trace->number_of_events++]);
+        event->timestamp_ns = timestamp_ns;
+        event->type = type;
+
+        struct sched_trace_field common_pid = {trace->common_pid_offset, 4};
+        event->pid = (int) read_field(record, &common_pid);
+        for (int i = 0; i < SCHED_TRACE_MAX_FIELDS; ++i)
+            event->fields[i] = read_field(record, &(trace->fields[type][i]));
+        return;
+    }
+}
+
+static void parse_page(struct sched_trace *trace, const unsigned char *page) {
+    /***
+     * Decode the events of a page of the ring buffer. Each event has a 32 bits header with its type (or the length
+     * of its data in words) and the time since the previous event
+     */
+
+    uint64_t timestamp;
+    memcpy(&timestamp, page, sizeof(timestamp));
+
+    uint64_t commit = 0;
+    memcpy(&commit, page + trace->commit_offset, trace->commit_size < 8 ? trace->commit_size : 8);
+    long data_bytes = (long) (commit & RINGBUF_COMMIT_MASK);
+    if (data_bytes > trace->page_bytes - trace->data_offset)
+        data_bytes = trace->page_bytes - trace->data_offset;
+
+    const unsigned char *position = page + trace->data_offset;
+    const unsigned char *end = position + data_bytes;
+
+    while (position + 4 <= end) {
+        uint32_t header, array = 0;
+        memcpy(&header, position, sizeof(header));
+        if (position + 8 <= end)
+            memcpy(&array, position + 4, sizeof(array));
+
+        unsigned type_len = header & 0x1f;
+        uint64_t time_delta = header >> 5;
+
+        switch (type_len) {
+            case RINGBUF_TYPE_PADDING:
+                // A null padding fills the rest of the page, other ones are discarded events
+                if (time_delta == 0)
+                    return;
+                position += 4 + array;
+                break;
+            case RINGBUF_TYPE_TIME_EXTEND:
+                timestamp += ((uint64_t) array << RINGBUF_TIME_SHIFT) | time_delta;
+                position += 8;
+                break;
+            case RINGBUF_TYPE_TIME_STAMP:
+                // Absolute timestamp, its upper bits are the ones of the current timestamp
+                timestamp = (timestamp & ~((1ULL << RINGBUF_TIME_STAMP_BITS) - 1)) |
+                            ((uint64_t) array << RINGBUF_TIME_SHIFT) | time_delta;
+                position += 8;
+                break;
+            case 0:
+                // The length of the data (plus the length word itself) is in the first word
+                timestamp += time_delta;
+                add_record(trace, position + 8, (long) array - 4, timestamp);
+                position += 4 + array;
+                break;
+            default:
+                timestamp += time_delta;
+                add_record(trace, position + 4, type_len * 4L, timestamp);
+                position += 4 + type_len * 4L;
+                break;
+        }
+    }
+}
+
+static void read_lost_events(struct sched_trace *trace) {
+    /***
+     * Get the events lost because the buffer was full from the statistics of the traced CPU
+     */
+
+    char path[PATH_MAX + 64];
+    char stats[SCHED_TRACE_FORMAT_BYTES];
+    snprintf(path, sizeof(path), "%s/per_cpu/cpu%d/stats", trace->instance_path, trace->cpu);
+    if (!read_file(path, stats, sizeof(stats)))
+        return;
+
+    const char *overrun = strstr(stats, "overrun:");
+    const char *dropped = strstr(stats, "dropped events:");
+    if (overrun != NULL)
+        trace->lost_events += strtoull(overrun + 8, NULL, 10);
+    if (dropped != NULL)
+        trace->lost_events += strtoull(dropped + 15, NULL, 10);
+}
+
+void sched_trace_stop(struct sched_trace *trace) {
+    write_file_or_exit(trace->instance_path, "tracing_on", "0");
+    calibrate_clock(&(trace->end_ticks), &(trace->end_ns));
+
+    // Read the raw pages of the traced CPU until the buffer is empty
+    char path[PATH_MAX + 64];
+    snprintf(path, sizeof(path), "%s/per_cpu/cpu%d/trace_pipe_raw", trace->instance_path, trace->cpu);
+    int fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (fd < 0) {
+        perror("trace_pipe_raw open failed");
+        exit(-1);
+    }
+
+    unsigned char *page = malloc(trace->page_bytes);
+    if (page == NULL) {
+        perror("malloc failed");
+        exit(-1);
+    }
+
+    for (;;) {
+        long read_bytes = read(fd, page, trace->page_bytes);
+        if (read_bytes <= 0)
+            break;
+
+        // The last page can be partial, the rest is cleared so its commit is the one of the read data
+        if (read_bytes < trace->page_bytes)
+            memset(page + read_bytes, 0, trace->page_bytes - read_bytes);
+        parse_page(trace, page);
+    }
+
+    free(page);
+    close(fd);
+
+    read_lost_events(trace);
+
+    // Removing the instance disables its events and frees its buffers
+    if (rmdir(trace->instance_path))
+        perror("tracefs instance removal failed");
+}
+
+void sched_trace_destroy(struct sched_trace *trace) {
+    free(trace->events);
+    trace->events = NULL;
+    trace->number_of_events = 0;
+    trace->capacity = 0;
+}
+
+uint64_t sched_trace_ticks_to_ns(const struct sched_trace *trace, uint64_t ticks) {
+    // Linear interpolation between both calibration points, that corrects the drift between both clocks
+    double ns_per_tick = (double) (trace->end_ns - trace->start_ns) / (double) (trace->end_ticks - trace->start_ticks);
+    return trace->start_ns + (uint64_t) llround((double) (int64_t) (ticks - trace->start_ticks) * ns_per_tick);
+}
+
+long sched_trace_find(const struct sched_trace *trace, uint64_t timestamp_ns) {
+    long low = 0, high = trace->number_of_events;
+    while (low < high) {
+        long middle = low + (high - low) / 2;
+        if (trace->events[middle].timestamp_ns < timestamp_ns)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+bool sched_trace_is_interrupt(const struct sched_trace_event *event) {
+    return event->type == SCHED_TRACE_IRQ || event->type == SCHED_TRACE_SOFTIRQ ||
+           event->type == SCHED_TRACE_LOCAL_TIMER;
+}
+
+void sched_trace_print_info(const struct sched_trace *trace) {
+    long counts[NUMBER_OF_SCHED_TRACE_EVENTS] = {0};
+    for (long i = 0; i < trace->number_of_events; ++i)
+        counts[trace->events[i].type]++;
+
+    printf("Scheduler trace: \n\t%s: %d\n\t%s: %ld\n\t%s: %llu\n", "CPU", trace->cpu,
+           "Number of events", trace->number_of_events, "Number of lost events", trace->lost_events);
+    for (int type = 0; type < NUMBER_OF_SCHED_TRACE_EVENTS; ++type) {
+        if (trace->event_ids[type] >= 0)
+            printf("\t%s:%s: %ld\n", event_descriptions[type].system, event_descriptions[type].name, counts[type]);
+    }
+}
@@ -0,0 +1,102 @@
+//
+// Scheduler tracepoints of one CPU read from the raw ftrace ring buffer (tracefs)
+//
+// The tracing runs in its own tracefs instance, so the global trace buffer is not modified, with the "mono" trace
+// clock (CLOCK_MONOTONIC). The per CPU buffer is read in its binary form (per_cpu/cpuN/trace_pipe_raw) after the run,
+// and the user timestamps of the benchmarks are converted to the trace clock with a calibration taken at the start
+// and at the end of the tracing. It needs root (or access to tracefs).
+//
+#ifndef SCHED_TRACE_H
+#define SCHED_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+
+// Name of the tracefs instance and size of the buffer of the traced CPU
+#define SCHED_TRACE_INSTANCE "rt_benchmarks"
+#define SCHED_TRACE_BUFFER_KILOBYTES 65536
+
+enum sched_trace_event_type {
+    SCHED_TRACE_SWITCH,
+    SCHED_TRACE_WAKEUP,
+    SCHED_TRACE_IRQ,
+    SCHED_TRACE_SOFTIRQ,
+    SCHED_TRACE_LOCAL_TIMER,
+    SCHED_TRACE_SYSCALL_ENTER,
+    SCHED_TRACE_SYSCALL_EXIT,
+    NUMBER_OF_SCHED_TRACE_EVENTS
+};
+
+// Maximum number of fields read from each event
+#define SCHED_TRACE_MAX_FIELDS 2
+
+struct sched_trace_event {
+    // Time of the event in the trace clock (nanoseconds of CLOCK_MONOTONIC)
+    uint64_t timestamp_ns;
+
+    enum sched_trace_event_type type;
+
+    // Thread running when the event happened
+    int pid;
+
+    // switch: prev_pid and next_pid, wakeup: pid and target_cpu, irq: irq, softirq: vec, local timer: vector,
+    // syscall enter: id, syscall exit: id and ret
+    long fields[SCHED_TRACE_MAX_FIELDS];
+};
+
+// Location of a field in the raw record of an event
+struct sched_trace_field {
+    int offset;
+    int size;
+};
+
+struct sched_trace {
+    int cpu;
+    char instance_path[PATH_MAX];
+
+    // Id of each event in the trace (-1 if it isn't available in the kernel) and location of its fields
+    int event_ids[NUMBER_OF_SCHED_TRACE_EVENTS];
+    struct sched_trace_field fields[NUMBER_OF_SCHED_TRACE_EVENTS][SCHED_TRACE_MAX_FIELDS];
+    int common_pid_offset;
+
+    // Layout of the pages of the ring buffer
+    int page_bytes;
+    int commit_offset;
+    int commit_size;
+    int data_offset;
+
+    // Events read from the buffer, in time order
+    struct sched_trace_event *events;
+    long number_of_events;
+    long capacity;
+
+    // Events lost because the buffer was full
+    unsigned long long lost_events;
+
+    // Pairs of (timer ticks, trace clock nanoseconds) taken at the start and at the end of the tracing
+    uint64_t start_ticks, start_ns, end_ticks, end_ns;
+};
+
+// Create the instance, trace the given CPU and start the tracing. It exits if tracefs can't be used
+void sched_trace_start(struct sched_trace *trace, int cpu);
+
+// Stop the tracing, read the events of the buffer and remove the instance
+void sched_trace_stop(struct sched_trace *trace);
+
+// Free the events
+void sched_trace_destroy(struct sched_trace *trace);
+
+// Convert a timestamp of the timer (ticks) to the trace clock
+uint64_t sched_trace_ticks_to_ns(const struct sched_trace *trace, uint64_t ticks);
+
+// Index of the first event at or after timestamp_ns (number_of_events if there isn't any)
+long sched_trace_find(const struct sched_trace *trace, uint64_t timestamp_ns);
+
+// Check if the event is an interrupt (hard irq, softirq or local timer)
+bool sched_trace_is_interrupt(const struct sched_trace_event *event);
+
+// Print the traced CPU, the number of events of each type and the lost events
+void sched_trace_print_info(const struct sched_trace *trace);
+
+#endif // SCHED_TRACE_H
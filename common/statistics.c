@@ -0,0 +1,165 @@
+//
+// Shared statistics used by all the benchmarks
+//
+#include "statistics.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+// Percentiles printed by histogram_print
+static const double printed_percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+
+static int bucket_index(uint64_t value) {
+    /***
+     * Get the bucket where value is stored
+     * The values lower than HISTOGRAM_SUB_BUCKET_COUNT have their own bucket. Each next power of two range is
+     * divided in HISTOGRAM_SUB_BUCKET_HALF_COUNT buckets
+     */
+
+    if (value < HISTOGRAM_SUB_BUCKET_COUNT)
+        return (int) value;
+
+    // Position of the most significant bit
+    int magnitude = 63 - __builtin_clzll(value);
+    int shift = magnitude - (HISTOGRAM_SUB_BUCKET_BITS - 1);
+    int sub_bucket = (int) (value >> shift) - HISTOGRAM_SUB_BUCKET_HALF_COUNT;
+
+    return HISTOGRAM_SUB_BUCKET_COUNT + (shift - 1) * HISTOGRAM_SUB_BUCKET_HALF_COUNT + sub_bucket;
+}
+
+static uint64_t bucket_middle_value(int index) {
+    /***
+     * Get the value in the middle of the range represented by the bucket index
+     */
+
+    if (index < HISTOGRAM_SUB_BUCKET_COUNT)
+        return (uint64_t) index;
+
+    int shift = (index - HISTOGRAM_SUB_BUCKET_COUNT) / HISTOGRAM_SUB_BUCKET_HALF_COUNT + 1;
+    int sub_bucket = (index - HISTOGRAM_SUB_BUCKET_COUNT) % HISTOGRAM_SUB_BUCKET_HALF_COUNT;
+    uint64_t lowest_value = (uint64_t) (sub_bucket + HISTOGRAM_SUB_BUCKET_HALF_COUNT) << shift;
+
+    return lowest_value + (((uint64_t) 1 << shift) >> 1);
+}
+
+void histogram_init(struct histogram *histogram) {
+    memset(histogram, 0, sizeof(struct histogram));
+}
+
+void histogram_record(struct histogram *histogram, long long value) {
+    // Negative values (e.g. costs calculated as a difference) are counted apart
+    if (value < 0) {
+        histogram->negative_counts[bucket_index(-(uint64_t) value)]++;
+        histogram->negative_count++;
+    } else {
+        histogram->counts[bucket_index((uint64_t) value)]++;
+    }
+
+    if (histogram->total_count == 0 || value < histogram->min)
+        histogram->min = value;
+    if (histogram->total_count == 0 || value > histogram->max)
+        histogram->max = value;
+
+    histogram->total_count++;
+
+    double delta = (double) value - histogram->mean;
+    histogram->mean += delta / (double) histogram->total_count;
+    histogram->m2 += delta * ((double) value - histogram->mean);
+}
+
+void histogram_merge(struct histogram *destination, const struct histogram *source) {
+    if (source->total_count == 0)
+        return;
+
+    if (destination->total_count == 0) {
+        *destination = *source;
+        return;
+    }
+
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+        destination->counts[i] += source->counts[i];
+        destination->negative_counts[i] += source->negative_counts[i];
+    }
+
+    if (source->min < destination->min)
+        destination->min = source->min;
+    if (source->max > destination->max)
+        destination->max = source->max;
+
+    // Combine the running mean and variance of both histograms (Chan et al. parallel algorithm)
+    double destination_count = (double) destination->total_count, source_count = (double) source->total_count;
+    double total_count = destination_count + source_count;
+    double delta = source->mean - destination->mean;
+
+    destination->mean += delta * source_count / total_count;
+    destination->m2 += source->m2 + delta * delta * destination_count * source_count / total_count;
+
+    destination->total_count += source->total_count;
+    destination->negative_count += source->negative_count;
+}
+
+long long histogram_percentile(const struct histogram *histogram, double percentile) {
+    if (histogram->total_count == 0)
+        return 0;
+
+    // Number of samples that must be lower or equal than the returned value
+    uint64_t samples_below = (uint64_t) ceil(percentile / 100.0 * (double) histogram->total_count);
+    if (samples_below == 0)
+        samples_below = 1;
+
+    // Negative values, from the lowest one
+    uint64_t accumulated_count = 0;
+    long long value = histogram->max;
+    bool found = false;
+
+    for (int i = HISTOGRAM_BUCKET_COUNT - 1; i >= 0 && histogram->negative_count; --i) {
+        accumulated_count += histogram->negative_counts[i];
+        if (accumulated_count >= samples_below) {
+            value = -(long long) bucket_middle_value(i);
+            found = true;
+            break;
+        }
+    }
+
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT && !found; ++i) {
+        accumulated_count += histogram->counts[i];
+        if (accumulated_count >= samples_below) {
+            value = (long long) bucket_middle_value(i);
+            found = true;
+        }
+    }
+
+    // The exact extremes are known, so the value never goes out of them
+    if (value < histogram->min)
+        return histogram->min;
+    if (value > histogram->max)
+        return histogram->max;
+
+    return value;
+}
+
+double histogram_stddev(const struct histogram *histogram) {
+    if (histogram->total_count < 2)
+        return 0.0;
+
+    return sqrt(histogram->m2 / (double) (histogram->total_count - 1));
+}
+
+void histogram_print(const struct histogram *histogram, const char *cost_name) {
+    printf("Experiment result: \n\t%s: %llu\n\t%s %s: %lld ns\n\t%s %s: %lld ns\n\t%s %s: %.0f ns\n",
+           "Number of experiments", (unsigned long long) histogram->total_count,
+           "Minimum cost of", cost_name, histogram->min,
+           "Maximum cost of", cost_name, histogram->max,
+           "Average cost of", cost_name, histogram->mean);
+
+    printf("\t%s %s: %.0f ns\n", "Standard deviation of the cost of", cost_name, histogram_stddev(histogram));
+
+    for (unsigned int i = 0; i < sizeof(printed_percentiles) / sizeof(printed_percentiles[0]); ++i) {
+        printf("\t%g%s %s: %lld ns\n", printed_percentiles[i], "th percentile of the cost of", cost_name,
+               histogram_percentile(histogram, printed_percentiles[i]));
+    }
+
+    if (histogram->negative_count)
+        printf("\t%s: %llu\n", "Number of negative costs", (unsigned long long) histogram->negative_count);
+}
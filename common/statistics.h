@@ -0,0 +1,63 @@
+//
+// Shared statistics used by all the benchmarks
+//
+// The samples are recorded in a log-bucketed histogram (in the style of HdrHistogram) that uses a constant amount of
+// memory and never allocates while recording, so the number of experiments is not limited by the size of any array.
+//
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Every power of two range is divided in 2^(HISTOGRAM_SUB_BUCKET_BITS - 1) buckets, so the relative error of the
+// reported percentiles is lower than 1 / 2^(HISTOGRAM_SUB_BUCKET_BITS - 1) (< 1.6% with 7 bits)
+#define HISTOGRAM_SUB_BUCKET_BITS 7
+#define HISTOGRAM_SUB_BUCKET_COUNT (1 << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_SUB_BUCKET_HALF_COUNT (HISTOGRAM_SUB_BUCKET_COUNT / 2)
+
+// Number of buckets needed to represent any non negative 64 bits value
+#define HISTOGRAM_BUCKET_COUNT (HISTOGRAM_SUB_BUCKET_COUNT + \
+    (63 - (HISTOGRAM_SUB_BUCKET_BITS - 1)) * HISTOGRAM_SUB_BUCKET_HALF_COUNT)
+
+struct histogram {
+    // Number of samples in each bucket
+    uint64_t counts[HISTOGRAM_BUCKET_COUNT];
+
+    // Number of negative samples in each bucket (indexed by their absolute value)
+    uint64_t negative_counts[HISTOGRAM_BUCKET_COUNT];
+
+    // Number of recorded samples
+    uint64_t total_count;
+
+    // Number of negative samples
+    uint64_t negative_count;
+
+    // Exact extreme values
+    long long min;
+    long long max;
+
+    // Running mean and sum of squared differences from the mean (Welford's algorithm), they can't overflow
+    double mean;
+    double m2;
+};
+
+// Initialize an empty histogram
+void histogram_init(struct histogram *histogram);
+
+// Record one sample
+void histogram_record(struct histogram *histogram, long long value);
+
+// Add all the samples of source to destination
+void histogram_merge(struct histogram *destination, const struct histogram *source);
+
+// Value below which the given percentage (0-100) of the samples fall
+long long histogram_percentile(const struct histogram *histogram, double percentile);
+
+// Standard deviation of the recorded samples
+double histogram_stddev(const struct histogram *histogram);
+
+// Print the experiment result in the format used by all the benchmarks
+void histogram_print(const struct histogram *histogram, const char *cost_name);
+
+#endif // STATISTICS_H
@@ -0,0 +1,135 @@
+//
+// Shared timing layer used by all the benchmarks
+//
+#include "timer.h"
+#include "statistics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+// Time spent in the calibration of the counter frequency
+#define TIMER_CALIBRATION_NANOSECONDS 100000000LL
+
+// Number of back-to-back reads used to measure the timer overhead
+#define TIMER_OVERHEAD_EXPERIMENTS 100000
+
+enum timer_backend_type timer_backend = TIMER_BACKEND_CLOCK_GETTIME;
+double timer_ns_per_tick = 1.0;
+long long timer_overhead_ticks = 0;
+
+// Distribution of the cost of two back-to-back reads, in ticks
+static struct histogram timer_overhead_histogram;
+
+// The timer is calibrated once per process, so the library measures (measurement/rt_measure.c) called by a benchmark
+// use its calibration
+static bool timer_initialized = false;
+
+static bool counter_available(void) {
+    /***
+     * Check if the cycle counter of the platform can be used as timer
+     */
+
+#if defined(__aarch64__)
+    return true;
+#elif defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+
+    // RDTSCP support
+    if (!__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) || !(edx & (1U << 27)))
+        return false;
+
+    // Invariant TSC (constant rate in all the P, C and T states)
+    if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1U << 8)))
+        return false;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+static long long monotonic_raw_nanoseconds(void) {
+    struct timespec time_measure;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &time_measure);
+    return time_measure.tv_sec * 1000000000LL + time_measure.tv_nsec;
+}
+
+static double calibrate_ns_per_tick(void) {
+    /***
+     * Get the nanoseconds per tick of the counter
+     */
+
+#if defined(__aarch64__)
+    // The frequency of the generic timer is given by the architecture
+    uint64_t frequency;
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r" (frequency));
+    if (frequency)
+        return 1e9 / (double) frequency;
+#endif
+
+    // Count the ticks elapsed while spinning during TIMER_CALIBRATION_NANOSECONDS
+    long long start_nanoseconds = monotonic_raw_nanoseconds();
+    uint64_t start_ticks = timer_read();
+
+    long long end_nanoseconds;
+    do {
+        end_nanoseconds = monotonic_raw_nanoseconds();
+    } while (end_nanoseconds - start_nanoseconds < TIMER_CALIBRATION_NANOSECONDS);
+    uint64_t end_ticks = timer_read();
+
+    return (double) (end_nanoseconds - start_nanoseconds) / (double) (end_ticks - start_ticks);
+}
+
+void timer_init(void) {
+    if (timer_initialized)
+        return;
+    timer_initialized = true;
+
+    const char *requested_backend = getenv("TIMER_BACKEND");
+
+    if (requested_backend != NULL && strcmp(requested_backend, "clock_gettime") == 0) {
+        timer_backend = TIMER_BACKEND_CLOCK_GETTIME;
+    } else if (counter_available()) {
+        timer_backend = TIMER_BACKEND_COUNTER;
+    } else {
+        if (requested_backend != NULL && strcmp(requested_backend, "counter") == 0)
+            fprintf(stderr, "cycle counter not available, using clock_gettime\n");
+        timer_backend = TIMER_BACKEND_CLOCK_GETTIME;
+    }
+
+    timer_ns_per_tick = timer_backend == TIMER_BACKEND_COUNTER ? calibrate_ns_per_tick() : 1.0;
+
+    // Measure the cost of two back-to-back reads
+    histogram_init(&timer_overhead_histogram);
+    for (int i = 0; i < TIMER_OVERHEAD_EXPERIMENTS; ++i) {
+        uint64_t start = timer_read();
+        uint64_t end = timer_read();
+        histogram_record(&timer_overhead_histogram, (long long) (end - start));
+    }
+
+    timer_overhead_ticks = histogram_percentile(&timer_overhead_histogram, 50.0);
+}
+
+long long timer_ticks_to_ns(long long ticks) {
+    return (long long) ((double) ticks * timer_ns_per_tick);
+}
+
+long long timer_interval_ns(uint64_t start, uint64_t end) {
+    return timer_ticks_to_ns((long long) (end - start) - timer_overhead_ticks);
+}
+
+void timer_print_info(void) {
+    printf("Timer: \n\t%s: %s\n\t%s: %.3f ns\n\t%s: %lld ns\n\t%s: %lld ns\n\t%s: %lld ns\n\t%s: %lld ns\n",
+           "Backend", timer_backend == TIMER_BACKEND_COUNTER ? "cycle counter" : "clock_gettime",
+           "Resolution", timer_ns_per_tick,
+           "Minimum overhead", timer_ticks_to_ns(timer_overhead_histogram.min),
+           "Median overhead (subtracted from the costs)", timer_ticks_to_ns(timer_overhead_ticks),
+           "99th percentile of the overhead", timer_ticks_to_ns(histogram_percentile(&timer_overhead_histogram, 99.0)),
+           "Maximum overhead", timer_ticks_to_ns(timer_overhead_histogram.max));
+}
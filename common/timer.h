@@ -0,0 +1,73 @@
+//
+// Shared timing layer used by all the benchmarks
+//
+// The timestamps are read from the cycle counter of the platform when possible:
+//  - aarch64: virtual counter (CNTVCT_EL0)
+//  - x86_64: time stamp counter (RDTSCP + LFENCE), only if it is invariant
+// and from clock_gettime(CLOCK_MONOTONIC) in other case. The backend can be forced setting the TIMER_BACKEND
+// environment variable to "counter" or "clock_gettime".
+//
+// timer_init() calibrates the counter frequency and measures the cost of reading the timer, that is subtracted from
+// every interval returned by timer_interval_ns().
+//
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <time.h>
+
+enum timer_backend_type {
+    TIMER_BACKEND_CLOCK_GETTIME,
+    TIMER_BACKEND_COUNTER
+};
+
+// Backend selected by timer_init
+extern enum timer_backend_type timer_backend;
+
+// Nanoseconds per tick of the selected backend
+extern double timer_ns_per_tick;
+
+// Median cost, in ticks, of two back-to-back timer reads
+extern long long timer_overhead_ticks;
+
+static inline uint64_t timer_read(void) {
+    /***
+     * Get the current timestamp in ticks of the selected backend
+     */
+
+#if defined(__aarch64__)
+    if (timer_backend == TIMER_BACKEND_COUNTER) {
+        uint64_t ticks;
+        // The isb avoids that the counter is read out of order
+        __asm__ __volatile__("isb\n\tmrs %0, cntvct_el0" : "=r" (ticks) : : "memory");
+        return ticks;
+    }
+#elif defined(__x86_64__)
+    if (timer_backend == TIMER_BACKEND_COUNTER) {
+        uint32_t low, high;
+        // rdtscp waits until all previous instructions have executed and lfence avoids that next ones start before
+        // reading the counter
+        __asm__ __volatile__("rdtscp\n\tlfence" : "=a" (low), "=d" (high) : : "rcx", "memory");
+        return ((uint64_t) high << 32) | low;
+    }
+#endif
+
+    struct timespec time_measure;
+    clock_gettime(CLOCK_MONOTONIC, &time_measure);
+    return (uint64_t) time_measure.tv_sec * 1000000000ULL + (uint64_t) time_measure.tv_nsec;
+}
+
+// Select the backend, calibrate it and measure its overhead. It must be called before any other timer function, the
+// calls after the first one do nothing
+void timer_init(void);
+
+// Convert a number of ticks to nanoseconds
+long long timer_ticks_to_ns(long long ticks);
+
+// Nanoseconds elapsed between two timestamps without the timer overhead (negative if end is before start)
+long long timer_interval_ns(uint64_t start, uint64_t end);
+
+// Print the selected backend, its resolution and the distribution of its overhead
+void timer_print_info(void);
+
+#endif // TIMER_H
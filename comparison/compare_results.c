@@ -0,0 +1,447 @@
+//
+// Comparison of the raw costs of two runs (result files written with the -r option of the benchmarks), to detect the
+// regressions of a kernel or firmware update
+//
+// For each series of both runs:
+//  - Mann-Whitney U test (normal approximation with tie correction): does one run tend to have bigger costs?
+//  - Kolmogorov-Smirnov two sample test: are the distributions different (shape, tails)?
+//  - Bootstrap confidence intervals of the difference of the 50th and 99th percentiles (candidate - baseline)
+// A change is significant if any of both tests rejects the equality at the given level, the confidence interval of a
+// percentile difference excludes 0 and that percentile changes more than the threshold
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+
+#include "../common/result_file.h"
+
+#define DEFAULT_SIGNIFICANCE_LEVEL 0.01
+#define DEFAULT_BOOTSTRAP_ITERATIONS 1000
+#define DEFAULT_CONFIDENCE_LEVEL 95.0
+#define DEFAULT_THRESHOLD_PERCENT 5.0
+#define DEFAULT_SEED 1
+
+// Percentiles whose differences are estimated
+#define NUMBER_OF_COMPARED_PERCENTILES 2
+static const double compared_percentiles[NUMBER_OF_COMPARED_PERCENTILES] = {50.0, 99.0};
+
+enum verdict {
+    VERDICT_UNCHANGED,
+    VERDICT_IMPROVEMENT,
+    VERDICT_REGRESSION
+};
+
+static const char *verdict_names[] = {"unchanged", "improvement", "regression"};
+
+struct comparison {
+    double mann_whitney_p;
+
+    // Probability that a cost of the candidate is bigger than one of the baseline (0.5 if they are equivalent)
+    double probability_candidate_bigger;
+
+    double kolmogorov_smirnov_d;
+    double kolmogorov_smirnov_p;
+
+    int64_t baseline_percentiles[NUMBER_OF_COMPARED_PERCENTILES];
+    int64_t candidate_percentiles[NUMBER_OF_COMPARED_PERCENTILES];
+    double difference_low[NUMBER_OF_COMPARED_PERCENTILES];
+    double difference_high[NUMBER_OF_COMPARED_PERCENTILES];
+
+    enum verdict verdict;
+};
+
+// Options of the comparison
+static double significance_level = DEFAULT_SIGNIFICANCE_LEVEL;
+static long bootstrap_iterations = DEFAULT_BOOTSTRAP_ITERATIONS;
+static double confidence_level = DEFAULT_CONFIDENCE_LEVEL;
+static double threshold_percent = DEFAULT_THRESHOLD_PERCENT;
+
+// State of the xorshift64* generator used by the bootstrap
+static uint64_t random_state = DEFAULT_SEED;
+
+static uint64_t random_next(void) {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 0x2545F4914F6CDD1DULL;
+}
+
+static int compare_int64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *) a, y = *(const int64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+uint64_t percentile_rank(uint64_t number_of_samples, double percentile) {
+    /***
+     * Index of the nearest rank percentile in a sorted array
+     */
+
+    uint64_t rank = (uint64_t) ceil(percentile / 100.0 * (double) number_of_samples);
+    return rank ? rank - 1 : 0;
+}
+
+int64_t select_nth(int64_t *values, uint64_t number_of_values, uint64_t n) {
+    /***
+     * Value that would be at index n if the values were sorted (quickselect, the values are reordered)
+     */
+
+    uint64_t left = 0, right = number_of_values - 1;
+    while (left < right) {
+        int64_t pivot = values[left + (right - left) / 2];
+        uint64_t i = left, j = right;
+        while (i <= j) {
+            while (values[i] < pivot)
+                i++;
+            while (values[j] > pivot)
+                j--;
+            if (i <= j) {
+                int64_t swap = values[i];
+                values[i] = values[j];
+                values[j] = swap;
+                i++;
+                if (j == 0)
+                    break;
+                j--;
+            }
+        }
+
+        if (n <= j)
+            right = j;
+        else if (n >= i)
+            left = i;
+        else
+            break;
+    }
+
+    return values[n];
+}
+
+double mann_whitney(const int64_t *baseline, uint64_t n1, const int64_t *candidate, uint64_t n2,
+                    double *probability_candidate_bigger) {
+    /***
+     * Two sided p-value of the Mann-Whitney U test of two sorted samples
+     */
+
+    double baseline_rank_sum = 0.0, tie_correction = 0.0;
+    uint64_t i = 0, j = 0;
+
+    while (i < n1 || j < n2) {
+        int64_t value = j == n2 || (i < n1 && baseline[i] <= candidate[j]) ? baseline[i] : candidate[j];
+
+        // Samples of both runs equal to value share the mean of their ranks
+        uint64_t baseline_ties = 0, candidate_ties = 0;
+        while (i < n1 && baseline[i] == value) {
+            i++;
+            baseline_ties++;
+        }
+        while (j < n2 && candidate[j] == value) {
+            j++;
+            candidate_ties++;
+        }
+
+        double ties = (double) (baseline_ties + candidate_ties);
+        double first_rank = (double) (i + j) - ties + 1.0;
+        baseline_rank_sum += (double) baseline_ties * (first_rank + (ties - 1.0) / 2.0);
+        tie_correction += ties * ties * ties - ties;
+    }
+
+    double n = (double) (n1 + n2);
+    double u_baseline = baseline_rank_sum - (double) n1 * ((double) n1 + 1.0) / 2.0;
+    double mean = (double) n1 * (double) n2 / 2.0;
+    double variance = (double) n1 * (double) n2 / 12.0 * ((n + 1.0) - tie_correction / (n * (n - 1.0)));
+
+    *probability_candidate_bigger = 1.0 - u_baseline / ((double) n1 * (double) n2);
+    if (variance <= 0.0)
+        return 1.0;
+
+    // Continuity correction
+    double z = (fabs(u_baseline - mean) - 0.5) / sqrt(variance);
+    return z > 0.0 ? erfc(z / sqrt(2.0)) : 1.0;
+}
+
+double kolmogorov_smirnov(const int64_t *baseline, uint64_t n1, const int64_t *candidate, uint64_t n2,
+                          double *statistic) {
+    /***
+     * Asymptotic p-value of the two sample Kolmogorov-Smirnov test of two sorted samples, and its statistic D
+     */
+
+    double d = 0.0;
+    uint64_t i = 0, j = 0;
+
+    while (i < n1 && j < n2) {
+        int64_t value = baseline[i] <= candidate[j] ? baseline[i] : candidate[j];
+        while (i < n1 && baseline[i] == value)
+            i++;
+        while (j < n2 && candidate[j] == value)
+            j++;
+
+        double distance = fabs((double) i / (double) n1 - (double) j / (double) n2);
+        if (distance > d)
+            d = distance;
+    }
+    *statistic = d;
+
+    double effective_n = sqrt((double) n1 * (double) n2 / (double) (n1 + n2));
+    double lambda = (effective_n + 0.12 + 0.11 / effective_n) * d;
+    if (lambda < 0.3)
+        return 1.0;
+
+    // Kolmogorov distribution
+    double p = 0.0, sign = 1.0;
+    for (int k = 1; k <= 100; ++k) {
+        double term = sign * exp(-2.0 * k * k * lambda * lambda);
+        p += term;
+        if (fabs(term) < 1e-12)
+            break;
+        sign = -sign;
+    }
+    p *= 2.0;
+
+    return p < 0.0 ? 0.0 : (p > 1.0 ? 1.0 : p);
+}
+
+void bootstrap_percentile_differences(const int64_t *baseline, uint64_t n1, const int64_t *candidate, uint64_t n2,
+                                      struct comparison *comparison) {
+    /***
+     * Confidence intervals of the difference of each compared percentile (candidate - baseline), resampling both
+     * runs with replacement
+     */
+
+    int64_t *resample_1 = malloc(n1 * sizeof(int64_t));
+    int64_t *resample_2 = malloc(n2 * sizeof(int64_t));
+    double *differences = malloc(NUMBER_OF_COMPARED_PERCENTILES * bootstrap_iterations * sizeof(double));
+    if (resample_1 == NULL || resample_2 == NULL || differences == NULL) {
+        perror("malloc failed");
+        exit(-1);
+    }
+
+    for (long b = 0; b < bootstrap_iterations; ++b) {
+        for (uint64_t i = 0; i < n1; ++i)
+            resample_1[i] = baseline[random_next() % n1];
+        for (uint64_t i = 0; i < n2; ++i)
+            resample_2[i] = candidate[random_next() % n2];
+
+        for (int p = 0; p < NUMBER_OF_COMPARED_PERCENTILES; ++p) {
+            int64_t baseline_value = select_nth(resample_1, n1, percentile_rank(n1, compared_percentiles[p]));
+            int64_t candidate_value = select_nth(resample_2, n2, percentile_rank(n2, compared_percentiles[p]));
+            differences[p * bootstrap_iterations + b] = (double) (candidate_value - baseline_value);
+        }
+    }
+
+    double tail = (100.0 - confidence_level) / 2.0;
+    for (int p = 0; p < NUMBER_OF_COMPARED_PERCENTILES; ++p) {
+        double *percentile_differences = &differences[p * bootstrap_iterations];
+        qsort(percentile_differences, bootstrap_iterations, sizeof(double), compare_double);
+        comparison->difference_low[p] = percentile_differences[percentile_rank(bootstrap_iterations, tail)];
+        comparison->difference_high[p] =
+                percentile_differences[percentile_rank(bootstrap_iterations, 100.0 - tail)];
+    }
+
+    free(resample_1);
+    free(resample_2);
+    free(differences);
+}
+
+void compare_series(const struct result_series *baseline_series, const struct result_series *candidate_series,
+                    struct comparison *comparison) {
+    uint64_t n1 = baseline_series->number_of_samples, n2 = candidate_series->number_of_samples;
+
+    // Sorted copies of both runs
+    int64_t *baseline = malloc(n1 * sizeof(int64_t));
+    int64_t *candidate = malloc(n2 * sizeof(int64_t));
+    if (baseline == NULL || candidate == NULL) {
+        perror("malloc failed");
+        exit(-1);
+    }
+    memcpy(baseline, baseline_series->samples, n1 * sizeof(int64_t));
+    memcpy(candidate, candidate_series->samples, n2 * sizeof(int64_t));
+    qsort(baseline, n1, sizeof(int64_t), compare_int64);
+    qsort(candidate, n2, sizeof(int64_t), compare_int64);
+
+    comparison->mann_whitney_p = mann_whitney(baseline, n1, candidate, n2,
+                                              &(comparison->probability_candidate_bigger));
+    comparison->kolmogorov_smirnov_p = kolmogorov_smirnov(baseline, n1, candidate, n2,
+                                                          &(comparison->kolmogorov_smirnov_d));
+    bootstrap_percentile_differences(baseline, n1, candidate, n2, comparison);
+
+    bool distributions_differ = comparison->mann_whitney_p < significance_level ||
+                                comparison->kolmogorov_smirnov_p < significance_level;
+    bool increase = false, decrease = false;
+
+    for (int p = 0; p < NUMBER_OF_COMPARED_PERCENTILES; ++p) {
+        comparison->baseline_percentiles[p] = baseline[percentile_rank(n1, compared_percentiles[p])];
+        comparison->candidate_percentiles[p] = candidate[percentile_rank(n2, compared_percentiles[p])];
+
+        double change = (double) (comparison->candidate_percentiles[p] - comparison->baseline_percentiles[p]);
+        bool above_threshold = fabs(change) * 100.0 >= threshold_percent *
+                                                       fabs((double) comparison->baseline_percentiles[p]);
+        if (distributions_differ && above_threshold && comparison->difference_low[p] > 0.0)
+            increase = true;
+        if (distributions_differ && above_threshold && comparison->difference_high[p] < 0.0)
+            decrease = true;
+    }
+
+    // Any significant increase of a percentile is a regression, even if another one improves
+    comparison->verdict = increase ? VERDICT_REGRESSION : (decrease ? VERDICT_IMPROVEMENT : VERDICT_UNCHANGED);
+
+    free(baseline);
+    free(candidate);
+}
+
+void print_run(const char *role, const char *path, const struct result_run *run) {
+    char date[32] = "";
+    time_t creation_time = (time_t) run->header.creation_time;
+    struct tm creation_tm;
+    if (gmtime_r(&creation_time, &creation_tm) != NULL)
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S UTC", &creation_tm);
+
+    printf("%s: %s\n\t%s: %s\n\t%s: %s\n\t%s: %s\n\t%s: %s\n", role, path, "Benchmark", run->header.benchmark,
+           "Host", run->header.hostname, "Kernel", run->header.kernel_release, "Date", date);
+    for (uint32_t i = 0; i < run->header.config.number_of_config; ++i)
+        printf("\t%s: %s\n", run->header.config.keys[i], run->header.config.values[i]);
+}
+
+void check_same_configuration(const struct result_run *baseline_run, const struct result_run *candidate_run) {
+    /***
+     * Exit if the runs come from different benchmarks or configurations (mode, experiments, antagonists...), their
+     * differences wouldn't be caused by the kernel or the firmware. The differing parameters are printed
+     */
+
+    if (strcmp(baseline_run->header.benchmark, candidate_run->header.benchmark) != 0) {
+        fprintf(stderr, "the runs come from different benchmarks (%s and %s)\n", baseline_run->header.benchmark,
+                candidate_run->header.benchmark);
+        exit(-1);
+    }
+
+    if (result_config_equal(&(baseline_run->header.config), &(candidate_run->header.config)))
+        return;
+
+    fprintf(stderr, "the runs have different configurations:\n");
+    const struct result_config *configs[2] = {&(baseline_run->header.config), &(candidate_run->header.config)};
+    for (int c = 0; c < 2; ++c) {
+        for (uint32_t i = 0; i < configs[c]->number_of_config; ++i) {
+            const char *other_value = NULL;
+            for (uint32_t j = 0; j < configs[1 - c]->number_of_config; ++j) {
+                if (strcmp(configs[c]->keys[i], configs[1 - c]->keys[j]) == 0)
+                    other_value = configs[1 - c]->values[j];
+            }
+
+            // Keys of both runs are printed once, from the baseline
+            if (other_value != NULL && (c == 1 || strcmp(configs[c]->values[i], other_value) == 0))
+                continue;
+
+            fprintf(stderr, "\t%s: %s in the baseline, %s in the candidate\n", configs[c]->keys[i],
+                    c == 0 ? configs[c]->values[i] : "missing",
+                    c == 0 ? (other_value != NULL ? other_value : "missing") : configs[c]->values[i]);
+        }
+    }
+    exit(-1);
+}
+
+void print_usage(const char *program_name) {
+    printf("Usage: %s [-a level] [-b iterations] [-c confidence] [-t percent] [-s seed] baseline candidate\n"
+           "\t-a: significance level of the Mann-Whitney and Kolmogorov-Smirnov tests (%g by default)\n"
+           "\t-b: bootstrap iterations of the confidence intervals of the percentiles (%d by default)\n"
+           "\t-c: confidence level of the intervals, in percent (%g by default)\n"
+           "\t-t: minimum change of a percentile to be flagged, in percent (%g by default)\n"
+           "\t-s: seed of the bootstrap resampling (%d by default)\n"
+           "The baseline and the candidate are result files written with the -r option of the benchmarks, by the same\n"
+           "benchmark with the same configuration (they aren't compared in other case). The exit status is 1 if any\n"
+           "series has a significant regression and 0 in other case\n",
+           program_name, DEFAULT_SIGNIFICANCE_LEVEL, DEFAULT_BOOTSTRAP_ITERATIONS, DEFAULT_CONFIDENCE_LEVEL,
+           DEFAULT_THRESHOLD_PERCENT, DEFAULT_SEED);
+}
+
+int main(int argc, char *argv[]) {
+    int option;
+    while ((option = getopt(argc, argv, "a:b:c:t:s:h")) != -1) {
+        switch (option) {
+            case 'a':
+                significance_level = strtod(optarg, NULL);
+                break;
+            case 'b':
+                bootstrap_iterations = strtol(optarg, NULL, 0);
+                break;
+            case 'c':
+                confidence_level = strtod(optarg, NULL);
+                break;
+            case 't':
+                threshold_percent = strtod(optarg, NULL);
+                break;
+            case 's':
+                random_state = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(option == 'h' ? 0 : -1);
+        }
+    }
+
+    if (argc - optind != 2 || bootstrap_iterations <= 0 || confidence_level <= 0.0 || confidence_level >= 100.0 ||
+        random_state == 0) {
+        print_usage(argv[0]);
+        exit(-1);
+    }
+
+    static struct result_run baseline_run, candidate_run;
+    result_file_read(argv[optind], &baseline_run);
+    result_file_read(argv[optind + 1], &candidate_run);
+
+    print_run("Baseline", argv[optind], &baseline_run);
+    print_run("Candidate", argv[optind + 1], &candidate_run);
+    check_same_configuration(&baseline_run, &candidate_run);
+    printf("Comparison: \n\t%s: %g\n\t%s: %g%% (%ld bootstrap iterations)\n\t%s: %g%%\n",
+           "Significance level", significance_level, "Confidence of the intervals", confidence_level,
+           bootstrap_iterations, "Threshold of the percentile changes", threshold_percent);
+
+    printf("series,baseline_samples,candidate_samples,baseline_p50_ns,candidate_p50_ns,p50_difference_low_ns,"
+           "p50_difference_high_ns,baseline_p99_ns,candidate_p99_ns,p99_difference_low_ns,p99_difference_high_ns,"
+           "probability_candidate_bigger,mann_whitney_p,kolmogorov_smirnov_d,kolmogorov_smirnov_p,verdict\n");
+
+    int regressions = 0;
+    for (uint32_t s = 0; s < baseline_run.header.number_of_series; ++s) {
+        const struct result_series *baseline_series = &(baseline_run.series[s]);
+        const struct result_series *candidate_series = result_run_find(&candidate_run, baseline_series->name);
+
+        if (candidate_series == NULL || baseline_series->number_of_samples == 0 ||
+            candidate_series->number_of_samples == 0) {
+            fprintf(stderr, "series %s skipped, it is missing or empty in one of the runs\n", baseline_series->name);
+            continue;
+        }
+
+        struct comparison comparison;
+        compare_series(baseline_series, candidate_series, &comparison);
+        regressions += comparison.verdict == VERDICT_REGRESSION;
+
+        printf("%s,%llu,%llu", baseline_series->name, (unsigned long long) baseline_series->number_of_samples,
+               (unsigned long long) candidate_series->number_of_samples);
+        for (int p = 0; p < NUMBER_OF_COMPARED_PERCENTILES; ++p)
+            printf(",%lld,%lld,%.0f,%.0f", (long long) comparison.baseline_percentiles[p],
+                   (long long) comparison.candidate_percentiles[p], comparison.difference_low[p],
+                   comparison.difference_high[p]);
+        printf(",%.3f,%.3g,%.4f,%.3g,%s\n", comparison.probability_candidate_bigger, comparison.mann_whitney_p,
+               comparison.kolmogorov_smirnov_d, comparison.kolmogorov_smirnov_p, verdict_names[comparison.verdict]);
+    }
+
+    for (uint32_t s = 0; s < candidate_run.header.number_of_series; ++s) {
+        if (result_run_find(&baseline_run, candidate_run.series[s].name) == NULL)
+            fprintf(stderr, "series %s skipped, it is missing in the baseline\n", candidate_run.series[s].name);
+    }
+
+    printf("Comparison result: \n\t%s: %d\n", "Number of series with a significant regression", regressions);
+
+    result_run_destroy(&baseline_run);
+    result_run_destroy(&candidate_run);
+
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,15 @@
+#!/bin/bash
+
+# Architecture variables
+ARCHITECTURE=${ARCHITECTURE:-aarch64}
+
+if [ "${ARCHITECTURE}" == "aarch64" ]; then
+  CC=${CC:-aarch64-none-linux-gnu-gcc}
+else
+  CC=${CC:-gcc}
+fi
+
+mkdir -p ../builds/${ARCHITECTURE}
+
+# Statistical comparison of the raw costs of two runs
+${CC} -Wall -O2 -static -o ../builds/${ARCHITECTURE}/compare_results compare_results.c ../common/result_file.c -lm
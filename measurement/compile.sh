@@ -0,0 +1,23 @@
+#!/bin/bash
+
+# Architecture variables
+ARCHITECTURE=${ARCHITECTURE:-aarch64}
+
+if [ "${ARCHITECTURE}" == "aarch64" ]; then
+  CC=${CC:-aarch64-none-linux-gnu-gcc}
+  AR=${AR:-aarch64-none-linux-gnu-ar}
+else
+  CC=${CC:-gcc}
+  AR=${AR:-ar}
+fi
+
+mkdir -p ../builds/${ARCHITECTURE}/objects
+
+# In-process measurement library (link it with -pthread -lm, C++ programs include rt_measure.hpp)
+for SOURCE in rt_measure.c ../common/statistics.c ../common/timer.c; do
+  ${CC} -Wall -O2 -c ${SOURCE} -o ../builds/${ARCHITECTURE}/objects/$(basename ${SOURCE} .c).o
+done
+${AR} rcs ../builds/${ARCHITECTURE}/librt_measure.a ../builds/${ARCHITECTURE}/objects/rt_measure.o ../builds/${ARCHITECTURE}/objects/statistics.o ../builds/${ARCHITECTURE}/objects/timer.o
+
+# Calibration front end over the library
+${CC} -Wall -static -pthread -o ../builds/${ARCHITECTURE}/rt_calibrate rt_calibrate.c ../common/overhead_profile.c ../builds/${ARCHITECTURE}/librt_measure.a -lm
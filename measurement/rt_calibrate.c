@@ -0,0 +1,133 @@
+//
+// Front end of the in-process measurement library: measure the preemption cost of some cores and the migration cost
+// between pairs of them, as a real-time runtime would do at startup
+//
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "rt_measure.h"
+#include "../common/timer.h"
+#include "../common/overhead_profile.h"
+
+#define NUMBER_OF_SAMPLES 1000
+#define MAX_CORES 64
+
+int parse_cores(const char *argument, int *cores) {
+    /***
+     * Get the cores of a comma separated list. Return the number of cores
+     */
+
+    int number_of_cores = 0;
+    const char *position = argument;
+
+    while (*position && number_of_cores < MAX_CORES) {
+        char *end;
+        cores[number_of_cores++] = (int) strtol(position, &end, 0);
+        if (end == position) {
+            fprintf(stderr, "invalid core list %s\n", argument);
+            exit(-1);
+        }
+
+        if (*end != ',')
+            break;
+        position = end + 1;
+    }
+
+    return number_of_cores;
+}
+
+void print_usage(const char *program_name) {
+    printf("Usage: %s [-c core[,core...]] [-n samples] [-w warmup_samples] [-p priority] [-O path_prefix]\n"
+           "\t-c: cores to calibrate (the current one by default). The preemption cost is measured in all of them at\n"
+           "\t    the same time, and the migration cost from each one to the next one\n"
+           "\t-n: samples of each measure (%d by default)\n"
+           "\t-w: samples discarded at the start of each measure (%d by default)\n"
+           "\t-p: SCHED_FIFO priority of the measuring threads (the maximum by default)\n"
+           "\t-O: write the overhead profile to path_prefix.json and path_prefix.bin\n",
+           program_name, NUMBER_OF_SAMPLES, RT_MEASURE_DEFAULT_WARMUP_SAMPLES);
+}
+
+int main(int argc, char *argv[]) {
+    int cores[MAX_CORES];
+    int number_of_cores = 0;
+    long samples = NUMBER_OF_SAMPLES;
+    const char *overhead_profile_path = NULL;
+    static struct overhead_profile overhead_profile;
+
+    struct rt_measure_options options;
+    rt_measure_default_options(&options);
+
+    int option;
+    while ((option = getopt(argc, argv, "c:n:w:p:O:h")) != -1) {
+        switch (option) {
+            case 'c':
+                number_of_cores = parse_cores(optarg, cores);
+                break;
+            case 'n':
+                samples = strtol(optarg, NULL, 0);
+                break;
+            case 'w':
+                options.warmup_samples = strtol(optarg, NULL, 0);
+                break;
+            case 'p':
+                options.priority = (int) strtol(optarg, NULL, 0);
+                break;
+            case 'O':
+                overhead_profile_path = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(option == 'h' ? 0 : -1);
+        }
+    }
+
+    if (number_of_cores == 0)
+        cores[number_of_cores++] = sched_getcpu();
+
+    // Histograms where the results will be stored
+    static struct histogram preemption_histograms[MAX_CORES], migration_histogram;
+    if (rt_measure_preemption(cores, number_of_cores, samples, &options, preemption_histograms)) {
+        perror("preemption measure failed");
+        exit(-1);
+    }
+
+    timer_print_info();
+    if (overhead_profile_path != NULL) {
+        overhead_profile_init(&overhead_profile, "rt_calibrate", cores[0]);
+        overhead_profile_add_config(&overhead_profile, "samples", "%ld", samples);
+        overhead_profile_add_config(&overhead_profile, "warmup_samples", "%ld", options.warmup_samples);
+    }
+
+    for (int c = 0; c < number_of_cores; ++c) {
+        printf("Core: %d\n", cores[c]);
+        histogram_print(&preemption_histograms[c], "preemption");
+        if (overhead_profile_path != NULL)
+            overhead_profile_add(&overhead_profile, OVERHEAD_PREEMPTION, cores[c], -1, 0, "yield",
+                                 &preemption_histograms[c]);
+    }
+
+    for (int c = 0; c + 1 < number_of_cores; ++c) {
+        if (rt_measure_migration(cores[c], cores[c + 1], samples, &options, &migration_histogram)) {
+            perror("migration measure failed");
+            exit(-1);
+        }
+
+        printf("Migration: %d -> %d\n", cores[c], cores[c + 1]);
+        histogram_print(&migration_histogram, "migration");
+        if (overhead_profile_path != NULL)
+            overhead_profile_add(&overhead_profile, OVERHEAD_MIGRATION, cores[c + 1], cores[c], 0, "affinity",
+                                 &migration_histogram);
+    }
+
+    if (overhead_profile_path != NULL) {
+        overhead_profile_write(&overhead_profile, overhead_profile_path);
+        overhead_profile_free(&overhead_profile);
+    }
+
+    return 0;
+}
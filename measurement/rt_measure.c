@@ -0,0 +1,346 @@
+//
+// In-process measurement of the preemption and migration costs
+//
+#define _GNU_SOURCE
+
+#include "rt_measure.h"
+#include "../common/timer.h"
+
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Stack of the measuring threads
+#define RT_MEASURE_STACK_BYTES (PTHREAD_STACK_MIN + 0x4000)
+
+// The timer is calibrated once per process
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+
+// Start of the measuring threads, signaled once all of them have been created
+struct start_signal {
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    bool started;
+};
+
+// Pair of threads of a core of the preemption measure, each one in its own cache lines
+struct preemption_pair {
+    // Last timestamp before yielding of any of both threads
+    volatile uint64_t yield_time_measure;
+
+    // Switches seen, including the warm up ones, and switches to record
+    long switches;
+    long warmup_samples;
+    long total_samples;
+
+    // Resumption of the first and last recorded switches, to get the rate of switches
+    uint64_t first_switch_time_measure, last_switch_time_measure;
+
+    struct start_signal *start;
+    const volatile bool *finished;
+    const struct rt_measure_hooks *hooks;
+    struct histogram *histogram;
+} __attribute__((aligned(64)));
+
+// Thread of the migration measure
+struct migration_thread {
+    int source_core;
+    int destination_core;
+    long warmup_samples;
+    long total_samples;
+    const struct rt_measure_hooks *hooks;
+    struct histogram *histogram;
+
+    // errno of the failure of the thread, 0 if the measure was done
+    int error;
+};
+
+void rt_measure_default_options(struct rt_measure_options *options) {
+    options->priority = 0;
+    options->lock_memory = true;
+    options->warmup_samples = RT_MEASURE_DEFAULT_WARMUP_SAMPLES;
+    options->hooks = NULL;
+}
+
+static int prepare(const struct rt_measure_options *options) {
+    /***
+     * Calibrate the timer the first time and lock the memory if requested. Return 0 or -1 with errno set
+     */
+
+    pthread_once(&timer_once, timer_init);
+
+    if (options->lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE))
+        return -1;
+
+    return 0;
+}
+
+static int create_measuring_thread(pthread_t *thread, int core, int priority, void *(*thread_routine)(void *),
+                                   void *data) {
+    /***
+     * Create a SCHED_FIFO thread that executes thread_routine in core. Return 0 or the error number
+     */
+
+    pthread_attr_t attr;
+    struct sched_param param;
+    cpu_set_t affinity_mask;
+    int error;
+
+    if ((error = pthread_attr_init(&attr)))
+        return error;
+
+    param.sched_priority = priority ? priority : sched_get_priority_max(SCHED_FIFO);
+    CPU_ZERO(&affinity_mask);
+    CPU_SET(core, &affinity_mask);
+
+    if (!(error = pthread_attr_setstacksize(&attr, RT_MEASURE_STACK_BYTES)) &&
+        !(error = pthread_attr_setschedpolicy(&attr, SCHED_FIFO)) &&
+        !(error = pthread_attr_setschedparam(&attr, &param)) &&
+        !(error = pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED)) &&
+        !(error = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &affinity_mask)))
+        error = pthread_create(thread, &attr, thread_routine, data);
+
+    pthread_attr_destroy(&attr);
+    return error;
+}
+
+static void *preemption_thread_execution(void *data) {
+    /***
+     * Both threads of the pair yield to each other, and each one records the time from the yield of the other thread
+     * to its own resumption. They only switch in sched_yield, so they never update the pair at the same time
+     */
+
+    struct preemption_pair *pair = data;
+    const struct rt_measure_hooks *hooks = pair->hooks;
+
+    if (hooks != NULL && hooks->thread_start != NULL)
+        hooks->thread_start(hooks->context);
+
+    pthread_mutex_lock(&(pair->start->mutex));
+    while (!pair->start->started)
+        pthread_cond_wait(&(pair->start->condition), &(pair->start->mutex));
+    pthread_mutex_unlock(&(pair->start->mutex));
+
+    while (pair->switches < pair->total_samples && !*(pair->finished)) {
+        uint64_t yield_time_measure = timer_read();
+        pair->yield_time_measure = yield_time_measure;
+        sched_yield(); // Do context switch
+        uint64_t resume_time_measure = timer_read();
+
+        // If the other thread didn't run (it has finished) the yield returns at once
+        uint64_t other_yield_time_measure = pair->yield_time_measure;
+        if (other_yield_time_measure == yield_time_measure)
+            continue;
+
+        if (pair->switches++ < pair->warmup_samples)
+            continue;
+
+        long long cost = timer_interval_ns(other_yield_time_measure, resume_time_measure);
+        histogram_record(pair->histogram, cost);
+        if (pair->histogram->total_count == 1)
+            pair->first_switch_time_measure = resume_time_measure;
+        pair->last_switch_time_measure = resume_time_measure;
+
+        if (hooks != NULL && hooks->sample_end != NULL)
+            hooks->sample_end(hooks->context, cost);
+    }
+
+    return NULL;
+}
+
+static int measure_preemption(const int *cores, int number_of_cores, long samples, long duration_ms,
+                              const struct rt_measure_options *options, struct histogram *histograms,
+                              double *switches_per_second) {
+    /***
+     * Run a pair in each core until samples switches are recorded in every core, or during duration_ms if samples is
+     * 0. Return 0 or -1 with errno set
+     */
+
+    if (number_of_cores <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (prepare(options))
+        return -1;
+
+    struct preemption_pair *pairs = aligned_alloc(64, number_of_cores * sizeof(struct preemption_pair));
+    pthread_t *threads = malloc(2 * number_of_cores * sizeof(pthread_t));
+    if (pairs == NULL || threads == NULL) {
+        free(pairs);
+        free(threads);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    // All the pairs start at the same time, once every thread has been created
+    struct start_signal start = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, false};
+    volatile bool finished = false;
+
+    memset(pairs, 0, number_of_cores * sizeof(struct preemption_pair));
+    int created_threads = 0, error = 0;
+    for (int c = 0; c < number_of_cores; ++c) {
+        histogram_init(&histograms[c]);
+        pairs[c].warmup_samples = options->warmup_samples;
+        pairs[c].total_samples = samples ? options->warmup_samples + samples : LONG_MAX;
+        pairs[c].start = &start;
+        pairs[c].finished = &finished;
+        pairs[c].hooks = options->hooks;
+        pairs[c].histogram = &histograms[c];
+
+        for (int t = 0; t < 2 && !error; ++t) {
+            error = create_measuring_thread(&threads[created_threads], cores[c], options->priority,
+                                            preemption_thread_execution, &pairs[c]);
+            if (!error)
+                created_threads++;
+        }
+    }
+
+    // If a thread couldn't be created the ones already waiting are released without anything to measure
+    pthread_mutex_lock(&start.mutex);
+    if (error) {
+        for (int c = 0; c < number_of_cores; ++c)
+            pairs[c].total_samples = 0;
+    }
+    start.started = true;
+    pthread_cond_broadcast(&start.condition);
+    pthread_mutex_unlock(&start.mutex);
+
+    // Let the pairs switch during the measure
+    if (!samples && !error) {
+        struct timespec duration = {duration_ms / 1000, (duration_ms % 1000) * 1000000L};
+        nanosleep(&duration, NULL);
+        finished = true;
+    }
+
+    for (int t = 0; t < created_threads; ++t)
+        pthread_join(threads[t], NULL);
+
+    // The rate is calculated with the time each pair was switching, that doesn't depend on when the caller is woken
+    for (int c = 0; c < number_of_cores && switches_per_second != NULL; ++c) {
+        long long switching_time_ns = timer_ticks_to_ns(
+                (long long) (pairs[c].last_switch_time_measure - pairs[c].first_switch_time_measure));
+        switches_per_second[c] = switching_time_ns > 0 ?
+                                 (double) (histograms[c].total_count - 1) * 1e9 / (double) switching_time_ns : 0.0;
+    }
+
+    free(threads);
+    free(pairs);
+
+    if (error) {
+        errno = error;
+        return -1;
+    }
+
+    return 0;
+}
+
+int rt_measure_preemption(const int *cores, int number_of_cores, long samples, const struct rt_measure_options *options,
+                          struct histogram *histograms) {
+    if (samples <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return measure_preemption(cores, number_of_cores, samples, 0, options, histograms, NULL);
+}
+
+int rt_measure_preemption_rate(const int *cores, int number_of_cores, long duration_ms,
+                               const struct rt_measure_options *options, struct histogram *histograms,
+                               double *switches_per_second) {
+    if (duration_ms <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return measure_preemption(cores, number_of_cores, 0, duration_ms, options, histograms, switches_per_second);
+}
+
+static void *migration_thread_execution(void *data) {
+    /***
+     * Migrate the thread from the source core to the destination core and record the time of each migration
+     */
+
+    struct migration_thread *migration = data;
+    const struct rt_measure_hooks *hooks = migration->hooks;
+
+    if (hooks != NULL && hooks->thread_start != NULL)
+        hooks->thread_start(hooks->context);
+
+    cpu_set_t mask_source, mask_destination;
+    CPU_ZERO(&mask_source);
+    CPU_SET(migration->source_core, &mask_source);
+    CPU_ZERO(&mask_destination);
+    CPU_SET(migration->destination_core, &mask_destination);
+
+    for (long i = 0; i < migration->total_samples; ++i) {
+        if (sched_setaffinity(0, sizeof(cpu_set_t), &mask_source)) {
+            migration->error = errno;
+            return NULL;
+        }
+
+        bool recorded = i >= migration->warmup_samples;
+        if (recorded && hooks != NULL && hooks->sample_start != NULL)
+            hooks->sample_start(hooks->context);
+
+        uint64_t local_time_measure_before = timer_read();
+        if (sched_setaffinity(0, sizeof(cpu_set_t), &mask_destination)) {
+            migration->error = errno;
+            return NULL;
+        }
+        uint64_t local_time_measure_after = timer_read();
+
+        // The thread must already run in the destination core when sched_setaffinity returns
+        if (sched_getcpu() != migration->destination_core) {
+            migration->error = EAGAIN;
+            return NULL;
+        }
+
+        if (!recorded)
+            continue;
+
+        long long cost = timer_interval_ns(local_time_measure_before, local_time_measure_after);
+        histogram_record(migration->histogram, cost);
+        if (hooks != NULL && hooks->sample_end != NULL)
+            hooks->sample_end(hooks->context, cost);
+    }
+
+    return NULL;
+}
+
+int rt_measure_migration(int source_core, int destination_core, long samples,
+                         const struct rt_measure_options *options, struct histogram *histogram) {
+    if (samples <= 0 || source_core == destination_core) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (prepare(options))
+        return -1;
+
+    histogram_init(histogram);
+
+    struct migration_thread migration = {source_core, destination_core, options->warmup_samples,
+                                         options->warmup_samples + samples, options->hooks, histogram, 0};
+    pthread_t thread;
+    int error = create_measuring_thread(&thread, source_core, options->priority, migration_thread_execution,
+                                        &migration);
+    if (!error) {
+        pthread_join(thread, NULL);
+        error = migration.error;
+    }
+
+    if (error) {
+        errno = error;
+        return -1;
+    }
+
+    return 0;
+}
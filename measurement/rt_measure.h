@@ -0,0 +1,78 @@
+//
+// In-process measurement of the preemption and migration costs, so a real-time runtime can calibrate itself at
+// startup on the cores it will use
+//
+// Unlike the benchmarks, the functions don't print anything nor exit: they return 0, or -1 with errno set if the
+// measure couldn't be done (EPERM if SCHED_FIFO or the memory locking isn't allowed, EINVAL for a bad core...).
+// The measuring threads are created by the functions, so the scheduling policy and the affinity of the caller are
+// not modified. rt_measure.hpp is the C++ API over these functions.
+//
+#ifndef RT_MEASURE_H
+#define RT_MEASURE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../common/statistics.h"
+
+#define RT_MEASURE_DEFAULT_WARMUP_SAMPLES 100
+
+// Optional callbacks, run by the measuring threads, for the benchmarks that instrument the measures (NULL members are
+// skipped). They are out of the measured intervals
+struct rt_measure_hooks {
+    // Called by each measuring thread before its first sample (the per-thread counters are opened here)
+    void (*thread_start)(void *context);
+
+    // Called before the first timestamp of each recorded migration sample (rt_measure_migration only, in the
+    // preemption measure the other thread of the pair is switching at that point)
+    void (*sample_start)(void *context);
+
+    // Called after the last timestamp of each recorded sample with its cost
+    void (*sample_end)(void *context, long long cost_ns);
+
+    void *context;
+};
+
+struct rt_measure_options {
+    // SCHED_FIFO priority of the measuring threads (0 selects the maximum)
+    int priority;
+
+    // Lock the current and future memory of the process (mlockall) before measuring. It is left locked
+    bool lock_memory;
+
+    // Samples discarded at the start of each measure, while the caches and the branch predictors warm up
+    long warmup_samples;
+
+    // Callbacks around the samples (NULL for none)
+    const struct rt_measure_hooks *hooks;
+};
+
+// Fill the options with the default values: maximum priority, memory locked, RT_MEASURE_DEFAULT_WARMUP_SAMPLES and no
+// hooks
+void rt_measure_default_options(struct rt_measure_options *options);
+
+// Measure the preemption cost (from the sched_yield of a thread to the resumption of another one in the same core) in
+// each of the cores at the same time, with a pair of threads per core. The samples of cores[i] are recorded in
+// histograms[i], that are initialized by the function
+int rt_measure_preemption(const int *cores, int number_of_cores, long samples, const struct rt_measure_options *options,
+                          struct histogram *histograms);
+
+// Measure the preemption cost like rt_measure_preemption, but during duration_ms instead of a number of samples, and
+// store in switches_per_second[i] the rate of context switches of cores[i] while its pair was switching
+int rt_measure_preemption_rate(const int *cores, int number_of_cores, long duration_ms,
+                               const struct rt_measure_options *options, struct histogram *histograms,
+                               double *switches_per_second);
+
+// Measure the cost of migrating a thread from source_core to destination_core with sched_setaffinity (from the call
+// to its return in the destination core). The histogram is initialized by the function
+int rt_measure_migration(int source_core, int destination_core, long samples,
+                         const struct rt_measure_options *options, struct histogram *histogram);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RT_MEASURE_H
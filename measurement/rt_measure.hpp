@@ -0,0 +1,107 @@
+//
+// C++ API of the in-process measurement library (rt_measure.h)
+//
+// The functions return the histograms as objects and throw std::system_error if the measure couldn't be done
+//
+#ifndef RT_MEASURE_HPP
+#define RT_MEASURE_HPP
+
+#include <cerrno>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+#include "rt_measure.h"
+
+namespace rt_measure {
+
+// Samples of a measure, in nanoseconds. The histogram (about 60 KB) is kept in the heap
+class Histogram {
+public:
+    Histogram() : histogram_(new struct histogram) { histogram_init(histogram_.get()); }
+    Histogram(const Histogram &other) : histogram_(new struct histogram(*other.histogram_)) {}
+    Histogram(Histogram &&other) = default;
+    Histogram &operator=(const Histogram &other) {
+        *histogram_ = *other.histogram_;
+        return *this;
+    }
+    Histogram &operator=(Histogram &&other) = default;
+
+    long long percentile(double percentile) const { return histogram_percentile(histogram_.get(), percentile); }
+    long long min() const { return histogram_->min; }
+    long long max() const { return histogram_->max; }
+    double mean() const { return histogram_->mean; }
+    double stddev() const { return histogram_stddev(histogram_.get()); }
+    unsigned long long count() const { return histogram_->total_count; }
+
+    // Print it in the format of the benchmarks
+    void print(const char *cost_name) const { histogram_print(histogram_.get(), cost_name); }
+
+    const struct histogram *get() const { return histogram_.get(); }
+    struct histogram *get() { return histogram_.get(); }
+
+private:
+    std::unique_ptr<struct histogram> histogram_;
+};
+
+struct Options {
+    // SCHED_FIFO priority of the measuring threads (0 selects the maximum)
+    int priority = 0;
+
+    // Lock the memory of the process (mlockall) before measuring. It is left locked
+    bool lock_memory = true;
+
+    // Samples discarded at the start of each measure
+    long warmup_samples = RT_MEASURE_DEFAULT_WARMUP_SAMPLES;
+
+    struct rt_measure_options to_c() const { return {priority, lock_memory, warmup_samples, nullptr}; }
+};
+
+// Preemption cost in each of the cores at the same time, one histogram per core in the same order
+inline std::vector<Histogram> measure_preemption(const std::vector<int> &cores, long samples,
+                                                 const Options &options = Options()) {
+    // The C API needs the histograms contiguous
+    std::unique_ptr<struct histogram[]> histograms(new struct histogram[cores.size()]);
+    struct rt_measure_options c_options = options.to_c();
+
+    if (rt_measure_preemption(cores.data(), (int) cores.size(), samples, &c_options, histograms.get()))
+        throw std::system_error(errno, std::generic_category(), "rt_measure_preemption");
+
+    std::vector<Histogram> result(cores.size());
+    for (size_t i = 0; i < cores.size(); ++i)
+        *result[i].get() = histograms[i];
+    return result;
+}
+
+// Preemption cost in each of the cores at the same time during duration_ms, and rate of context switches of each core
+inline std::vector<Histogram> measure_preemption_rate(const std::vector<int> &cores, long duration_ms,
+                                                      std::vector<double> &switches_per_second,
+                                                      const Options &options = Options()) {
+    std::unique_ptr<struct histogram[]> histograms(new struct histogram[cores.size()]);
+    struct rt_measure_options c_options = options.to_c();
+    switches_per_second.assign(cores.size(), 0.0);
+
+    if (rt_measure_preemption_rate(cores.data(), (int) cores.size(), duration_ms, &c_options, histograms.get(),
+                                   switches_per_second.data()))
+        throw std::system_error(errno, std::generic_category(), "rt_measure_preemption_rate");
+
+    std::vector<Histogram> result(cores.size());
+    for (size_t i = 0; i < cores.size(); ++i)
+        *result[i].get() = histograms[i];
+    return result;
+}
+
+// Cost of migrating a thread from source_core to destination_core
+inline Histogram measure_migration(int source_core, int destination_core, long samples,
+                                   const Options &options = Options()) {
+    Histogram result;
+    struct rt_measure_options c_options = options.to_c();
+
+    if (rt_measure_migration(source_core, destination_core, samples, &c_options, result.get()))
+        throw std::system_error(errno, std::generic_category(), "rt_measure_migration");
+    return result;
+}
+
+} // namespace rt_measure
+
+#endif // RT_MEASURE_HPP
@@ -1,9 +1,17 @@
 #!/bin/bash
 
-CC=aarch64-none-linux-gnu-gcc
-ARCHITECTURE=aarch64
+ARCHITECTURE=${ARCHITECTURE:-aarch64}
+
+if [ "${ARCHITECTURE}" == "aarch64" ]; then
+  CC=${CC:-aarch64-none-linux-gnu-gcc}
+else
+  CC=${CC:-gcc}
+fi
 
 mkdir -p ../builds/${ARCHITECTURE}
 
+# In-process measurement library (measurement/rt_measure.c), the benchmark measures are built over it
+(cd ../measurement && ARCHITECTURE=${ARCHITECTURE} CC=${CC} bash compile.sh)
+
 # Get migration cost
-${CC} -Wall -static -pthread -lpthread -o ../builds/${ARCHITECTURE}/migration_cost migration_cost_linux.c
+${CC} -Wall -static -pthread -lpthread -o ../builds/${ARCHITECTURE}/migration_cost migration_cost_linux.c ../cache_management/l2_cache_fill.${ARCHITECTURE}.S ../common/perf_counters.c ../common/noise.c ../common/interference.c ../common/overhead_profile.c ../common/result_file.c ../common/preflight.c ../cache_management/cache_topology.c ../builds/${ARCHITECTURE}/librt_measure.a -lm
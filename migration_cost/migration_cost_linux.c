@@ -4,46 +4,857 @@
 #define _GNU_SOURCE
 
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sched.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+
+#include "../common/statistics.h"
+#include "../common/timer.h"
+#include "../common/perf_counters.h"
+#include "../common/noise.h"
+#include "../common/interference.h"
+#include "../common/overhead_profile.h"
+#include "../common/result_file.h"
+#include "../common/preflight.h"
+#include "../cache_management/cache_topology.h"
+#include "../measurement/rt_measure.h"
 
 // Define variables
 #define NUMBER_OF_EXPERIMENTS 100
 #define CORE_TO_TEST_INITIAL 2
 #define CORE_TO_TEST_FINAL 3
 
-bool timespec_subtract(struct timespec *result, struct timespec *start_time, struct timespec *end_time) {
+// Core of the thread that triggers the migrations of the decomposition mode (-D remote)
+#define CORE_TO_TEST_CONTROLLER 1
+
+// Maximum number of CPUs that can take part in the all-pairs test
+#define MAX_CPUS_TO_TEST CPU_SETSIZE
+
+// Counters read around each migration (-c option) and their deltas by latency band
+static bool use_perf_counters = false;
+static struct perf_counters perf_counters;
+static struct perf_attribution migration_attribution;
+
+// Noise detection (-N option)
+static bool detect_noise = false;
+
+// Antagonists of the -L option
+static struct interference interference;
+
+// Overhead profile (-O option) written at the end of the run
+static const char *overhead_profile_path = NULL;
+static struct overhead_profile overhead_profile;
+
+// Raw migration costs of the default mode (-r option), written to a result file at the end
+static const char *result_file_path = NULL;
+static struct result_series migration_series;
+
+// Settings of the tested cores checked before the run, the low noise setup is applied with the -i option
+static bool low_noise_setup = false;
+static struct preflight_report preflight_report;
+
+// Decomposition mode (-D option): the migration is triggered by the migrated thread itself or by a controller thread
+// in another core, while an observer spins in the destination core
+enum migration_trigger {
+    MIGRATION_TRIGGER_SELF,
+    MIGRATION_TRIGGER_REMOTE
+};
+
+// Decomposition mode: the migrated thread of the remote trigger considers it has stopped running if two consecutive
+// timestamps are separated more than this
+#define MIGRATION_GAP_NANOSECONDS 500
+
+// Working sets walked after the arrival: maximum number of footprints and limits of the footprint sweep (up to
+// WORKING_SET_L2_FACTOR times the L2 cache)
+#define MAX_WORKING_SETS 64
+#define WORKING_SET_MIN_SIZE_BYTES 1024
+#define WORKING_SET_L2_FACTOR 4
+
+// Kernel of the cache benchmark (cache_management/l2_cache_fill.<architecture>.S) used to walk the working sets
+extern void read_from_vector_64_bits(int64_t *initial_addr, int64_t *final_addr);
+
+// Data shared by the threads of the decomposition mode, each one written by a single thread and in its own cache line
+static volatile uint64_t observer_timestamp __attribute__((aligned(64)));
+static volatile bool decomposition_finished __attribute__((aligned(64)));
+static volatile long requested_experiment __attribute__((aligned(64)));
+static volatile long ready_experiment __attribute__((aligned(64)));
+static volatile long finished_experiment __attribute__((aligned(64)));
+
+// Thread id of the migrated thread, used by the controller to change its affinity
+static pid_t migrated_thread_id;
+
+// Working set walked before and after each migration, and its length (0 to disable the walks)
+static int64_t *working_set;
+static long working_set_length;
+
+// Timestamps of one migration of the decomposition mode
+struct migration_timestamps {
+    // Request of the migration: call of sched_setaffinity by the migrated thread or by the controller
+    uint64_t request;
+
+    // Last timestamp of the migrated thread in the source core (only with the remote trigger)
+    uint64_t last_in_source;
+
+    // Last timestamp of the observer, the destination core stopped running it to switch to the migrated thread
+    uint64_t observer_preempted;
+
+    // First timestamp of the migrated thread in the destination core
+    uint64_t first_in_destination;
+
+    // Return of sched_setaffinity in the thread that called it
+    uint64_t request_returned;
+
+    // Time to walk the working set while it is cached in the source core, and in the destination core just after
+    // the arrival
+    long long warm_walk_ns;
+    long long arrival_walk_ns;
+};
+
+static struct migration_timestamps migration_timestamps;
+
+// Histograms of each phase of the decomposition mode
+struct migration_phases {
+    struct histogram leave, transit, arrival, total, request_call, warm_walk, arrival_walk, cache_affinity_loss;
+};
+
+// Instrumentation of the migrations of measure_migration, run by the measuring thread of the library around each
+// sample
+struct migration_instrumentation {
+    struct histogram *clean_cost_histogram;
+    struct noise_detector noise_detector;
+    struct noise_counts noise_before;
+    int64_t counters_before[NUMBER_OF_PERF_COUNTERS];
+    long contaminated_migrations;
+};
+
+void migration_thread_start(void *context) {
+    // The counters count the events of the thread that opens them, a new one for each pair
+    if (use_perf_counters) {
+        if (perf_counters.enabled)
+            perf_counters_close(&perf_counters);
+        perf_counters_open(&perf_counters);
+    }
+}
+
+void migration_sample_start(void *context) {
+    struct migration_instrumentation *instrumentation = context;
+
+    if (detect_noise)
+        noise_detector_read(&(instrumentation->noise_detector), &(instrumentation->noise_before));
+    if (use_perf_counters)
+        perf_counters_read(&perf_counters, instrumentation->counters_before);
+}
+
+void migration_sample_end(void *context, long long migration_cost) {
+    struct migration_instrumentation *instrumentation = context;
+
+    if (use_perf_counters) {
+        int64_t counters_after[NUMBER_OF_PERF_COUNTERS];
+        perf_counters_read(&perf_counters, counters_after);
+        perf_attribution_record(&migration_attribution, migration_cost, instrumentation->counters_before,
+                                counters_after);
+    }
+
+    if (detect_noise) {
+        struct noise_counts noise_after;
+        noise_detector_read(&(instrumentation->noise_detector), &noise_after);
+        if (noise_counts_contaminated(&(instrumentation->noise_before), &noise_after))
+            instrumentation->contaminated_migrations++;
+        else
+            histogram_record(instrumentation->clean_cost_histogram, migration_cost);
+    }
+
+    if (migration_series.samples != NULL)
+        result_series_record(&migration_series, migration_cost);
+}
+
+long measure_migration(int core_initial, int core_final, struct histogram *migration_cost_histogram,
+                       struct histogram *clean_cost_histogram) {
+    /***
+     * Migrate a thread NUMBER_OF_EXPERIMENTS times from core_initial to core_final with the measurement library
+     * (measurement/rt_measure.c). The cost of each migration is recorded in migration_cost_histogram. With noise
+     * detection, the migrations without interrupts, softirqs or SMIs in any of both cores are also recorded in
+     * clean_cost_histogram
+     * Return the number of migrations hit by noise
+     */
+
+    struct migration_instrumentation instrumentation;
+    memset(&instrumentation, 0, sizeof(instrumentation));
+    instrumentation.clean_cost_histogram = clean_cost_histogram;
+
+    if (detect_noise) {
+        cpu_set_t tested_cpus;
+        CPU_ZERO(&tested_cpus);
+        CPU_SET(core_initial, &tested_cpus);
+        CPU_SET(core_final, &tested_cpus);
+        noise_detector_init(&(instrumentation.noise_detector), &tested_cpus);
+    }
+
+    struct rt_measure_hooks hooks = {migration_thread_start, migration_sample_start, migration_sample_end,
+                                     &instrumentation};
+
+    // The memory is already locked and the cores warmed up before the run
+    struct rt_measure_options options;
+    rt_measure_default_options(&options);
+    options.lock_memory = false;
+    options.warmup_samples = 0;
+    options.hooks = &hooks;
+
+    if (rt_measure_migration(core_initial, core_final, NUMBER_OF_EXPERIMENTS, &options, migration_cost_histogram)) {
+        // The thread didn't run in the destination core when sched_setaffinity returned
+        if (errno == EAGAIN) {
+            fprintf(stderr, "bad behaviour of the test: the migration from core %d to core %d didn't complete\n",
+                    core_initial, core_final);
+            preflight_print_causes(&preflight_report);
+        } else {
+            perror("migration failed");
+        }
+        exit(-1);
+    }
+
+    if (detect_noise)
+        noise_detector_close(&(instrumentation.noise_detector));
+
+    return instrumentation.contaminated_migrations;
+}
+
+void measure_all_pairs(cpu_set_t *cpus_to_test) {
+    /***
+     * Measure the migration cost between every (source, destination) pair of the CPUs in cpus_to_test
+     * and print the min/median/p99 matrices plus a CSV block with one line per pair
+     */
+
+    // Get the list of CPUs to test
+    int cpus[MAX_CPUS_TO_TEST];
+    int number_of_cpus = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, cpus_to_test))
+            cpus[number_of_cpus++] = cpu;
+    }
+
+    if (number_of_cpus < 2) {
+        fprintf(stderr, "at least two CPUs are needed in the affinity mask\n");
+        exit(-1);
+    }
+
+    // Results of each pair, indexed as [source * number_of_cpus + destination]
+    long long *min_cost = calloc(number_of_cpus * number_of_cpus, sizeof(long long));
+    long long *median_cost = calloc(number_of_cpus * number_of_cpus, sizeof(long long));
+    long long *p99_cost = calloc(number_of_cpus * number_of_cpus, sizeof(long long));
+    long long *clean_median_cost = calloc(number_of_cpus * number_of_cpus, sizeof(long long));
+    long long *contaminated = calloc(number_of_cpus * number_of_cpus, sizeof(long long));
+    if (min_cost == NULL || median_cost == NULL || p99_cost == NULL || clean_median_cost == NULL ||
+        contaminated == NULL) {
+        perror("calloc failed");
+        exit(-1);
+    }
+
+    struct histogram migration_cost_histogram, clean_cost_histogram;
+
+    // Noise of each CPU when nothing else runs in it
+    struct hwlat_result hwlat_results[number_of_cpus];
+    for (int cpu = 0; cpu < number_of_cpus && detect_noise; ++cpu)
+        noise_hwlat_run(cpus[cpu], &(hwlat_results[cpu]));
+
+    for (int source = 0; source < number_of_cpus; ++source) {
+        for (int destination = 0; destination < number_of_cpus; ++destination) {
+            if (source == destination)
+                continue;
+
+            histogram_init(&migration_cost_histogram);
+            histogram_init(&clean_cost_histogram);
+            int pair = source * number_of_cpus + destination;
+            contaminated[pair] = measure_migration(cpus[source], cpus[destination], &migration_cost_histogram,
+                                                   &clean_cost_histogram);
+
+            min_cost[pair] = migration_cost_histogram.min;
+            median_cost[pair] = histogram_percentile(&migration_cost_histogram, 50.0);
+            p99_cost[pair] = histogram_percentile(&migration_cost_histogram, 99.0);
+            clean_median_cost[pair] = histogram_percentile(&clean_cost_histogram, 50.0);
+
+            if (overhead_profile_path != NULL)
+                overhead_profile_add(&overhead_profile, OVERHEAD_MIGRATION, cpus[destination], cpus[source], 0,
+                                     "affinity", &migration_cost_histogram);
+        }
+    }
+
+    // Print result matrices (rows are the source CPU, columns the destination CPU)
+    const char *matrix_names[3] = {"Minimum", "Median", "99th percentile"};
+    long long *matrices[3] = {min_cost, median_cost, p99_cost};
+
+    timer_print_info();
+    printf("Experiment result: \n\t%s: %d\n\t%s: %d\n", "Number of experiments per pair", NUMBER_OF_EXPERIMENTS,
+           "Number of CPUs", number_of_cpus);
+
+    for (int m = 0; m < 3; ++m) {
+        printf("\n%s cost of migration (ns), rows: source CPU, columns: destination CPU\n%8s", matrix_names[m],
+               "src\\dst");
+        for (int destination = 0; destination < number_of_cpus; ++destination)
+            printf(" %10d", cpus[destination]);
+        printf("\n");
+
+        for (int source = 0; source < number_of_cpus; ++source) {
+            printf("%8d", cpus[source]);
+            for (int destination = 0; destination < number_of_cpus; ++destination) {
+                if (source == destination)
+                    printf(" %10s", "-");
+                else
+                    printf(" %10lld", matrices[m][source * number_of_cpus + destination]);
+            }
+            printf("\n");
+        }
+    }
+
+    for (int cpu = 0; cpu < number_of_cpus && detect_noise; ++cpu)
+        noise_hwlat_print(&(hwlat_results[cpu]));
+
+    // Print machine readable result
+    printf("\nsource_cpu,destination_cpu,min_ns,median_ns,p99_ns%s\n",
+           detect_noise ? ",clean_median_ns,contaminated_samples" : "");
+    for (int source = 0; source < number_of_cpus; ++source) {
+        for (int destination = 0; destination < number_of_cpus; ++destination) {
+            if (source == destination)
+                continue;
+
+            int pair = source * number_of_cpus + destination;
+            printf("%d,%d,%lld,%lld,%lld", cpus[source], cpus[destination], min_cost[pair], median_cost[pair],
+                   p99_cost[pair]);
+            if (detect_noise)
+                printf(",%lld,%lld", clean_median_cost[pair], contaminated[pair]);
+            printf("\n");
+        }
+    }
+
+    free(min_cost);
+    free(median_cost);
+    free(p99_cost);
+    free(clean_median_cost);
+    free(contaminated);
+}
+
+void set_affinity(pid_t thread_id, int core) {
+    /***
+     * Pin the thread thread_id (0 for the calling thread) to core
+     */
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(core, &mask);
+    if (sched_setaffinity(thread_id, sizeof(cpu_set_t), &mask)) {
+        perror("setaffinity failed");
+        exit(-1);
+    }
+}
+
+void create_pinned_thread(pthread_t *thread, int core, int priority, void *(*thread_routine)(void *)) {
+    /***
+     * Create a thread that executes thread_routine with the given SCHED_FIFO priority in core
+     */
+
+    struct sched_param param;
+    pthread_attr_t attr;
+    cpu_set_t affinity_mask;
+
+    if (pthread_attr_init(&attr)) {
+        perror("pthread init failed");
+        exit(-1);
+    }
+
+    if (pthread_attr_setstacksize(&attr, PTHREAD_STACK_MIN + 0x4000)) {
+        perror("pthread setstacksize failed");
+        exit(-1);
+    }
+
+    if (pthread_attr_setschedpolicy(&attr, SCHED_FIFO)) {
+        perror("pthread setschedpolicy failed");
+        exit(-1);
+    }
+    param.sched_priority = priority;
+
+    if (pthread_attr_setschedparam(&attr, &param)) {
+        perror("pthread setschedparam failed");
+        exit(-1);
+    }
+
+    if (pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED)) {
+        perror("pthread setinheritsched failed");
+        exit(-1);
+    }
+
+    CPU_ZERO(&affinity_mask);
+    CPU_SET(core, &affinity_mask);
+    if (pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &affinity_mask)) {
+        perror("pthread setaffinity failed");
+        exit(-1);
+    }
+
+    if (pthread_create(thread, &attr, thread_routine, NULL)) {
+        perror("thread creation failed");
+        exit(-1);
+    }
+}
+
+void *observer_thread_execution(void *data) {
+    /***
+     * Observer of the destination core, it takes timestamps continuously with the min priority, so the last one
+     * before the arrival of the migrated thread is the moment the destination core stopped running it
+     */
+
+    (void) data;
+
+    while (!decomposition_finished)
+        observer_timestamp = timer_read();
+
+    return NULL;
+}
+
+void wait_for_observer(void) {
+    /***
+     * Wait until the observer is spinning again in the destination core
+     */
+
+    uint64_t now = timer_read();
+    while ((int64_t) (observer_timestamp - now) < 0)
+        sched_yield();
+}
+
+long long walk_working_set(void) {
+    /***
+     * Walk the working set and return the time needed
+     */
+
+    uint64_t local_time_measure_before = timer_read();
+    read_from_vector_64_bits(working_set, &working_set[working_set_length - 1]);
+    uint64_t local_time_measure_after = timer_read();
+
+    return timer_interval_ns(local_time_measure_before, local_time_measure_after);
+}
+
+void walk_warm_working_set(struct migration_timestamps *timestamps) {
+    /***
+     * Load the working set in the cache of the source core and measure the time to walk it while it is cached
+     */
+
+    if (working_set_length == 0)
+        return;
+
+    read_from_vector_64_bits(working_set, &working_set[working_set_length - 1]);
+    timestamps->warm_walk_ns = walk_working_set();
+}
+
+void *migrated_thread_execution(void *data) {
+    /***
+     * Migrated thread of the remote trigger, it takes timestamps continuously in the source core until a gap in
+     * them shows it has been moved to the destination core
+     */
+
+    (void) data;
+
+    migrated_thread_id = (pid_t) syscall(SYS_gettid);
+    long gap_threshold_ticks = (long) (MIGRATION_GAP_NANOSECONDS / timer_ns_per_tick);
+
+    for (long experiment = 1; experiment <= NUMBER_OF_EXPERIMENTS; ++experiment) {
+        while (requested_experiment != experiment)
+            sched_yield();
+
+        set_affinity(0, CORE_TO_TEST_INITIAL);
+        walk_warm_working_set(&migration_timestamps);
+
+        // The controller can migrate the thread from now on
+        __atomic_store_n(&ready_experiment, experiment, __ATOMIC_RELEASE);
+
+        uint64_t previous_timestamp = timer_read();
+        for (;;) {
+            uint64_t timestamp = timer_read();
+            if ((long) (timestamp - previous_timestamp) > gap_threshold_ticks && sched_getcpu() == CORE_TO_TEST_FINAL) {
+                migration_timestamps.last_in_source = previous_timestamp;
+                migration_timestamps.first_in_destination = timestamp;
+                break;
+            }
+            previous_timestamp = timestamp;
+        }
+
+        if (working_set_length)
+            migration_timestamps.arrival_walk_ns = walk_working_set();
+
+        // The observer is stopped while this thread runs in its core
+        migration_timestamps.observer_preempted = observer_timestamp;
+
+        __atomic_store_n(&finished_experiment, experiment, __ATOMIC_RELEASE);
+    }
+
+    // The thread must exist until the controller stops changing its affinity
+    while (requested_experiment <= NUMBER_OF_EXPERIMENTS)
+        sched_yield();
+
+    return NULL;
+}
+
+void record_migration_phases(const struct migration_timestamps *timestamps, enum migration_trigger trigger,
+                             struct migration_phases *phases) {
+    /***
+     * Record the phases of one migration
+     */
+
+    uint64_t left_source = trigger == MIGRATION_TRIGGER_REMOTE ? timestamps->last_in_source : timestamps->request;
+
+    if (trigger == MIGRATION_TRIGGER_REMOTE) {
+        histogram_record(&phases->leave, timer_interval_ns(timestamps->request, left_source));
+        histogram_record(&phases->request_call, timer_interval_ns(timestamps->request, timestamps->request_returned));
+    }
+    histogram_record(&phases->transit, timer_interval_ns(left_source, timestamps->observer_preempted));
+    histogram_record(&phases->arrival,
+                     timer_interval_ns(timestamps->observer_preempted, timestamps->first_in_destination));
+    histogram_record(&phases->total, timer_interval_ns(timestamps->request, timestamps->first_in_destination));
+
+    if (working_set_length) {
+        histogram_record(&phases->warm_walk, timestamps->warm_walk_ns);
+        histogram_record(&phases->arrival_walk, timestamps->arrival_walk_ns);
+        histogram_record(&phases->cache_affinity_loss, timestamps->arrival_walk_ns - timestamps->warm_walk_ns);
+    }
+}
+
+void measure_migration_phases(enum migration_trigger trigger, struct migration_phases *phases) {
     /***
-     * Do timeval subtraction
-     * result = end_time - start_time
-     * Return true if is positive, else negative
+     * Migrate a thread NUMBER_OF_EXPERIMENTS times from CORE_TO_TEST_INITIAL to CORE_TO_TEST_FINAL and record the
+     * time of each phase:
+     * - leave: from the request until the thread stops running in the source core (remote trigger only, the
+     *   migrated thread leaves the source core inside its own call otherwise)
+     * - transit: until the destination core stops running the observer to switch to the migrated thread
+     * - arrival: until the first instruction of the migrated thread in the destination core
+     * - cache affinity loss: extra time to walk the working set in the destination core
      */
 
-    bool return_value;
-    if (end_time->tv_sec > start_time->tv_sec ||
-        (end_time->tv_sec == start_time->tv_sec && end_time->tv_nsec >= start_time->tv_nsec)) {
-        result->tv_sec = end_time->tv_sec - start_time->tv_sec;
-        result->tv_nsec = end_time->tv_nsec - start_time->tv_nsec;
-        return_value = true;
+    histogram_init(&phases->leave);
+    histogram_init(&phases->transit);
+    histogram_init(&phases->arrival);
+    histogram_init(&phases->total);
+    histogram_init(&phases->request_call);
+    histogram_init(&phases->warm_walk);
+    histogram_init(&phases->arrival_walk);
+    histogram_init(&phases->cache_affinity_loss);
+
+    decomposition_finished = false;
+    requested_experiment = 0;
+    ready_experiment = 0;
+    finished_experiment = 0;
+
+    pthread_t observer, migrated;
+    create_pinned_thread(&observer, CORE_TO_TEST_FINAL, sched_get_priority_min(SCHED_FIFO),
+                         observer_thread_execution);
+
+    if (trigger == MIGRATION_TRIGGER_REMOTE) {
+        // The main thread is the controller
+        set_affinity(0, CORE_TO_TEST_CONTROLLER);
+        create_pinned_thread(&migrated, CORE_TO_TEST_INITIAL, sched_get_priority_max(SCHED_FIFO),
+                             migrated_thread_execution);
+
+        for (long experiment = 1; experiment <= NUMBER_OF_EXPERIMENTS; ++experiment) {
+            __atomic_store_n(&requested_experiment, experiment, __ATOMIC_RELEASE);
+            while (__atomic_load_n(&ready_experiment, __ATOMIC_ACQUIRE) != experiment)
+                sched_yield();
+            wait_for_observer();
+
+            migration_timestamps.request = timer_read();
+            set_affinity(migrated_thread_id, CORE_TO_TEST_FINAL);
+            migration_timestamps.request_returned = timer_read();
+
+            while (__atomic_load_n(&finished_experiment, __ATOMIC_ACQUIRE) != experiment)
+                sched_yield();
+
+            record_migration_phases(&migration_timestamps, trigger, phases);
+        }
+
+        __atomic_store_n(&requested_experiment, NUMBER_OF_EXPERIMENTS + 1, __ATOMIC_RELEASE);
+        pthread_join(migrated, NULL);
     } else {
-        result->tv_sec = start_time->tv_sec - end_time->tv_sec;
-        result->tv_nsec = start_time->tv_nsec - end_time->tv_nsec;
-        return_value = false;
+        for (long experiment = 1; experiment <= NUMBER_OF_EXPERIMENTS; ++experiment) {
+            set_affinity(0, CORE_TO_TEST_INITIAL);
+            walk_warm_working_set(&migration_timestamps);
+            wait_for_observer();
+
+            migration_timestamps.request = timer_read();
+            set_affinity(0, CORE_TO_TEST_FINAL);
+            migration_timestamps.first_in_destination = timer_read();
+            migration_timestamps.request_returned = migration_timestamps.first_in_destination;
+
+            if (working_set_length)
+                migration_timestamps.arrival_walk_ns = walk_working_set();
+            migration_timestamps.observer_preempted = observer_timestamp;
+
+            record_migration_phases(&migration_timestamps, trigger, phases);
+        }
+    }
+
+    decomposition_finished = true;
+    pthread_join(observer, NULL);
+}
+
+void print_migration_phases(const struct migration_phases *phases, enum migration_trigger trigger) {
+    /***
+     * Print the distribution of each phase of the decomposition mode
+     */
+
+    printf("Migration trigger: %s\n", trigger == MIGRATION_TRIGGER_REMOTE ? "remote" : "self");
+    if (trigger == MIGRATION_TRIGGER_REMOTE) {
+        histogram_print(&phases->request_call, "sched_setaffinity call of the controller");
+        histogram_print(&phases->leave, "leave (request to last instruction in the source core)");
+        histogram_print(&phases->transit, "transit (last instruction in the source core to observer stopped)");
+    } else {
+        histogram_print(&phases->transit, "transit (request to observer stopped in the destination core)");
+    }
+    histogram_print(&phases->arrival, "arrival (observer stopped to first instruction in the destination core)");
+    histogram_print(&phases->total, "migration (request to first instruction in the destination core)");
+
+    if (working_set_length) {
+        histogram_print(&phases->warm_walk, "walk of the working set cached in the source core");
+        histogram_print(&phases->arrival_walk, "walk of the working set after the arrival");
+        histogram_print(&phases->cache_affinity_loss, "cache affinity loss");
+    }
+}
+
+void measure_decomposition(enum migration_trigger trigger, const long *footprints, int number_of_footprints) {
+    /***
+     * Measure the phases of the migration, without working set or for each footprint. With several footprints the
+     * medians of each phase are printed as CSV
+     */
+
+    static struct migration_phases phases;
+
+    if (number_of_footprints == 0) {
+        working_set_length = 0;
+        measure_migration_phases(trigger, &phases);
+
+        timer_print_info();
+        print_migration_phases(&phases, trigger);
+
+        if (overhead_profile_path != NULL)
+            overhead_profile_add(&overhead_profile, OVERHEAD_MIGRATION, CORE_TO_TEST_FINAL, CORE_TO_TEST_INITIAL, 0,
+                                 trigger == MIGRATION_TRIGGER_REMOTE ? "remote" : "self", &phases.total);
+        return;
+    }
+
+    long max_footprint = 0;
+    for (int f = 0; f < number_of_footprints; ++f)
+        max_footprint = footprints[f] > max_footprint ? footprints[f] : max_footprint;
+
+    // Buffer shared by all the working sets (it is locked in memory by mlockall)
+    working_set = mmap(NULL, max_footprint, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (working_set == MAP_FAILED) {
+        perror("mmap failed");
+        exit(-1);
+    }
+    memset(working_set, 1, max_footprint);
+
+    timer_print_info();
+    printf("Migration trigger: %s\n", trigger == MIGRATION_TRIGGER_REMOTE ? "remote" : "self");
+    printf("footprint_bytes,leave_p50_ns,transit_p50_ns,arrival_p50_ns,migration_p50_ns,warm_walk_p50_ns,"
+           "arrival_walk_p50_ns,cache_affinity_loss_p50_ns,cache_affinity_loss_p99_ns\n");
+
+    for (int f = 0; f < number_of_footprints; ++f) {
+        working_set_length = footprints[f] / (long) sizeof(int64_t);
+        measure_migration_phases(trigger, &phases);
+
+        printf("%ld,%lld,%lld,%lld,%lld,%lld,%lld,%lld,%lld\n", footprints[f],
+               trigger == MIGRATION_TRIGGER_REMOTE ? histogram_percentile(&phases.leave, 50.0) : 0,
+               histogram_percentile(&phases.transit, 50.0), histogram_percentile(&phases.arrival, 50.0),
+               histogram_percentile(&phases.total, 50.0), histogram_percentile(&phases.warm_walk, 50.0),
+               histogram_percentile(&phases.arrival_walk, 50.0),
+               histogram_percentile(&phases.cache_affinity_loss, 50.0),
+               histogram_percentile(&phases.cache_affinity_loss, 99.0));
+
+        if (overhead_profile_path != NULL)
+            overhead_profile_add(&overhead_profile, OVERHEAD_CACHE_REFILL, CORE_TO_TEST_FINAL, CORE_TO_TEST_INITIAL,
+                                 footprints[f], "cache_affinity_loss", &phases.cache_affinity_loss);
+    }
+
+    munmap(working_set, max_footprint);
+}
+
+int parse_working_sets(const char *argument, long *footprints) {
+    /***
+     * Get the footprints from a comma separated list of sizes in bytes, or the sweep sizes if argument is "sweep"
+     * Return the number of footprints
+     */
+
+    int number_of_footprints = 0;
+
+    if (strcmp(argument, "sweep") == 0) {
+        struct cache_topology topology;
+        cache_topology_detect(CORE_TO_TEST_INITIAL, &topology);
+
+        long l2_cache_size_bytes = cache_topology_level_size(&topology, 2);
+        if (l2_cache_size_bytes == 0)
+            l2_cache_size_bytes = cache_topology_last_level_size(&topology);
+
+        for (long footprint = WORKING_SET_MIN_SIZE_BYTES;
+             footprint <= WORKING_SET_L2_FACTOR * l2_cache_size_bytes && number_of_footprints < MAX_WORKING_SETS;
+             footprint *= 2)
+            footprints[number_of_footprints++] = footprint;
+
+        return number_of_footprints;
     }
 
-    if (result->tv_nsec < 0) {
-        result->tv_nsec += 1000000000L;
-        result->tv_sec -= 1L;
+    const char *position = argument;
+    while (*position && number_of_footprints < MAX_WORKING_SETS) {
+        char *end;
+        long footprint = strtol(position, &end, 0);
+
+        // The kernel reads whole cache lines
+        footprint &= ~63L;
+        if (footprint <= 0) {
+            fprintf(stderr, "invalid working set size %s\n", position);
+            exit(-1);
+        }
+        footprints[number_of_footprints++] = footprint;
+
+        if (*end != ',')
+            break;
+        position = end + 1;
     }
 
-    return return_value;
+    return number_of_footprints;
+}
+
+void print_usage(const char *program_name) {
+    printf("Usage: %s [-a] [-c] [-N] [-L mode:cpu[,cpu...]] [-D self|remote] [-w size[,size...]|sweep]\n"
+           "       [-O path_prefix] [-r file] [-i]\n"
+           "\t-a: measure the migration cost between every pair of CPUs of the affinity mask\n"
+           "\t    (by default only the migration from core %d to core %d is measured)\n"
+           "\t-c: read the performance counters around each migration and report their mean deltas by latency\n"
+           "\t-N: detect the platform noise: measure the gaps of a spinning loop in the destination core, tag the\n"
+           "\t    migrations hit by interrupts, softirqs or SMIs and report the clean distribution too\n"
+           "\t-D: decomposition mode, measure each phase of the migration with an observer spinning in the\n"
+           "\t    destination core: the thread migrates itself (self) or is migrated by a controller in core %d\n"
+           "\t    (remote). The -c, -N and -r options can't be used in this mode\n"
+           "\t-w: walk a working set of the given size (in bytes) in the source core before each migration and in the\n"
+           "\t    destination core after it, and report the cache affinity loss (decomposition mode only). sweep\n"
+           "\t    measures footprints from %d bytes up to %d times the L2 cache\n"
+           "\t-O: write the overhead profile (migration cost of each measured pair, or cache affinity loss by\n"
+           "\t    footprint with -w) with the metadata of the host to path_prefix.json and path_prefix.bin\n"
+           "\t-r: write the raw migration costs of the default mode and the configuration of the run to a result file\n"
+           "\t    (see common/result_file.h), to compare runs with compare_results. It can't be used with -a or -D\n"
+           "\t-i: apply a low noise setup to the tested cores during the run (IRQs, frequency, C-states, RT\n"
+           "\t    throttling and THP, see common/preflight.h), it needs root and the settings are restored at exit\n",
+           program_name, CORE_TO_TEST_INITIAL, CORE_TO_TEST_FINAL, CORE_TO_TEST_CONTROLLER, WORKING_SET_MIN_SIZE_BYTES,
+           WORKING_SET_L2_FACTOR);
+    printf("%s\t    It can't be used with -a or -D\n", interference_usage);
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    bool all_pairs = false;
+    bool decomposition = false;
+    enum migration_trigger trigger = MIGRATION_TRIGGER_SELF;
+    long footprints[MAX_WORKING_SETS];
+    int number_of_footprints = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "acNL:D:w:O:r:ih")) != -1) {
+        switch (option) {
+            case 'D':
+                decomposition = true;
+                if (strcmp(optarg, "self") == 0) {
+                    trigger = MIGRATION_TRIGGER_SELF;
+                } else if (strcmp(optarg, "remote") == 0) {
+                    trigger = MIGRATION_TRIGGER_REMOTE;
+                } else {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            case 'w':
+                number_of_footprints = parse_working_sets(optarg, footprints);
+                break;
+            case 'a':
+                all_pairs = true;
+                break;
+            case 'O':
+                overhead_profile_path = optarg;
+                break;
+            case 'r':
+                result_file_path = optarg;
+                break;
+            case 'i':
+                low_noise_setup = true;
+                break;
+            case 'c':
+                use_perf_counters = true;
+                break;
+            case 'N':
+                detect_noise = true;
+                break;
+            case 'L':
+                if (!interference_add(&interference, optarg)) {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(option == 'h' ? 0 : -1);
+        }
+    }
+
+    // The decomposition mode has its own threads and histograms, the counters, the noise tagging and the raw costs are
+    // only collected around the migrations of the other modes
+    if (decomposition && (use_perf_counters || detect_noise || result_file_path != NULL)) {
+        fprintf(stderr, "the -c, -N and -r options can't be used in the decomposition mode\n");
+        exit(-1);
+    }
+
+    // Only the default mode records the raw costs
+    if (all_pairs && result_file_path != NULL) {
+        fprintf(stderr, "the -r option can't be used in the all-pairs mode\n");
+        exit(-1);
+    }
+
+    // Only the default mode measures the cost idle and then under interference
+    if (interference.number_of_threads && (all_pairs || decomposition)) {
+        fprintf(stderr, "the -L option can't be used in the all-pairs and decomposition modes\n");
+        exit(-1);
+    }
+
+    // Get the CPUs where the process is allowed to run before changing its affinity
+    cpu_set_t cpus_to_test;
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &cpus_to_test)) {
+        perror("getaffinity failed");
+        exit(-1);
+    }
+
+    // Select and calibrate the timer
+    timer_init();
+
+    if (overhead_profile_path != NULL) {
+        overhead_profile_init(&overhead_profile, "migration_cost", CORE_TO_TEST_FINAL);
+        overhead_profile_add_config(&overhead_profile, "experiments", "%d", NUMBER_OF_EXPERIMENTS);
+        overhead_profile_add_config(&overhead_profile, "antagonists", "%d", interference.number_of_threads);
+        if (decomposition)
+            overhead_profile_add_config(&overhead_profile, "trigger", "%s",
+                                        trigger == MIGRATION_TRIGGER_REMOTE ? "remote" : "self");
+    }
+
+    // Check the settings of the tested cores (all the CPUs of the affinity mask in the all-pairs mode)
+    cpu_set_t preflight_cpus = cpus_to_test;
+    if (!all_pairs) {
+        CPU_ZERO(&preflight_cpus);
+        CPU_SET(CORE_TO_TEST_INITIAL, &preflight_cpus);
+        CPU_SET(CORE_TO_TEST_FINAL, &preflight_cpus);
+        if (decomposition && trigger == MIGRATION_TRIGGER_REMOTE)
+            CPU_SET(CORE_TO_TEST_CONTROLLER, &preflight_cpus);
+    }
+
+    preflight_check(&preflight_cpus, &preflight_report);
+    if (low_noise_setup)
+        preflight_apply(&preflight_cpus);
+
     // Set max priority for the thread
     // The sched fifo policy avoid involuntary preemption
     struct sched_param my_sched;
@@ -53,97 +864,134 @@ int main() {
         exit(-1);
     }
 
+    // The counters are opened by the measuring thread of each pair (migration_thread_start)
+    if (use_perf_counters)
+        perf_attribution_init(&migration_attribution);
+
     // Now lock all current and future pages from preventing of being paged
     if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
         perror("mlockall failed");
         exit(-1);
     }
 
-    long long migration_cost_nanoseconds[NUMBER_OF_EXPERIMENTS];
+    // Start sampling with the frequency of the tested cores stable
+    preflight_warm_up(&preflight_cpus);
 
-    for (int i = 0; i < NUMBER_OF_EXPERIMENTS; ++i) {
-        // Set sched initial affinity
-        cpu_set_t mask_initial;
-        CPU_ZERO(&mask_initial);
-        CPU_SET(CORE_TO_TEST_INITIAL, &mask_initial);
-        if (sched_setaffinity(0, sizeof(cpu_set_t), &mask_initial)) {
-            perror("setaffinity failed");
-            exit(-1);
+    if (decomposition) {
+        measure_decomposition(trigger, footprints, number_of_footprints);
+
+        if (munlockall())
+            perror("munlockall failed");
+
+        if (overhead_profile_path != NULL) {
+            overhead_profile_write(&overhead_profile, overhead_profile_path);
+            overhead_profile_free(&overhead_profile);
         }
 
-        // Set sched variables for final affinity
-        cpu_set_t mask_final;
-        CPU_ZERO(&mask_final);
-        CPU_SET(CORE_TO_TEST_FINAL, &mask_final);
+        return 0;
+    }
 
-        // Variables where the time will be stored
-        struct timespec local_time_measure_before, local_time_measure_after;
+    if (all_pairs) {
+        measure_all_pairs(&cpus_to_test);
 
-        // Get previous CPU for debug purposes
-        int cpu_initial = sched_getcpu();
+        // Unlock pages
+        if (munlockall())
+            perror("munlockall failed");
 
-        // Get time of migration
-        clock_gettime(CLOCK_MONOTONIC, &(local_time_measure_before));
-        if (sched_setaffinity(0, sizeof(cpu_set_t), &mask_final)) {
-            perror("setaffinity failed");
-            exit(-1);
+        if (use_perf_counters) {
+            perf_counters_print_info(&perf_counters);
+            perf_attribution_print(&migration_attribution, &perf_counters, "migration");
+            perf_counters_close(&perf_counters);
+        }
+
+        if (overhead_profile_path != NULL) {
+            overhead_profile_write(&overhead_profile, overhead_profile_path);
+            overhead_profile_free(&overhead_profile);
         }
-        clock_gettime(CLOCK_MONOTONIC, &(local_time_measure_after));
 
-        // Get posterior CPU for debug purposes
-        int cpu_final = sched_getcpu();
+        return 0;
+    }
 
-        // Calculate differences
-        struct timespec result;
+    struct histogram migration_cost_histogram, clean_cost_histogram;
+    histogram_init(&migration_cost_histogram);
+    histogram_init(&clean_cost_histogram);
 
-        // Preemption time difference
-        timespec_subtract(&result, &(local_time_measure_before), &(local_time_measure_after));
+    struct hwlat_result hwlat_result;
+    if (detect_noise)
+        noise_hwlat_run(CORE_TO_TEST_FINAL, &hwlat_result);
 
-        // Local preemption cost
-        migration_cost_nanoseconds[i] = result.tv_sec * 1000000000L + result.tv_nsec;
+    if (result_file_path != NULL)
+        result_series_init(&migration_series, "migration", NUMBER_OF_EXPERIMENTS);
 
-        // Check test behaviour
-        if (cpu_initial != CORE_TO_TEST_INITIAL || cpu_final != CORE_TO_TEST_FINAL) {
-            perror("bad behaviour of the test\n");
-            exit(-1);
-        }
+    long contaminated_migrations = measure_migration(CORE_TO_TEST_INITIAL, CORE_TO_TEST_FINAL,
+                                                     &migration_cost_histogram, &clean_cost_histogram);
+
+    // With antagonists, the migrations are measured again under interference after the idle ones
+    struct histogram idle_cost_histogram;
+    if (interference.number_of_threads) {
+        idle_cost_histogram = migration_cost_histogram;
+        histogram_init(&migration_cost_histogram);
+        histogram_init(&clean_cost_histogram);
+        if (result_file_path != NULL)
+            result_series_reset(&migration_series);
+
+        interference_start(&interference);
+        contaminated_migrations = measure_migration(CORE_TO_TEST_INITIAL, CORE_TO_TEST_FINAL,
+                                                    &migration_cost_histogram, &clean_cost_histogram);
+        interference_stop(&interference);
     }
 
     // Unlock pages
     if (munlockall())
         perror("munlockall failed");
 
-    // Analyze result
-    long long min_migration_cost_nanoseconds, max_migration_cost_nanoseconds, avg_migration_cost_nanoseconds;
+    // Print result
+    timer_print_info();
+    histogram_print(&migration_cost_histogram, "migration");
 
-    // Max calculation
-    max_migration_cost_nanoseconds = 0;
-    for (int i = 0; i < NUMBER_OF_EXPERIMENTS; ++i) {
-        if (max_migration_cost_nanoseconds < migration_cost_nanoseconds[i])
-            max_migration_cost_nanoseconds = migration_cost_nanoseconds[i];
+    if (detect_noise) {
+        printf("\t%s: %ld\n", "Number of migrations hit by interrupts, softirqs or SMIs", contaminated_migrations);
+        histogram_print(&clean_cost_histogram, "migration without noise");
+        noise_hwlat_print(&hwlat_result);
     }
 
-    // Min calculation
-    min_migration_cost_nanoseconds = max_migration_cost_nanoseconds;
-    for (int i = 0; i < NUMBER_OF_EXPERIMENTS; ++i) {
-        if (min_migration_cost_nanoseconds > migration_cost_nanoseconds[i])
-            min_migration_cost_nanoseconds = migration_cost_nanoseconds[i];
+    if (interference.number_of_threads) {
+        interference_print(&interference);
+        interference_print_comparison("migration", &idle_cost_histogram, &migration_cost_histogram);
     }
 
-    // Avg calculation (Warning: If NUMBER_OF_EXPERIMENTS or the preemption cost is very high, there can be an integer
-    // overflow in the variable avg_preemption_cost_nanoseconds)
-    avg_migration_cost_nanoseconds = 0;
-    for (int i = 0; i < NUMBER_OF_EXPERIMENTS; ++i) {
-        avg_migration_cost_nanoseconds += migration_cost_nanoseconds[i];
+    if (use_perf_counters) {
+        perf_counters_print_info(&perf_counters);
+        perf_attribution_print(&migration_attribution, &perf_counters, "migration");
+        perf_counters_close(&perf_counters);
     }
-    avg_migration_cost_nanoseconds = avg_migration_cost_nanoseconds / NUMBER_OF_EXPERIMENTS;
 
-    // Print result
-    printf("Experiment result: \n\t%s: %d\n\t%s: %lld ns\n\t%s: %lld ns\n\t%s: %lld ns\n",
-           "Number of experiments", NUMBER_OF_EXPERIMENTS,
-           "Minimum cost of migration", min_migration_cost_nanoseconds,
-           "Maximum cost of migration", max_migration_cost_nanoseconds,
-           "Average cost of migration", avg_migration_cost_nanoseconds);
+    if (overhead_profile_path != NULL) {
+        overhead_profile_add(&overhead_profile, OVERHEAD_MIGRATION, CORE_TO_TEST_FINAL, CORE_TO_TEST_INITIAL, 0,
+                             "affinity", &migration_cost_histogram);
+        if (detect_noise)
+            overhead_profile_add(&overhead_profile, OVERHEAD_MIGRATION, CORE_TO_TEST_FINAL, CORE_TO_TEST_INITIAL, 0,
+                                 "affinity_without_noise", &clean_cost_histogram);
+        overhead_profile_write(&overhead_profile, overhead_profile_path);
+        overhead_profile_free(&overhead_profile);
+    }
+
+    if (result_file_path != NULL) {
+        char antagonists[RESULT_FILE_CONFIG_VALUE_BYTES];
+        interference_describe(&interference, antagonists, sizeof(antagonists));
+
+        struct result_config result_config = {0};
+        result_config_add(&result_config, "mode", "affinity");
+        result_config_add(&result_config, "source_core", "%d", CORE_TO_TEST_INITIAL);
+        result_config_add(&result_config, "destination_core", "%d", CORE_TO_TEST_FINAL);
+        result_config_add(&result_config, "experiments", "%d", NUMBER_OF_EXPERIMENTS);
+        result_config_add(&result_config, "antagonists", "%s", antagonists);
+        result_config_add(&result_config, "perf_counters", "%d", use_perf_counters);
+        result_config_add(&result_config, "low_noise_setup", "%d", low_noise_setup);
+
+        result_file_write(result_file_path, "migration_cost", &result_config, &migration_series, 1);
+        result_series_destroy(&migration_series);
+    }
 
     return 0;
 }
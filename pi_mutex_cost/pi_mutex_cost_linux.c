@@ -0,0 +1,492 @@
+//
+// This program calculate the cost of the priority inheritance mutexes (PTHREAD_PRIO_INHERIT) in a Unix platform
+//
+// Three SCHED_FIFO threads with low, mid and high priority share a PI mutex. The low priority thread holds the mutex
+// when the high priority thread requests it, so the low priority thread is boosted until it releases the mutex. The
+// mid priority thread is woken just before the request, and must not run while the low priority thread is boosted.
+// The costs are measured with the three threads in one core and with the high priority thread in another core
+//
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../common/statistics.h"
+#include "../common/timer.h"
+#include "../common/preflight.h"
+
+// Define variables
+#define NUMBER_OF_EXPERIMENTS 1000
+#define CORE_TO_TEST 3
+
+// Cores of the cross core placement: the low and mid priority threads run in the first one and the high priority
+// thread in the second one
+#define CORE_TO_TEST_LOW 2
+#define CORE_TO_TEST_HIGH 3
+
+// Time the high priority thread sleeps between experiments, so the low priority thread takes the mutex
+#define INTER_EXPERIMENT_DELAY_NANOSECONDS 200000
+
+// Work done by the low priority thread in the critical section after the request of the high priority thread. It
+// must be long enough for the high priority thread to block in the kernel when it runs in another core
+#define CRITICAL_SECTION_NANOSECONDS 20000
+
+// The low priority thread considers it has been preempted if two consecutive timestamps are separated more than this
+#define PREEMPTION_GAP_NANOSECONDS 500
+
+// Maximum time the mid priority thread runs in each experiment, so a failure of the priority inheritance can't hang
+// the test
+#define MID_PRIORITY_RUN_NANOSECONDS 1000000
+
+enum placement {
+    PLACEMENT_SAME_CORE,
+    PLACEMENT_CROSS_CORE
+};
+
+enum scenario {
+    // Low and high priority threads: contended handoff
+    SCENARIO_HANDOFF,
+
+    // Low, mid and high priority threads: priority inversion avoided by the boost
+    SCENARIO_INVERSION,
+    NUMBER_OF_SCENARIOS
+};
+
+static const char *scenario_names[NUMBER_OF_SCENARIOS] = {"handoff", "inversion"};
+
+// Options of the test
+static long number_of_experiments = NUMBER_OF_EXPERIMENTS;
+
+// Configuration of the running test
+static enum placement tested_placement;
+static enum scenario tested_scenario;
+
+// Mutex shared by the threads
+static pthread_mutex_t pi_mutex;
+
+// Data shared between the threads, each one written by a single thread and in its own cache line
+static volatile long requested_experiment __attribute__((aligned(64)));
+static volatile long locked_experiment __attribute__((aligned(64)));
+static volatile long lock_requested_experiment __attribute__((aligned(64)));
+static volatile int mid_priority_request __attribute__((aligned(64)));
+static volatile long mid_priority_running __attribute__((aligned(64)));
+static volatile long finished_experiment __attribute__((aligned(64)));
+static volatile uint64_t mid_priority_timestamp __attribute__((aligned(64)));
+
+// Timestamps of the low priority thread in the last experiment, read by the high priority thread once it gets the
+// mutex
+static uint64_t low_priority_resumed_timestamp, low_priority_unlock_timestamp, mid_priority_seen_timestamp;
+
+// Histograms where the results will be stored
+struct histogram pi_lock_histogram, pi_unlock_histogram, normal_lock_histogram, normal_unlock_histogram;
+struct scenario_histograms {
+    struct histogram boost, handoff, blocking, blocking_overhead;
+    long inversions;
+};
+static struct scenario_histograms scenario_results[2][NUMBER_OF_SCENARIOS];
+
+static void delay(long nanoseconds) {
+    /***
+     * Busy wait the given time
+     */
+
+    uint64_t start = timer_read();
+    while (timer_ticks_to_ns((long long) (timer_read() - start)) < nanoseconds);
+}
+
+void *uncontended_thread_execution(void *data) {
+    /***
+     * Lock and unlock a PI mutex and a normal mutex without contention
+     */
+
+    (void) data;
+
+    pthread_mutex_t normal_mutex;
+    pthread_mutex_init(&normal_mutex, NULL);
+
+    for (long i = 0; i < number_of_experiments; ++i) {
+        uint64_t before_lock = timer_read();
+        pthread_mutex_lock(&pi_mutex);
+        uint64_t after_lock = timer_read();
+        pthread_mutex_unlock(&pi_mutex);
+        uint64_t after_unlock = timer_read();
+
+        histogram_record(&pi_lock_histogram, timer_interval_ns(before_lock, after_lock));
+        histogram_record(&pi_unlock_histogram, timer_interval_ns(after_lock, after_unlock));
+
+        before_lock = timer_read();
+        pthread_mutex_lock(&normal_mutex);
+        after_lock = timer_read();
+        pthread_mutex_unlock(&normal_mutex);
+        after_unlock = timer_read();
+
+        histogram_record(&normal_lock_histogram, timer_interval_ns(before_lock, after_lock));
+        histogram_record(&normal_unlock_histogram, timer_interval_ns(after_lock, after_unlock));
+    }
+
+    pthread_mutex_destroy(&normal_mutex);
+    return NULL;
+}
+
+void *low_priority_thread_execution(void *data) {
+    /***
+     * Take the mutex and work until the high priority thread requests it. If the request preempts this thread (same
+     * core, or the mid priority thread runs in this core), the first timestamp after the preemption is the moment
+     * it was resumed with the boosted priority
+     */
+
+    (void) data;
+
+    long gap_threshold_ticks = (long) (PREEMPTION_GAP_NANOSECONDS / timer_ns_per_tick);
+    bool preempted_by_request = tested_placement == PLACEMENT_SAME_CORE || tested_scenario == SCENARIO_INVERSION;
+
+    for (long i = 1; i <= number_of_experiments; ++i) {
+        while (requested_experiment != i);
+
+        pthread_mutex_lock(&pi_mutex);
+        __atomic_store_n(&locked_experiment, i, __ATOMIC_RELEASE);
+
+        uint64_t previous_timestamp = timer_read(), timestamp;
+        for (;;) {
+            timestamp = timer_read();
+            if (__atomic_load_n(&lock_requested_experiment, __ATOMIC_ACQUIRE) == i &&
+                (!preempted_by_request || (long) (timestamp - previous_timestamp) > gap_threshold_ticks))
+                break;
+            previous_timestamp = timestamp;
+        }
+        low_priority_resumed_timestamp = timestamp;
+
+        // Rest of the critical section
+        delay(CRITICAL_SECTION_NANOSECONDS);
+
+        mid_priority_seen_timestamp = mid_priority_timestamp;
+        low_priority_unlock_timestamp = timer_read();
+        pthread_mutex_unlock(&pi_mutex);
+    }
+
+    return NULL;
+}
+
+void *mid_priority_thread_execution(void *data) {
+    /***
+     * Wait until the high priority thread wakes this thread, and run until the experiment finishes
+     */
+
+    (void) data;
+
+    for (int i = 1; i <= number_of_experiments; ++i) {
+        while (mid_priority_request != i)
+            syscall(SYS_futex, &mid_priority_request, FUTEX_WAIT_PRIVATE, i - 1, NULL, NULL, 0);
+
+        mid_priority_running = i;
+
+        uint64_t start = timer_read();
+        do {
+            mid_priority_timestamp = timer_read();
+        } while (finished_experiment != i &&
+                 timer_ticks_to_ns((long long) (mid_priority_timestamp - start)) < MID_PRIORITY_RUN_NANOSECONDS);
+    }
+
+    return NULL;
+}
+
+void *high_priority_thread_execution(void *data) {
+    /***
+     * Request the mutex while the low priority thread holds it and record the cost of each phase
+     */
+
+    (void) data;
+
+    struct scenario_histograms *results = &(scenario_results[tested_placement][tested_scenario]);
+    struct timespec inter_experiment_delay = {0, INTER_EXPERIMENT_DELAY_NANOSECONDS};
+
+    for (long i = 1; i <= number_of_experiments; ++i) {
+        requested_experiment = i;
+
+        // Sleep until the low priority thread holds the mutex
+        do {
+            nanosleep(&inter_experiment_delay, NULL);
+        } while (__atomic_load_n(&locked_experiment, __ATOMIC_ACQUIRE) != i);
+
+        // Wake the mid priority thread, in other core wait until it preempts the low priority thread
+        if (tested_scenario == SCENARIO_INVERSION) {
+            mid_priority_request = (int) i;
+            syscall(SYS_futex, &mid_priority_request, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+            if (tested_placement == PLACEMENT_CROSS_CORE)
+                while (mid_priority_running != i);
+        }
+
+        uint64_t request_timestamp = timer_read();
+        __atomic_store_n(&lock_requested_experiment, i, __ATOMIC_RELEASE);
+        pthread_mutex_lock(&pi_mutex);
+        uint64_t acquired_timestamp = timer_read();
+        pthread_mutex_unlock(&pi_mutex);
+
+        // The timestamps of the low priority thread were written before it released the mutex
+        long long blocking = timer_interval_ns(request_timestamp, acquired_timestamp);
+        long long critical_section = timer_interval_ns(low_priority_resumed_timestamp, low_priority_unlock_timestamp);
+
+        if (tested_placement == PLACEMENT_SAME_CORE || tested_scenario == SCENARIO_INVERSION)
+            histogram_record(&(results->boost), timer_interval_ns(request_timestamp, low_priority_resumed_timestamp));
+        histogram_record(&(results->handoff), timer_interval_ns(low_priority_unlock_timestamp, acquired_timestamp));
+        histogram_record(&(results->blocking), blocking);
+        histogram_record(&(results->blocking_overhead), blocking - critical_section);
+
+        // The mid priority thread must not run while the low priority thread is boosted: after the request in the
+        // same core, and after the boost preempts it in the cross core placement
+        if (tested_scenario == SCENARIO_INVERSION) {
+            uint64_t boost_timestamp = tested_placement == PLACEMENT_SAME_CORE ? request_timestamp :
+                                       low_priority_resumed_timestamp;
+            if ((int64_t) (mid_priority_seen_timestamp - boost_timestamp) > 0)
+                results->inversions++;
+        }
+
+        finished_experiment = i;
+    }
+
+    return NULL;
+}
+
+void create_test_thread(pthread_t *thread, int core, int priority, void *(*thread_routine)(void *)) {
+    /***
+     * Create a thread that executes thread_routine with the given SCHED_FIFO priority in core
+     */
+
+    struct sched_param param;
+    pthread_attr_t attr;
+    cpu_set_t affinity_mask;
+
+    // Init attrs
+    if (pthread_attr_init(&attr)) {
+        perror("pthread init failed");
+        exit(-1);
+    }
+
+    // Set a specific stack size
+    if (pthread_attr_setstacksize(&attr, PTHREAD_STACK_MIN + 0x4000)) {
+        perror("pthread setstacksize failed");
+        exit(-1);
+    }
+
+    // Set scheduler policy and priority of pthread
+    if (pthread_attr_setschedpolicy(&attr, SCHED_FIFO)) {
+        perror("pthread setschedpolicy failed");
+        exit(-1);
+    }
+    param.sched_priority = priority;
+
+    if (pthread_attr_setschedparam(&attr, &param)) {
+        perror("pthread setschedparam failed");
+        exit(-1);
+    }
+
+    // Use scheduling parameters of attr
+    if (pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED)) {
+        perror("pthread setinheritsched failed");
+        exit(-1);
+    }
+
+    // Set thread affinity
+    CPU_ZERO(&affinity_mask);
+    CPU_SET(core, &affinity_mask);
+
+    if (pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &affinity_mask)) {
+        perror("pthread setaffinity failed");
+        exit(-1);
+    }
+
+    if (pthread_create(thread, &attr, thread_routine, NULL)) {
+        perror("thread creation failed");
+        exit(-1);
+    }
+}
+
+void run_scenario(enum placement placement, enum scenario scenario) {
+    /***
+     * Run the threads of a scenario, the low and mid priority threads in the same core and the high priority thread
+     * in that core or in another one
+     */
+
+    tested_placement = placement;
+    tested_scenario = scenario;
+
+    requested_experiment = 0;
+    locked_experiment = 0;
+    lock_requested_experiment = 0;
+    mid_priority_request = 0;
+    mid_priority_running = 0;
+    finished_experiment = 0;
+    mid_priority_timestamp = 0;
+
+    struct scenario_histograms *results = &(scenario_results[placement][scenario]);
+    histogram_init(&(results->boost));
+    histogram_init(&(results->handoff));
+    histogram_init(&(results->blocking));
+    histogram_init(&(results->blocking_overhead));
+    results->inversions = 0;
+
+    int low_core = placement == PLACEMENT_SAME_CORE ? CORE_TO_TEST : CORE_TO_TEST_LOW;
+    int high_core = placement == PLACEMENT_SAME_CORE ? CORE_TO_TEST : CORE_TO_TEST_HIGH;
+    int max_priority = sched_get_priority_max(SCHED_FIFO);
+
+    pthread_t threads[3];
+    int number_of_threads = 0;
+    create_test_thread(&threads[number_of_threads++], low_core, max_priority - 2, low_priority_thread_execution);
+    if (scenario == SCENARIO_INVERSION)
+        create_test_thread(&threads[number_of_threads++], low_core, max_priority - 1, mid_priority_thread_execution);
+    create_test_thread(&threads[number_of_threads++], high_core, max_priority, high_priority_thread_execution);
+
+    for (int i = 0; i < number_of_threads; ++i)
+        pthread_join(threads[i], NULL);
+}
+
+void print_scenario(enum placement placement, enum scenario scenario) {
+    /***
+     * Print a line of the CSV block for each cost of the scenario
+     */
+
+    struct scenario_histograms *results = &(scenario_results[placement][scenario]);
+    const char *cost_names[4] = {"boost", "handoff", "blocking", "blocking_overhead"};
+    struct histogram *histograms[4] = {&(results->boost), &(results->handoff), &(results->blocking),
+                                       &(results->blocking_overhead)};
+
+    for (int i = 0; i < 4; ++i) {
+        if (histograms[i]->total_count == 0)
+            continue;
+
+        printf("%s,%s,%s,%lld,%lld,%lld,%lld,%ld\n", placement == PLACEMENT_SAME_CORE ? "same_core" : "cross_core",
+               scenario_names[scenario], cost_names[i], histograms[i]->min, histogram_percentile(histograms[i], 50.0),
+               histogram_percentile(histograms[i], 99.0), histograms[i]->max,
+               scenario == SCENARIO_INVERSION ? results->inversions : 0);
+    }
+}
+
+void print_usage(const char *program_name) {
+    printf("Usage: %s [-p same|cross|both] [-n experiments] [-i]\n"
+           "\t-p: placement of the threads (both by default): all of them in core %d (same) or the low and mid\n"
+           "\t    priority threads in core %d and the high priority thread in core %d (cross)\n"
+           "\t-n: number of experiments (%d by default)\n"
+           "\t-i: apply a low noise setup to the tested cores during the run (IRQs, frequency, C-states, RT\n"
+           "\t    throttling and THP, see common/preflight.h), it needs root and the settings are restored at exit\n",
+           program_name, CORE_TO_TEST, CORE_TO_TEST_LOW, CORE_TO_TEST_HIGH, NUMBER_OF_EXPERIMENTS);
+}
+
+int main(int argc, char *argv[]) {
+    bool placements[2] = {true, true};
+    bool low_noise_setup = false;
+    static struct preflight_report preflight_report;
+
+    int option;
+    while ((option = getopt(argc, argv, "p:n:ih")) != -1) {
+        switch (option) {
+            case 'p':
+                if (strcmp(optarg, "same") == 0) {
+                    placements[PLACEMENT_CROSS_CORE] = false;
+                } else if (strcmp(optarg, "cross") == 0) {
+                    placements[PLACEMENT_SAME_CORE] = false;
+                } else if (strcmp(optarg, "both") != 0) {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            case 'n':
+                number_of_experiments = strtol(optarg, NULL, 0);
+                break;
+            case 'i':
+                low_noise_setup = true;
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(option == 'h' ? 0 : -1);
+        }
+    }
+
+    // Initialize the priority inheritance mutex
+    pthread_mutexattr_t mutex_attr;
+    if (pthread_mutexattr_init(&mutex_attr) || pthread_mutexattr_setprotocol(&mutex_attr, PTHREAD_PRIO_INHERIT) ||
+        pthread_mutex_init(&pi_mutex, &mutex_attr)) {
+        perror("PI mutex initialization failed");
+        exit(-1);
+    }
+    pthread_mutexattr_destroy(&mutex_attr);
+
+    histogram_init(&pi_lock_histogram);
+    histogram_init(&pi_unlock_histogram);
+    histogram_init(&normal_lock_histogram);
+    histogram_init(&normal_unlock_histogram);
+
+    // Select and calibrate the timer
+    timer_init();
+
+    // Check the settings of the cores of the selected placements
+    cpu_set_t tested_cpus;
+    CPU_ZERO(&tested_cpus);
+    CPU_SET(CORE_TO_TEST, &tested_cpus);
+    if (placements[PLACEMENT_CROSS_CORE]) {
+        CPU_SET(CORE_TO_TEST_LOW, &tested_cpus);
+        CPU_SET(CORE_TO_TEST_HIGH, &tested_cpus);
+    }
+    preflight_check(&tested_cpus, &preflight_report);
+    if (low_noise_setup)
+        preflight_apply(&tested_cpus);
+
+    // Lock memory
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        perror("mlockall failed");
+    }
+
+    // Start sampling with the frequency of the tested cores stable
+    preflight_warm_up(&tested_cpus);
+
+    pthread_t uncontended_thread;
+    create_test_thread(&uncontended_thread, CORE_TO_TEST, sched_get_priority_max(SCHED_FIFO),
+                       uncontended_thread_execution);
+    pthread_join(uncontended_thread, NULL);
+
+    for (int placement = PLACEMENT_SAME_CORE; placement <= PLACEMENT_CROSS_CORE; ++placement) {
+        if (!placements[placement])
+            continue;
+
+        for (int scenario = 0; scenario < NUMBER_OF_SCENARIOS; ++scenario)
+            run_scenario(placement, scenario);
+    }
+
+    // Unlock pages
+    if (munlockall()) {
+        perror("munlockall failed");
+        exit(-1);
+    }
+
+    // Print result
+    timer_print_info();
+    histogram_print(&pi_lock_histogram, "uncontended PI mutex lock");
+    histogram_print(&pi_unlock_histogram, "uncontended PI mutex unlock");
+    histogram_print(&normal_lock_histogram, "uncontended normal mutex lock");
+    histogram_print(&normal_unlock_histogram, "uncontended normal mutex unlock");
+
+    // boost: request to the low priority thread resumed with the boosted priority (only when the request preempts
+    // it), handoff: unlock of the low priority thread to the high priority thread with the mutex, blocking: request to
+    // the high priority thread with the mutex, blocking_overhead: blocking minus the critical section done after the
+    // boost
+    printf("Contended result: \n\t%s: %ld\n\t%s: %d ns\n", "Number of experiments per scenario", number_of_experiments,
+           "Critical section after the request", CRITICAL_SECTION_NANOSECONDS);
+    printf("placement,scenario,cost,min_ns,p50_ns,p99_ns,max_ns,priority_inversions\n");
+    for (int placement = PLACEMENT_SAME_CORE; placement <= PLACEMENT_CROSS_CORE; ++placement) {
+        for (int scenario = 0; scenario < NUMBER_OF_SCENARIOS && placements[placement]; ++scenario)
+            print_scenario(placement, scenario);
+    }
+
+    pthread_mutex_destroy(&pi_mutex);
+    return 0;
+}
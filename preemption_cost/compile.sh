@@ -1,10 +1,24 @@
 #!/bin/bash
 
 # Architecture variables
-CC=aarch64-none-linux-gnu-gcc
-ARCHITECTURE=aarch64
+ARCHITECTURE=${ARCHITECTURE:-aarch64}
+
+if [ "${ARCHITECTURE}" == "aarch64" ]; then
+  CC=${CC:-aarch64-none-linux-gnu-gcc}
+else
+  CC=${CC:-gcc}
+fi
 
 mkdir -p ../builds/${ARCHITECTURE}
 
+# In-process measurement library (measurement/rt_measure.c), the benchmark measures are built over it
+(cd ../measurement && ARCHITECTURE=${ARCHITECTURE} CC=${CC} bash compile.sh)
+
 # Get preemption cost
-${CC} -Wall -static -pthread  -lpthread -o ../builds/${ARCHITECTURE}/preemption_cost preemption_cost_linux.c
\ No newline at end of file
+${CC} -Wall -static -pthread  -lpthread -o ../builds/${ARCHITECTURE}/preemption_cost preemption_cost_linux.c ../cache_management/l2_cache_fill.${ARCHITECTURE}.S ../cache_management/cache_topology.c ../common/sample_ring.c ../common/sample_file.c ../common/perf_counters.c ../common/noise.c ../common/interference.c ../common/sched_trace.c ../common/overhead_profile.c ../common/result_file.c ../common/preflight.c ../builds/${ARCHITECTURE}/librt_measure.a -lm
+
+# Get involuntary preemption cost
+${CC} -Wall -static -pthread  -lpthread -o ../builds/${ARCHITECTURE}/timer_preemption timer_preemption_linux.c ../common/statistics.c ../common/timer.c ../common/preflight.c -lm
+
+# Get context switch cost between threads and between processes
+${CC} -Wall -static -pthread  -lpthread -o ../builds/${ARCHITECTURE}/process_switch process_switch_linux.c ../common/statistics.c ../common/timer.c ../common/preflight.c -lm
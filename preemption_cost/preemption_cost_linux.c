@@ -6,237 +6,1177 @@
 #define _GNU_SOURCE
 
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sched.h>
 #include <pthread.h>
 #include <stdbool.h>
 #include <limits.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../common/statistics.h"
+#include "../common/timer.h"
+#include "../common/sample_ring.h"
+#include "../common/sample_file.h"
+#include "../common/perf_counters.h"
+#include "../common/noise.h"
+#include "../common/interference.h"
+#include "../common/sched_trace.h"
+#include "../common/overhead_profile.h"
+#include "../common/result_file.h"
+#include "../common/preflight.h"
+#include "../cache_management/cache_topology.h"
+#include "../measurement/rt_measure.h"
 
 // Define variables
 #define NUMBER_OF_EXPERIMENTS 100
 #define CORE_TO_TEST 3
 
+// Core of the thread that drains the samples of the measuring threads (it shouldn't be the core under test)
+#define HOUSEKEEPING_CORE 0
+
+// Time the drainer sleeps when there are no samples, and time between two progress reports of long runs
+#define DRAINER_SLEEP_NANOSECONDS 1000000L
+#define PROGRESS_INTERVAL_SECONDS 60
+
+// Scaling mode: time during which the pairs switch in each step
+#define SCALING_STEP_MILLISECONDS 1000
+
+// Scheduler trace (-T option): maximum number of experiments whose timestamps are kept, and margin around them where
+// their tracepoints are searched (it covers the error of the conversion between the clocks)
+#define TRACE_MAX_EXPERIMENTS 100000
+#define TRACE_MATCH_MARGIN_NANOSECONDS 1000
+
+// Working set mode: maximum number of footprints and limits of the footprint sweep (up to WORKING_SET_L2_FACTOR times
+// the L2 cache)
+#define MAX_WORKING_SETS 64
+#define WORKING_SET_MIN_SIZE_BYTES 1024
+#define WORKING_SET_L2_FACTOR 4
+
+// Kernel of the cache benchmark (cache_management/l2_cache_fill.<architecture>.S) used to walk the working sets
+extern void read_from_vector_64_bits(int64_t *initial_addr, int64_t *final_addr);
+
 // Barrier for the test
-static pthread_barrier_t start_barrier, end_barrier;
+static pthread_barrier_t start_barrier, end_barrier, collect_barrier;
+
+// Options of the default mode: number of experiments (0 means no limit) and duration of the run in seconds (0 means
+// no limit)
+static long number_of_experiments = NUMBER_OF_EXPERIMENTS;
+static long test_duration_seconds = 0;
+
+// Decision of thread 0 about running the next experiment, written before the start barrier and read by both threads
+// after it
+static volatile bool test_running;
+
+// Raw samples of each thread, only written by that thread and only read by the drainer
+struct sample_ring *sample_rings[2];
+
+// The drainer finishes when this is set and the rings are empty
+static volatile bool measures_finished;
+
+// Core of the drainer and file where the raw samples are streamed (optional)
+static int housekeeping_core = HOUSEKEEPING_CORE;
+static const char *sample_file_path = NULL;
+
+// Overhead profile (-O option) written at the end of the run
+static const char *overhead_profile_path = NULL;
+static struct overhead_profile overhead_profile;
+
+// Raw preemption costs of the last run (-r option), written to a result file at the end
+static const char *result_file_path = NULL;
+static struct result_series preemption_series;
+
+// Antagonists of the -L option, and result of the run with the machine idle
+static struct interference interference;
+struct histogram idle_preemption_cost_histogram;
+
+// Experiments whose measures were not consistent, and first of them
+static long bad_experiments = 0;
+static struct ring_sample first_bad_experiment[2];
+
+// Settings of the tested cores checked before the run, the low noise setup is applied with the -i option
+static bool low_noise_setup = false;
+static struct preflight_report preflight_report;
+
+// Histogram where the results will be stored
+struct histogram preemption_cost_histogram;
+
+// Noise detection (-N option): the samples without interrupts, softirqs or SMIs in the tested core are also recorded
+// in the clean histogram. The noise counts are only read by thread 0
+static bool detect_noise = false;
+struct noise_detector noise_detector;
+struct histogram clean_preemption_cost_histogram;
+static long contaminated_experiments = 0;
+
+// Counters of each thread (-c option), opened by the thread itself, and deltas of both threads by latency band
+static bool use_perf_counters = false;
+struct perf_counters perf_counters[2];
+struct perf_attribution preemption_attribution;
+
+// Scheduler trace (-T option): tracepoints of the tested core, thread ids of both threads and timestamps of each
+// experiment (the one before the yield of the first thread and the one after the resumption of the second)
+struct traced_experiment {
+    uint64_t yield_time_measure;
+    uint64_t resume_time_measure;
+    int first;
+};
+
+static bool trace_scheduler = false;
+static struct sched_trace sched_trace;
+static pid_t thread_ids[2];
+static struct traced_experiment *traced_experiments;
+static long number_of_traced_experiments = 0;
+
+// Phases of the traced experiments, and experiments that couldn't be split
+struct histogram trace_entry_histogram, trace_pick_histogram, trace_switch_histogram, trace_return_histogram;
+static long interrupted_traced_experiments = 0, incomplete_traced_experiments = 0;
+
+// Working set of each thread in the working set mode
+int64_t *working_sets[2];
+long working_set_length;
+
+// Measures of the last experiment of each thread in the working set mode
+uint64_t yield_measures[2], resume_measures[2];
+long long warm_walk_measures[2], reload_walk_measures[2];
+
+// Histograms of the working set mode: direct switch cost, extra time to walk the working set after being preempted
+// and sum of both
+struct histogram switch_cost_histogram, reload_penalty_histogram, total_cost_histogram;
+
+void collect_experiment(const struct ring_sample *samples) {
+    /***
+     * Record the preemption cost of an experiment from the samples of both threads and check the correction of the
+     * test. values[0] is the preemption point and values[1] the debug point of each thread
+     */
+
+    uint64_t time_measures[2] = {samples[0].values[0], samples[1].values[0]};
+    uint64_t debug_time_measures[2] = {samples[0].values[1], samples[1].values[1]};
+
+    // Preemption time difference (any of both threads can be the first one in yielding the CPU)
+    long long preemption_cost;
+    if (time_measures[1] >= time_measures[0])
+        preemption_cost = timer_interval_ns(time_measures[0], time_measures[1]);
+    else
+        preemption_cost = timer_interval_ns(time_measures[1], time_measures[0]);
+    histogram_record(&preemption_cost_histogram, preemption_cost);
+    if (result_file_path != NULL)
+        result_series_record(&preemption_series, preemption_cost);
+
+    if ((samples[0].flags | samples[1].flags) & RING_SAMPLE_CONTAMINATED)
+        contaminated_experiments++;
+    else
+        histogram_record(&clean_preemption_cost_histogram, preemption_cost);
+
+    // The switch involves both threads, so the counters of both are added
+    if (use_perf_counters) {
+        int64_t counter_deltas[NUMBER_OF_PERF_COUNTERS];
+        for (int j = 0; j < NUMBER_OF_PERF_COUNTERS; ++j)
+            counter_deltas[j] = samples[0].counters[j] + samples[1].counters[j];
+        perf_attribution_record_deltas(&preemption_attribution, preemption_cost, counter_deltas);
+    }
+
+    if (trace_scheduler && number_of_traced_experiments < TRACE_MAX_EXPERIMENTS) {
+        int first = time_measures[0] <= time_measures[1] ? 0 : 1;
+        struct traced_experiment *experiment = &(traced_experiments[number_of_traced_experiments++]);
+        experiment->yield_time_measure = time_measures[first];
+        experiment->resume_time_measure = time_measures[1 - first];
+        experiment->first = first;
+    }
+
+    // Check the correction of the test, the run is not stopped so long runs are not lost
+    if (debug_time_measures[1] < time_measures[0] || debug_time_measures[0] < time_measures[1]) {
+        if (bad_experiments == 0)
+            memcpy(first_bad_experiment, samples, sizeof(first_bad_experiment));
+        bad_experiments++;
+    }
+}
+
+bool next_experiment(long experiment, const struct timespec *deadline) {
+    /***
+     * Check if the experiment must be run, according to the number of experiments and the duration of the test
+     */
 
-// Data structures where the results will be stored
-struct timespec time_measures[2][NUMBER_OF_EXPERIMENTS];
-struct timespec debug_time_measures[2][NUMBER_OF_EXPERIMENTS];
+    if (number_of_experiments && experiment >= number_of_experiments)
+        return false;
+
+    if (test_duration_seconds) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec))
+            return false;
+    }
+
+    return true;
+}
 
 void *thread_execution(void *data) {
     // Id of the process
     long process_id = (long) data;
 
+    struct sample_ring *sample_ring = sample_rings[process_id];
+    thread_ids[process_id] = (pid_t) syscall(SYS_gettid);
+
+    // The counters count the events of the thread that opens them
+    if (use_perf_counters) {
+        if (perf_counters[process_id].enabled)
+            perf_counters_close(&(perf_counters[process_id]));
+        perf_counters_open(&(perf_counters[process_id]));
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += test_duration_seconds;
+
     // Debug time get
-    for (int i = 0; i < NUMBER_OF_EXPERIMENTS; ++i) {
+    for (long i = 0;; ++i) {
         // Define variables as locals to avoid cache fails while the measure
-        struct timespec local_time_measure;
-        struct timespec debug_local_time_measure;
+        uint64_t local_time_measure;
+        uint64_t debug_local_time_measure;
+        int64_t counters_before[NUMBER_OF_PERF_COUNTERS], counters_after[NUMBER_OF_PERF_COUNTERS];
+        struct noise_counts noise_before, noise_after;
+
+        // Decide if the experiment is run. The other thread reads the decision of the previous experiment before
+        // reaching its end barrier, so it can't be overwritten before being read
+        if (process_id == 0) {
+            test_running = next_experiment(i, &deadline);
+            if (detect_noise)
+                noise_detector_read(&noise_detector, &noise_before);
+        }
+
+        // The counters are read outside the measured interval: the thread that runs second is switched in between
+        // the yield of the first one and its own timestamp, so its "before" read must be done before the barrier
+        if (use_perf_counters)
+            perf_counters_read(&(perf_counters[process_id]), counters_before);
 
         // Synchronize both threads
         pthread_barrier_wait(&start_barrier);
 
+        if (!test_running)
+            break;
+
         // Get time (used to calculate preemption)
-        clock_gettime(CLOCK_MONOTONIC, &(local_time_measure));
+        local_time_measure = timer_read();
         sched_yield(); // Do context switch
 
         // Get time (used for debug purposes)
-        clock_gettime(CLOCK_MONOTONIC, &(debug_local_time_measure));
+        debug_local_time_measure = timer_read();
+
+        if (use_perf_counters)
+            perf_counters_read(&(perf_counters[process_id]), counters_after);
+
         sched_yield(); // Do context switch
 
         // Synchronize both threads
         pthread_barrier_wait(&end_barrier);
 
+        // Hand the measures to the drainer. It never blocks, if the drainer is late the sample is dropped
+        struct ring_sample sample = {
+                .thread = (uint32_t) process_id,
+                .sequence = (uint64_t) i,
+                .values = {local_time_measure, debug_local_time_measure}
+        };
+        for (int j = 0; j < NUMBER_OF_PERF_COUNTERS && use_perf_counters; ++j)
+            sample.counters[j] = counters_after[j] - counters_before[j];
+
+        // Both threads run in the same core, so the noise counts of thread 0 cover the experiment
+        if (process_id == 0 && detect_noise) {
+            noise_detector_read(&noise_detector, &noise_after);
+            if (noise_counts_contaminated(&noise_before, &noise_after))
+                sample.flags |= RING_SAMPLE_CONTAMINATED;
+        }
+        sample_ring_push(sample_ring, &sample);
+    }
+
+    return NULL;
+}
+
+void print_progress(void) {
+    /***
+     * Print the partial result of a long run
+     */
+
+    printf("Progress: %llu experiments, p50 %lld ns, p99 %lld ns, p99.99 %lld ns, max %lld ns, dropped %llu, "
+           "bad %ld\n", (unsigned long long) preemption_cost_histogram.total_count,
+           histogram_percentile(&preemption_cost_histogram, 50.0),
+           histogram_percentile(&preemption_cost_histogram, 99.0),
+           histogram_percentile(&preemption_cost_histogram, 99.99), preemption_cost_histogram.max,
+           (unsigned long long) (sample_rings[0]->dropped + sample_rings[1]->dropped), bad_experiments);
+    fflush(stdout);
+}
+
+void *drainer_execution(void *data) {
+    /***
+     * Housekeeping thread: take the samples of both rings, write them to the sample file (data, if it isn't NULL)
+     * and record the experiments whose samples are available from both threads
+     */
+
+    const char *output_path = data;
+
+    struct sample_file sample_file;
+    if (output_path != NULL)
+        sample_file_open(&sample_file, output_path, "preemption");
+
+    struct timespec last_progress, now;
+    clock_gettime(CLOCK_MONOTONIC, &last_progress);
+
+    for (;;) {
+        // Read the flag before draining, so no sample pushed before it was set is left behind
+        bool finished = measures_finished;
+        bool drained_any = false;
+
+        for (;;) {
+            const struct ring_sample *samples[2] = {sample_ring_peek(sample_rings[0]),
+                                                    sample_ring_peek(sample_rings[1])};
+            if (samples[0] == NULL || samples[1] == NULL)
+                break;
+
+            // A sample without its pair (the other one was dropped) is discarded
+            if (samples[0]->sequence != samples[1]->sequence) {
+                int oldest = samples[0]->sequence < samples[1]->sequence ? 0 : 1;
+                if (output_path != NULL)
+                    sample_file_write(&sample_file, samples[oldest]);
+                sample_ring_pop(sample_rings[oldest]);
+                continue;
+            }
+
+            struct ring_sample experiment_samples[2] = {*samples[0], *samples[1]};
+            sample_ring_pop(sample_rings[0]);
+            sample_ring_pop(sample_rings[1]);
+
+            collect_experiment(experiment_samples);
+            if (output_path != NULL) {
+                sample_file_write(&sample_file, &experiment_samples[0]);
+                sample_file_write(&sample_file, &experiment_samples[1]);
+            }
+            drained_any = true;
+        }
+
+        if (finished)
+            break;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec - last_progress.tv_sec >= PROGRESS_INTERVAL_SECONDS) {
+            print_progress();
+            last_progress = now;
+        }
+
+        if (!drained_any) {
+            struct timespec drainer_sleep = {0, DRAINER_SLEEP_NANOSECONDS};
+            nanosleep(&drainer_sleep, NULL);
+        }
+    }
+
+    if (output_path != NULL) {
+        printf("Sample file: \n\t%s: %s\n\t%s: %llu\n", "Path", output_path,
+               "Number of samples", (unsigned long long) sample_file.number_of_records);
+        sample_file_close(&sample_file);
+    }
+
+    return NULL;
+}
+
+pthread_t start_drainer(const char *output_path) {
+    /***
+     * Start the drainer thread in the housekeeping core with the normal (non real time) scheduler
+     */
+
+    pthread_t drainer;
+    pthread_attr_t attr;
+    struct sched_param param;
+    cpu_set_t affinity_mask;
+
+    if (pthread_attr_init(&attr)) {
+        perror("pthread init failed");
+        exit(-1);
+    }
+
+    if (pthread_attr_setschedpolicy(&attr, SCHED_OTHER)) {
+        perror("pthread setschedpolicy failed");
+        exit(-1);
+    }
+    param.sched_priority = 0;
+
+    if (pthread_attr_setschedparam(&attr, &param)) {
+        perror("pthread setschedparam failed");
+        exit(-1);
+    }
+
+    if (pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED)) {
+        perror("pthread setinheritsched failed");
+        exit(-1);
+    }
+
+    CPU_ZERO(&affinity_mask);
+    CPU_SET(housekeeping_core, &affinity_mask);
+
+    if (pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &affinity_mask)) {
+        perror("pthread setaffinity failed");
+        exit(-1);
+    }
+
+    if (pthread_create(&drainer, &attr, drainer_execution, (void *) output_path)) {
+        perror("thread creation failed");
+        exit(-1);
+    }
+
+    return drainer;
+}
+
+void print_bad_experiments(const char *first_point, const char *second_point) {
+    /***
+     * Report the experiments whose measures were not consistent with the points of the first of them, and the issues
+     * found in the preflight that can explain them
+     */
+
+    fprintf(stderr, "bad behaviour of the test in %ld experiments\n", bad_experiments);
+
+    printf("Test with error %llu\n", (unsigned long long) first_bad_experiment[0].sequence);
+    for (int j = 0; j < 2; ++j) {
+        printf("Thread %d:\n\t%s: %llu ticks\n\t%s: %llu ticks\n", j + 1, first_point,
+               (unsigned long long) first_bad_experiment[j].values[0], second_point,
+               (unsigned long long) first_bad_experiment[j].values[1]);
+    }
+
+    preflight_print_causes(&preflight_report);
+}
+
+void collect_working_set_experiment(long experiment) {
+    /***
+     * Record the costs of the last experiment of the working set mode and check the correction of the test
+     * The thread that yields first (first) is resumed directly when the other one (second) yields
+     */
+
+    int first = yield_measures[0] <= yield_measures[1] ? 0 : 1;
+    int second = 1 - first;
+
+    // Check the correction of the test, the inconsistent experiments are reported at the end of the run
+    if (yield_measures[second] > resume_measures[first] || resume_measures[first] > resume_measures[second]) {
+        if (bad_experiments == 0) {
+            for (int j = 0; j < 2; ++j) {
+                first_bad_experiment[j].sequence = experiment;
+                first_bad_experiment[j].values[0] = yield_measures[j];
+                first_bad_experiment[j].values[1] = resume_measures[j];
+            }
+        }
+        bad_experiments++;
+        return;
+    }
+
+    long long switch_cost = timer_interval_ns(yield_measures[second], resume_measures[first]);
+    long long reload_penalty = reload_walk_measures[first] - warm_walk_measures[first];
+
+    histogram_record(&switch_cost_histogram, switch_cost);
+    histogram_record(&reload_penalty_histogram, reload_penalty);
+    histogram_record(&total_cost_histogram, switch_cost + reload_penalty);
+}
+
+void *working_set_thread_execution(void *data) {
+    // Id of the process
+    long process_id = (long) data;
+
+    int64_t *working_set = working_sets[process_id];
+    int64_t *working_set_end = &working_set[working_set_length - 1];
+
+    for (long i = 0; i < number_of_experiments; ++i) {
+        // Define variables as locals to avoid cache fails while the measure
+        uint64_t local_time_measure_before, local_time_measure_after;
+        uint64_t yield_local_time_measure, resume_local_time_measure;
+        long long warm_walk_time, reload_walk_time;
+
+        // Synchronize both threads
+        pthread_barrier_wait(&start_barrier);
+
+        // Load the working set in the cache and measure the time to walk it while it is cached
+        read_from_vector_64_bits(working_set, working_set_end);
+        local_time_measure_before = timer_read();
+        read_from_vector_64_bits(working_set, working_set_end);
+        local_time_measure_after = timer_read();
+        warm_walk_time = timer_interval_ns(local_time_measure_before, local_time_measure_after);
+
+        // Do context switch, the other thread walks its own working set before yielding back
+        yield_local_time_measure = timer_read();
+        sched_yield();
+        resume_local_time_measure = timer_read();
+
+        // Walk the working set again after the preemption
+        local_time_measure_before = timer_read();
+        read_from_vector_64_bits(working_set, working_set_end);
+        local_time_measure_after = timer_read();
+        reload_walk_time = timer_interval_ns(local_time_measure_before, local_time_measure_after);
+
+        sched_yield(); // Let the other thread walk its working set again
+
+        // Synchronize both threads
+        pthread_barrier_wait(&end_barrier);
+
         // Copy local to global data structures
-        debug_time_measures[process_id][i] = debug_local_time_measure;
-        time_measures[process_id][i] = local_time_measure;
+        yield_measures[process_id] = yield_local_time_measure;
+        resume_measures[process_id] = resume_local_time_measure;
+        warm_walk_measures[process_id] = warm_walk_time;
+        reload_walk_measures[process_id] = reload_walk_time;
+
+        // Wait until both measures are available and record them
+        pthread_barrier_wait(&collect_barrier);
+        if (process_id == 0)
+            collect_working_set_experiment(i);
     }
 
     return NULL;
 }
 
-bool timespec_subtract(struct timespec *result, struct timespec *start_time, struct timespec *end_time) {
+void create_test_thread(pthread_t *thread, int core, void *(*thread_routine)(void *), void *data) {
     /***
-     * Do timeval subtraction
-     * result = end_time - start_time
-     * Return true if is positive, else negative
+     * Create a thread that executes thread_routine with the max SCHED_FIFO priority in core
      */
 
-    bool return_value;
-    if (end_time->tv_sec > start_time->tv_sec ||
-        (end_time->tv_sec == start_time->tv_sec && end_time->tv_nsec >= start_time->tv_nsec)) {
-        result->tv_sec = end_time->tv_sec - start_time->tv_sec;
-        result->tv_nsec = end_time->tv_nsec - start_time->tv_nsec;
-        return_value = true;
-    } else {
-        result->tv_sec = start_time->tv_sec - end_time->tv_sec;
-        result->tv_nsec = start_time->tv_nsec - end_time->tv_nsec;
-        return_value = false;
+    struct sched_param param;
+    pthread_attr_t attr;
+    cpu_set_t affinity_mask;
+
+    // Init attrs
+    if (pthread_attr_init(&attr)) {
+        perror("pthread init failed");
+        exit(-1);
     }
 
-    if (result->tv_nsec < 0) {
-        result->tv_nsec += 1000000000L;
-        result->tv_sec -= 1L;
+    // Set a specific stack size
+    if (pthread_attr_setstacksize(&attr, PTHREAD_STACK_MIN + 0x4000)) {
+        perror("pthread setstacksize failed");
+        exit(-1);
+    }
+
+    // Set scheduler policy and priority of pthread
+    if (pthread_attr_setschedpolicy(&attr, SCHED_FIFO)) {
+        perror("pthread setschedpolicy failed");
+        exit(-1);
+    }
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+
+    if (pthread_attr_setschedparam(&attr, &param)) {
+        perror("pthread setschedparam failed");
+        exit(-1);
+    }
+
+    // Use scheduling parameters of attr
+    if (pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED)) {
+        perror("pthread setinheritsched failed");
+        exit(-1);
     }
 
-    return return_value;
+    // Set thread affinity
+    CPU_ZERO(&affinity_mask);
+    CPU_SET(core, &affinity_mask);
+
+    if (pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &affinity_mask)) {
+        perror("pthread setaffinity failed");
+        exit(-1);
+    }
+
+    if (pthread_create(thread, &attr, thread_routine, data)) {
+        perror("thread creation failed");
+        exit(-1);
+    }
+
+    pthread_attr_destroy(&attr);
 }
 
-int main() {
+void run_threads(void *(*thread_routine)(void *)) {
+    /***
+     * Execute thread_routine in two threads with the max SCHED_FIFO priority in CORE_TO_TEST
+     */
+
     pthread_t threads[2];
-    struct sched_param param[2];
-    pthread_attr_t attr[2];
-    cpu_set_t affinity_mask[2];
 
-    // Initialize barriers
-    if (pthread_barrier_init(&start_barrier, NULL, 2))
-        perror("thread barrier initialization failed");
+    for (long i = 0; i < 2; i++)
+        create_test_thread(&threads[i], CORE_TO_TEST, thread_routine, (void *) i);
 
-    if (pthread_barrier_init(&end_barrier, NULL, 2))
-        perror("thread barrier initialization failed");
+    for (int i = 0; i < 2; i++)
+        pthread_join(threads[i], NULL);
+}
 
-    // Lock memory
-    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
-        perror("mlockall failed");
+void measure_scaling(const int *cores, int number_of_cores) {
+    /***
+     * Run a yielding pair in the first 1, 2, ... number_of_cores cores at the same time and print the preemption
+     * cost of each core and the aggregated number of context switches per second. The pairs are the ones of the
+     * measurement library (measurement/rt_measure.c)
+     */
+
+    struct histogram *histograms = malloc(number_of_cores * sizeof(struct histogram));
+    double *switches_per_second = malloc(number_of_cores * sizeof(double));
+    if (histograms == NULL || switches_per_second == NULL) {
+        perror("malloc failed");
+        exit(-1);
     }
 
-    // Configure threads attributes
-    for (int i = 0; i < 2; ++i) {
-        // Init attrs
-        if (pthread_attr_init(&(attr[i]))) {
-            perror("pthread init failed");
+    // The memory is already locked and the cores warmed up before the run
+    struct rt_measure_options options;
+    rt_measure_default_options(&options);
+    options.lock_memory = false;
+    options.warmup_samples = 0;
+
+    printf("Scaling result: \n\t%s: %d ms\n", "Duration of each step", SCALING_STEP_MILLISECONDS);
+    printf("active_cores,core,switches_per_second,p50_ns,p99_ns,max_ns\n");
+
+    // Summary of each step: aggregated switches per second and worst median and 99th percentile of the cores
+    double *total_switches_per_second = calloc(number_of_cores, sizeof(double));
+    long long *worst_p50 = calloc(number_of_cores, sizeof(long long));
+    long long *worst_p99 = calloc(number_of_cores, sizeof(long long));
+    if (total_switches_per_second == NULL || worst_p50 == NULL || worst_p99 == NULL) {
+        perror("calloc failed");
+        exit(-1);
+    }
+
+    for (int active_cores = 1; active_cores <= number_of_cores; ++active_cores) {
+        if (rt_measure_preemption_rate(cores, active_cores, SCALING_STEP_MILLISECONDS, &options, histograms,
+                                       switches_per_second)) {
+            perror("scaling step failed");
             exit(-1);
         }
 
-        // Set a specific stack size
-        if (pthread_attr_setstacksize(&(attr[i]), PTHREAD_STACK_MIN + 0x4000)) {
-            perror("pthread setstacksize failed");
-            exit(-1);
+        for (int c = 0; c < active_cores; ++c) {
+            long long p50 = histogram_percentile(&histograms[c], 50.0);
+            long long p99 = histogram_percentile(&histograms[c], 99.0);
+
+            printf("%d,%d,%.0f,%lld,%lld,%lld\n", active_cores, cores[c], switches_per_second[c], p50, p99,
+                   histograms[c].max);
+
+            if (overhead_profile_path != NULL) {
+                char label[32];
+                snprintf(label, sizeof(label), "yield_scaling_%d_cores", active_cores);
+                overhead_profile_add(&overhead_profile, OVERHEAD_PREEMPTION, cores[c], -1, 0, label, &histograms[c]);
+            }
+
+            total_switches_per_second[active_cores - 1] += switches_per_second[c];
+            if (p50 > worst_p50[active_cores - 1])
+                worst_p50[active_cores - 1] = p50;
+            if (p99 > worst_p99[active_cores - 1])
+                worst_p99[active_cores - 1] = p99;
         }
+    }
 
-        // Set scheduler policy and priority of pthread
-        if (pthread_attr_setschedpolicy(&(attr[i]), SCHED_FIFO)) {
-            perror("pthread setschedpolicy failed");
+    printf("\nactive_cores,total_switches_per_second,switches_per_second_per_core,worst_p50_ns,worst_p99_ns\n");
+    for (int active_cores = 1; active_cores <= number_of_cores; ++active_cores) {
+        printf("%d,%.0f,%.0f,%lld,%lld\n", active_cores, total_switches_per_second[active_cores - 1],
+               total_switches_per_second[active_cores - 1] / active_cores, worst_p50[active_cores - 1],
+               worst_p99[active_cores - 1]);
+    }
+
+    free(total_switches_per_second);
+    free(worst_p50);
+    free(worst_p99);
+    free(switches_per_second);
+    free(histograms);
+}
+
+int parse_cpu_list(const char *argument, int *cores) {
+    /***
+     * Get the cores of a list like 0-3,6 in the given order. Return the number of cores
+     */
+
+    int number_of_cores = 0;
+    const char *position = argument;
+
+    while (*position && number_of_cores < CPU_SETSIZE) {
+        char *end;
+        long first = strtol(position, &end, 0), last = first;
+        if (end == position) {
+            fprintf(stderr, "invalid core list %s\n", argument);
             exit(-1);
         }
-        param[i].sched_priority = sched_get_priority_max(SCHED_FIFO);
 
-        if (pthread_attr_setschedparam(&(attr[i]), &(param[i]))) {
-            perror("pthread setschedparam failed");
-            exit(-1);
+        if (*end == '-') {
+            position = end + 1;
+            last = strtol(position, &end, 0);
         }
 
-        // Use scheduling parameters of attr
-        if (pthread_attr_setinheritsched(&(attr[i]), PTHREAD_EXPLICIT_SCHED)) {
-            perror("pthread setinheritsched failed");
-            exit(-1);
+        for (long core = first; core <= last && number_of_cores < CPU_SETSIZE; ++core)
+            cores[number_of_cores++] = (int) core;
+
+        if (*end != ',')
+            break;
+        position = end + 1;
+    }
+
+    return number_of_cores;
+}
+
+void run_preemption_test(const char *output_path) {
+    /***
+     * Run the experiments of the default mode, the raw samples are written to output_path if it isn't NULL
+     */
+
+    histogram_init(&preemption_cost_histogram);
+    histogram_init(&clean_preemption_cost_histogram);
+    perf_attribution_init(&preemption_attribution);
+    bad_experiments = 0;
+    contaminated_experiments = 0;
+    number_of_traced_experiments = 0;
+    if (result_file_path != NULL)
+        result_series_reset(&preemption_series);
+    measures_finished = false;
+    for (int i = 0; i < 2; ++i)
+        sample_rings[i]->dropped = 0;
+
+    pthread_t drainer = start_drainer(output_path);
+    run_threads(thread_execution);
+
+    measures_finished = true;
+    pthread_join(drainer, NULL);
+}
+
+void decompose_traced_experiments(void) {
+    /***
+     * Split each traced experiment with the tracepoints of the tested core:
+     * - entry: from the timestamp of the first thread to the entry of its sched_yield
+     * - pick: from the entry of sched_yield to the sched_switch to the second thread (do_sched_yield and the pick
+     *   of the next task)
+     * - switch: from the sched_switch to the first syscall exit of the second thread (the context switch itself and
+     *   the end of the futex wait of its barrier)
+     * - return: from the syscall exit to the timestamp of the second thread
+     * The experiments hit by interrupts are counted apart
+     */
+
+    histogram_init(&trace_entry_histogram);
+    histogram_init(&trace_pick_histogram);
+    histogram_init(&trace_switch_histogram);
+    histogram_init(&trace_return_histogram);
+
+    for (long i = 0; i < number_of_traced_experiments; ++i) {
+        const struct traced_experiment *experiment = &(traced_experiments[i]);
+        pid_t first = thread_ids[experiment->first], second = thread_ids[1 - experiment->first];
+
+        uint64_t yield_ns = sched_trace_ticks_to_ns(&sched_trace, experiment->yield_time_measure);
+        uint64_t resume_ns = sched_trace_ticks_to_ns(&sched_trace, experiment->resume_time_measure);
+
+        uint64_t entry_ns = 0, switch_ns = 0, exit_ns = 0;
+        bool interrupted = false;
+
+        for (long j = sched_trace_find(&sched_trace, yield_ns - TRACE_MATCH_MARGIN_NANOSECONDS);
+             j < sched_trace.number_of_events &&
+             sched_trace.events[j].timestamp_ns <= resume_ns + TRACE_MATCH_MARGIN_NANOSECONDS; ++j) {
+            const struct sched_trace_event *event = &(sched_trace.events[j]);
+
+            if (sched_trace_is_interrupt(event)) {
+                interrupted = true;
+            } else if (entry_ns == 0) {
+                if (event->type == SCHED_TRACE_SYSCALL_ENTER && event->pid == first &&
+                    event->fields[0] == SYS_sched_yield)
+                    entry_ns = event->timestamp_ns;
+            } else if (switch_ns == 0) {
+                if (event->type == SCHED_TRACE_SWITCH && event->fields[0] == first && event->fields[1] == second)
+                    switch_ns = event->timestamp_ns;
+            } else if (event->type == SCHED_TRACE_SYSCALL_EXIT && event->pid == second) {
+                exit_ns = event->timestamp_ns;
+                break;
+            }
         }
 
-        // Set thread affinity
-        CPU_ZERO(&(affinity_mask[i]));
-        CPU_SET(CORE_TO_TEST, &(affinity_mask[i]));
+        if (exit_ns == 0) {
+            incomplete_traced_experiments++;
+            continue;
+        }
+        if (interrupted) {
+            interrupted_traced_experiments++;
+            continue;
+        }
+
+        histogram_record(&trace_entry_histogram, (long long) (entry_ns - yield_ns));
+        histogram_record(&trace_pick_histogram, (long long) (switch_ns - entry_ns));
+        histogram_record(&trace_switch_histogram, (long long) (exit_ns - switch_ns));
+        histogram_record(&trace_return_histogram, (long long) (resume_ns - exit_ns));
+    }
+}
+
+int parse_working_sets(const char *argument, long *footprints) {
+    /***
+     * Get the footprints from a comma separated list of sizes in bytes, or the sweep sizes if argument is "sweep"
+     * Return the number of footprints
+     */
+
+    int number_of_footprints = 0;
+
+    if (strcmp(argument, "sweep") == 0) {
+        struct cache_topology topology;
+        cache_topology_detect(CORE_TO_TEST, &topology);
+
+        long l2_cache_size_bytes = cache_topology_level_size(&topology, 2);
+        if (l2_cache_size_bytes == 0)
+            l2_cache_size_bytes = cache_topology_last_level_size(&topology);
+
+        for (long footprint = WORKING_SET_MIN_SIZE_BYTES;
+             footprint <= WORKING_SET_L2_FACTOR * l2_cache_size_bytes && number_of_footprints < MAX_WORKING_SETS;
+             footprint *= 2)
+            footprints[number_of_footprints++] = footprint;
+
+        return number_of_footprints;
+    }
+
+    const char *position = argument;
+    while (*position && number_of_footprints < MAX_WORKING_SETS) {
+        char *end;
+        long footprint = strtol(position, &end, 0);
 
-        if (pthread_attr_setaffinity_np(&(attr[i]), sizeof(cpu_set_t), &(affinity_mask[i]))) {
-            perror("pthread setaffinity failed");
+        // The kernel reads whole cache lines
+        footprint &= ~63L;
+        if (footprint <= 0) {
+            fprintf(stderr, "invalid working set size %s\n", position);
             exit(-1);
         }
+        footprints[number_of_footprints++] = footprint;
+
+        if (*end != ',')
+            break;
+        position = end + 1;
     }
 
-    for (long i = 0; i < 2; i++)
-        if (pthread_create(&threads[i], &(attr[i]), &thread_execution, (void *) i)) {
-            perror("thread creation failed");
-            exit(-1);
+    return number_of_footprints;
+}
+
+void print_usage(const char *program_name) {
+    printf("Usage: %s [-n experiments] [-d seconds] [-o file] [-H core] [-c] [-N] [-L mode:cpu[,cpu...]]\n"
+           "       [-w size[,size...]|sweep] [-S cores] [-T] [-O path_prefix] [-r file] [-i]\n"
+           "\t-n: number of experiments, 0 for no limit (%d by default)\n"
+           "\t-d: stop the run after the given number of seconds (soak runs), a progress line is printed every %d s\n"
+           "\t-o: stream the raw samples of both threads to a binary file (see common/sample_file.h)\n"
+           "\t-H: housekeeping core where the samples are drained (%d by default)\n"
+           "\t-c: read the performance counters of each thread from the start of the experiment to its resumption\n"
+           "\t    (both reads are out of the measured interval), and report\n"
+           "\t    the mean deltas of both threads by latency (they are also stored in the samples of -o)\n"
+           "\t-N: detect the platform noise: measure the gaps of a spinning loop in the tested core before the run,\n"
+           "\t    tag the experiments hit by interrupts, softirqs or SMIs and report the clean distribution too\n"
+           "\t-w: working set mode, each thread walks a working set of the given size (in bytes) before yielding and\n"
+           "\t    after being resumed. The direct switch cost, the extra time to walk the working set after the\n"
+           "\t    preemption and their sum are reported for each size. With sweep, sizes from %d bytes up to %d\n"
+           "\t    times the L2 cache are used. Each size runs the number of experiments of -n\n"
+           "\t-S: scaling mode, run a yielding pair in each of the given cores (list like 0-3,6) at the same time,\n"
+           "\t    for 1, 2... all of them, and report the cost in each core and the aggregated context switches per\n"
+           "\t    second (%d ms per step). The -w, -c, -N, -T, -o and -r options can't be used in this mode\n"
+           "\t-T: trace the scheduler, syscall and irq tracepoints of the tested core (tracefs, raw buffer) and split\n"
+           "\t    the preemption in entry, pick, switch and return (only the first %d experiments)\n"
+           "\t-O: write the overhead profile (preemption cost, reload penalty by footprint with -w, or cost of each core\n"
+           "\t    in each step with -S) with the metadata of the host to path_prefix.json and path_prefix.bin\n"
+           "\t-r: write the raw preemption costs and the configuration of the run to a result file (see\n"
+           "\t    common/result_file.h), to compare runs with compare_results. It can't be used with -w or -S\n"
+           "\t-i: apply a low noise setup to the tested cores during the run (IRQs, frequency, C-states, RT\n"
+           "\t    throttling and THP, see common/preflight.h), it needs root and the settings are restored at exit\n",
+           program_name, NUMBER_OF_EXPERIMENTS, PROGRESS_INTERVAL_SECONDS, HOUSEKEEPING_CORE,
+           WORKING_SET_MIN_SIZE_BYTES, WORKING_SET_L2_FACTOR, SCALING_STEP_MILLISECONDS, TRACE_MAX_EXPERIMENTS);
+    printf("%s\t    It can't be used with -w or -S\n", interference_usage);
+}
+
+int main(int argc, char *argv[]) {
+    long footprints[MAX_WORKING_SETS];
+    int number_of_footprints = 0;
+    static int scaling_cores[CPU_SETSIZE];
+    int number_of_scaling_cores = 0;
+
+    int option;
+    while ((option = getopt(argc, argv, "n:d:o:H:cNL:w:S:TO:r:ih")) != -1) {
+        switch (option) {
+            case 'n':
+                number_of_experiments = strtol(optarg, NULL, 0);
+                break;
+            case 'd':
+                test_duration_seconds = strtol(optarg, NULL, 0);
+                break;
+            case 'o':
+                sample_file_path = optarg;
+                break;
+            case 'H':
+                housekeeping_core = (int) strtol(optarg, NULL, 0);
+                break;
+            case 'c':
+                use_perf_counters = true;
+                break;
+            case 'N':
+                detect_noise = true;
+                break;
+            case 'L':
+                if (!interference_add(&interference, optarg)) {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            case 'w':
+                number_of_footprints = parse_working_sets(optarg, footprints);
+                break;
+            case 'S':
+                number_of_scaling_cores = parse_cpu_list(optarg, scaling_cores);
+                break;
+            case 'T':
+                trace_scheduler = true;
+                break;
+            case 'O':
+                overhead_profile_path = optarg;
+                break;
+            case 'r':
+                result_file_path = optarg;
+                break;
+            case 'i':
+                low_noise_setup = true;
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(option == 'h' ? 0 : -1);
         }
+    }
 
-    for (int i = 0; i < 2; i++)
-        pthread_join(threads[i], NULL);
+    if (number_of_experiments == 0 && test_duration_seconds == 0) {
+        fprintf(stderr, "a run without limit of experiments needs a duration\n");
+        exit(-1);
+    }
 
-    // Unlock pages
-    if (munlockall()) {
-        perror("munlockall failed");
+    if (number_of_experiments == 0 && number_of_footprints) {
+        fprintf(stderr, "the working set mode needs a number of experiments per working set\n");
         exit(-1);
     }
 
-    long long preemption_cost_nanoseconds[NUMBER_OF_EXPERIMENTS];
+    // The scaling mode runs the pairs of the measurement library, without the instrumentation of the default mode
+    if (number_of_scaling_cores && (number_of_footprints || use_perf_counters || detect_noise || trace_scheduler ||
+                                    sample_file_path != NULL || result_file_path != NULL)) {
+        fprintf(stderr, "the -w, -c, -N, -T, -o and -r options can't be used in the scaling mode\n");
+        exit(-1);
+    }
+
+    // Only the default mode records the raw costs
+    if (result_file_path != NULL && number_of_footprints) {
+        fprintf(stderr, "the -r option can't be used in the working set mode\n");
+        exit(-1);
+    }
 
-    for (int i = 0; i < NUMBER_OF_EXPERIMENTS; ++i) {
-        // Calculate differences
-        struct timespec result;
+    // Only the default mode measures the cost idle and then under interference
+    if (interference.number_of_threads && (number_of_footprints || number_of_scaling_cores)) {
+        fprintf(stderr, "the -L option can't be used in the working set and scaling modes\n");
+        exit(-1);
+    }
 
-        // Preemption time difference
-        timespec_subtract(&result, &(time_measures[0][i]), &(time_measures[1][i]));
+    // Initialize barriers
+    if (pthread_barrier_init(&start_barrier, NULL, 2))
+        perror("thread barrier initialization failed");
 
-        // Local preemption cost
-        preemption_cost_nanoseconds[i] = result.tv_sec * 1000000000L + result.tv_nsec;
+    if (pthread_barrier_init(&end_barrier, NULL, 2))
+        perror("thread barrier initialization failed");
 
-        // Check the correction of the test
-        if (!timespec_subtract(&result, &(time_measures[0][i]), &(debug_time_measures[1][i])) ||
-            !timespec_subtract(&result, &(time_measures[1][i]), &(debug_time_measures[0][i]))) {
-            perror("bad behaviour of the test\n");
+    if (pthread_barrier_init(&collect_barrier, NULL, 2))
+        perror("thread barrier initialization failed");
 
-            printf("Test with error %d\n", i);
+    // Select and calibrate the timer
+    timer_init();
 
-            // Print stack trace
-            printf("Preemption points:\n\tThread 1:\n");
-            for (int j = 0; j < NUMBER_OF_EXPERIMENTS; ++j) {
-                printf("\t\tPoint %d: %ld s and %ld ns\n", j, time_measures[0][j].tv_sec,
-                       time_measures[0][j].tv_nsec);
-            }
+    // Check the settings of the tested cores (the cores of the scaling mode, or the core to test)
+    cpu_set_t preflight_cpus;
+    CPU_ZERO(&preflight_cpus);
+    for (int i = 0; i < number_of_scaling_cores; ++i)
+        CPU_SET(scaling_cores[i], &preflight_cpus);
+    if (!number_of_scaling_cores)
+        CPU_SET(CORE_TO_TEST, &preflight_cpus);
 
-            printf("Preemption points:\n\tThread 2:\n");
-            for (int j = 0; j < NUMBER_OF_EXPERIMENTS; ++j) {
-                printf("\t\tPoint %d: %ld s and %ld ns\n", j, time_measures[1][j].tv_sec,
-                       time_measures[1][j].tv_nsec);
-            }
+    preflight_check(&preflight_cpus, &preflight_report);
+    if (low_noise_setup)
+        preflight_apply(&preflight_cpus);
 
-            printf("Debug points:\n\tThread 1:\n");
-            for (int j = 0; j < NUMBER_OF_EXPERIMENTS; ++j) {
-                printf("\t\tPoint %d: %ld s and %ld ns\n", j, debug_time_measures[0][j].tv_sec,
-                       debug_time_measures[0][j].tv_nsec);
-            }
+    if (overhead_profile_path != NULL) {
+        overhead_profile_init(&overhead_profile, "preemption_cost",
+                              number_of_scaling_cores ? scaling_cores[0] : CORE_TO_TEST);
+        if (number_of_scaling_cores)
+            overhead_profile_add_config(&overhead_profile, "scaling_step_ms", "%d", SCALING_STEP_MILLISECONDS);
+        else
+            overhead_profile_add_config(&overhead_profile, "experiments", "%ld", number_of_experiments);
+        overhead_profile_add_config(&overhead_profile, "antagonists", "%d", interference.number_of_threads);
+    }
 
-            printf("Debug points:\n\tThread 2:\n");
-            for (int j = 0; j < NUMBER_OF_EXPERIMENTS; ++j) {
-                printf("\t\tPoint %d: %ld s and %ld ns\n", j, debug_time_measures[1][j].tv_sec,
-                       debug_time_measures[1][j].tv_nsec);
-            }
+    // Allocate the working sets before locking the memory
+    long max_footprint = 0;
+    for (int i = 0; i < number_of_footprints; ++i) {
+        if (footprints[i] > max_footprint)
+            max_footprint = footprints[i];
+    }
 
+    for (int i = 0; i < 2 && number_of_footprints; ++i) {
+        working_sets[i] = mmap(NULL, max_footprint, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (working_sets[i] == MAP_FAILED) {
+            perror("mmap failed");
             exit(-1);
         }
+        memset(working_sets[i], 1, max_footprint);
     }
 
-    // Analyze result
-    long long min_preemption_cost_nanoseconds, max_preemption_cost_nanoseconds, avg_preemption_cost_nanoseconds;
+    // Allocate the rings of samples, the raw costs and the timestamps of the traced experiments before locking the
+    // memory
+    for (int i = 0; i < 2; ++i)
+        sample_rings[i] = sample_ring_create();
 
-    // Max calculation
-    max_preemption_cost_nanoseconds = 0;
-    for (int i = 0; i < NUMBER_OF_EXPERIMENTS; ++i) {
-        if (max_preemption_cost_nanoseconds < preemption_cost_nanoseconds[i])
-            max_preemption_cost_nanoseconds = preemption_cost_nanoseconds[i];
+    if (result_file_path != NULL)
+        result_series_init(&preemption_series, "preemption",
+                           number_of_experiments ? number_of_experiments : RESULT_SERIES_DEFAULT_CAPACITY);
+
+    if (trace_scheduler) {
+        traced_experiments = malloc(TRACE_MAX_EXPERIMENTS * sizeof(struct traced_experiment));
+        if (traced_experiments == NULL) {
+            perror("malloc failed");
+            exit(-1);
+        }
     }
 
-    // Min calculation
-    min_preemption_cost_nanoseconds = max_preemption_cost_nanoseconds;
-    for (int i = 0; i < NUMBER_OF_EXPERIMENTS; ++i) {
-        if (min_preemption_cost_nanoseconds > preemption_cost_nanoseconds[i])
-            min_preemption_cost_nanoseconds = preemption_cost_nanoseconds[i];
+    struct hwlat_result hwlat_result;
+    if (detect_noise) {
+        cpu_set_t tested_cpus;
+        CPU_ZERO(&tested_cpus);
+        CPU_SET(CORE_TO_TEST, &tested_cpus);
+        noise_detector_init(&noise_detector, &tested_cpus);
     }
 
-    // Avg calculation (Warning: If NUMBER_OF_EXPERIMENTS or the preemption cost is very high, there can be an integer
-    // overflow in the variable avg_preemption_cost_nanoseconds)
-    avg_preemption_cost_nanoseconds = 0;
-    for (int i = 0; i < NUMBER_OF_EXPERIMENTS; ++i) {
-        avg_preemption_cost_nanoseconds += preemption_cost_nanoseconds[i];
+    // Lock memory
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        perror("mlockall failed");
+    }
+
+    timer_print_info();
+
+    if (detect_noise) {
+        noise_hwlat_run(CORE_TO_TEST, &hwlat_result);
+        noise_hwlat_print(&hwlat_result);
+    }
+
+    // Start sampling with the frequency of the tested cores stable
+    preflight_warm_up(&preflight_cpus);
+
+    if (number_of_scaling_cores) {
+        measure_scaling(scaling_cores, number_of_scaling_cores);
+    } else if (number_of_footprints) {
+        printf("Working set result: \n\t%s: %ld\n", "Number of experiments per working set", number_of_experiments);
+        printf("footprint_bytes,switch_p50_ns,switch_p99_ns,reload_penalty_p50_ns,reload_penalty_p99_ns,"
+               "total_p50_ns,total_p99_ns\n");
+        bad_experiments = 0;
+
+        for (int f = 0; f < number_of_footprints; ++f) {
+            working_set_length = footprints[f] / (long) sizeof(int64_t);
+            histogram_init(&switch_cost_histogram);
+            histogram_init(&reload_penalty_histogram);
+            histogram_init(&total_cost_histogram);
+
+            run_threads(working_set_thread_execution);
+
+            printf("%ld,%lld,%lld,%lld,%lld,%lld,%lld\n", footprints[f],
+                   histogram_percentile(&switch_cost_histogram, 50.0),
+                   histogram_percentile(&switch_cost_histogram, 99.0),
+                   histogram_percentile(&reload_penalty_histogram, 50.0),
+                   histogram_percentile(&reload_penalty_histogram, 99.0),
+                   histogram_percentile(&total_cost_histogram, 50.0),
+                   histogram_percentile(&total_cost_histogram, 99.0));
+
+            if (overhead_profile_path != NULL)
+                overhead_profile_add(&overhead_profile, OVERHEAD_CACHE_REFILL, CORE_TO_TEST, -1, footprints[f],
+                                     "reload_penalty", &reload_penalty_histogram);
+        }
+
+        if (bad_experiments)
+            print_bad_experiments("Yield point", "Resume point");
+    } else {
+        // With antagonists, the run is repeated under interference after the idle one
+        if (interference.number_of_threads) {
+            run_preemption_test(NULL);
+            idle_preemption_cost_histogram = preemption_cost_histogram;
+
+            interference_start(&interference);
+        }
+
+        // Only the last run is traced
+        if (trace_scheduler)
+            sched_trace_start(&sched_trace, CORE_TO_TEST);
+
+        run_preemption_test(sample_file_path);
+
+        if (trace_scheduler)
+            sched_trace_stop(&sched_trace);
+        if (interference.number_of_threads)
+            interference_stop(&interference);
+    }
+
+    // Unlock pages
+    if (munlockall()) {
+        perror("munlockall failed");
+        exit(-1);
     }
-    avg_preemption_cost_nanoseconds = avg_preemption_cost_nanoseconds / NUMBER_OF_EXPERIMENTS;
 
     // Print result
-    printf("Experiment result: \n\t%s: %d\n\t%s: %lld ns\n\t%s: %lld ns\n\t%s: %lld ns\n",
-           "Number of experiments", NUMBER_OF_EXPERIMENTS,
-           "Minimum cost of preemption", min_preemption_cost_nanoseconds,
-           "Maximum cost of preemption", max_preemption_cost_nanoseconds,
-           "Average cost of preemption", avg_preemption_cost_nanoseconds);
+    if (!number_of_footprints && !number_of_scaling_cores) {
+        histogram_print(&preemption_cost_histogram, "preemption");
+        printf("\t%s: %llu\n", "Number of dropped samples",
+               (unsigned long long) (sample_rings[0]->dropped + sample_rings[1]->dropped));
+
+        if (detect_noise) {
+            printf("\t%s: %ld\n", "Number of experiments hit by interrupts, softirqs or SMIs",
+                   contaminated_experiments);
+            histogram_print(&clean_preemption_cost_histogram, "preemption without noise");
+            noise_detector_close(&noise_detector);
+        }
+
+        if (trace_scheduler) {
+            decompose_traced_experiments();
+            sched_trace_print_info(&sched_trace);
+            printf("\t%s: %ld\n\t%s: %ld\n\t%s: %ld\n", "Number of traced experiments", number_of_traced_experiments,
+                   "Number of experiments hit by interrupts", interrupted_traced_experiments,
+                   "Number of experiments without all their tracepoints", incomplete_traced_experiments);
+            histogram_print(&trace_entry_histogram, "entry (timestamp to sched_yield entry)");
+            histogram_print(&trace_pick_histogram, "pick (sched_yield entry to sched_switch)");
+            histogram_print(&trace_switch_histogram, "switch (sched_switch to syscall exit of the next thread)");
+            histogram_print(&trace_return_histogram, "return (syscall exit to timestamp of the next thread)");
+            sched_trace_destroy(&sched_trace);
+            free(traced_experiments);
+        }
+
+        if (use_perf_counters) {
+            perf_counters_print_info(&(perf_counters[0]));
+            perf_attribution_print(&preemption_attribution, &(perf_counters[0]), "preemption");
+            for (int i = 0; i < 2; ++i)
+                perf_counters_close(&(perf_counters[i]));
+        }
+
+        if (bad_experiments)
+            print_bad_experiments("Preemption point", "Debug point");
+
+        if (interference.number_of_threads) {
+            interference_print(&interference);
+            interference_print_comparison("preemption", &idle_preemption_cost_histogram, &preemption_cost_histogram);
+        }
+    }
+
+    if (overhead_profile_path != NULL) {
+        if (!number_of_footprints && !number_of_scaling_cores) {
+            overhead_profile_add(&overhead_profile, OVERHEAD_PREEMPTION, CORE_TO_TEST, -1, 0, "yield",
+                                 &preemption_cost_histogram);
+            if (detect_noise)
+                overhead_profile_add(&overhead_profile, OVERHEAD_PREEMPTION, CORE_TO_TEST, -1, 0,
+                                     "yield_without_noise", &clean_preemption_cost_histogram);
+        }
+        overhead_profile_write(&overhead_profile, overhead_profile_path);
+        overhead_profile_free(&overhead_profile);
+    }
+
+    if (result_file_path != NULL) {
+        char antagonists[RESULT_FILE_CONFIG_VALUE_BYTES];
+        interference_describe(&interference, antagonists, sizeof(antagonists));
+
+        struct result_config result_config = {0};
+        result_config_add(&result_config, "mode", "yield");
+        result_config_add(&result_config, "core", "%d", CORE_TO_TEST);
+        result_config_add(&result_config, "experiments", "%ld", number_of_experiments);
+        result_config_add(&result_config, "duration_s", "%ld", test_duration_seconds);
+        result_config_add(&result_config, "antagonists", "%s", antagonists);
+        result_config_add(&result_config, "perf_counters", "%d", use_perf_counters);
+        result_config_add(&result_config, "low_noise_setup", "%d", low_noise_setup);
+
+        result_file_write(result_file_path, "preemption_cost", &result_config, &preemption_series, 1);
+        result_series_destroy(&preemption_series);
+    }
+
+    for (int i = 0; i < 2; ++i)
+        sample_ring_destroy(sample_rings[i]);
 
     return 0;
 }
@@ -0,0 +1,388 @@
+//
+// This program compares the cost of a context switch between two threads of the same process with the cost of a
+// context switch between two processes in a Unix platform
+//
+// Two SCHED_FIFO participants in the same core hand the CPU to each other through a futex in shared memory. They are
+// two threads (same address space) or two forked processes (the switch also changes the address space, and with it
+// the ASID or the TLB contents). Each participant can touch its own private pages after being resumed, to see how the
+// cost grows with its footprint. The page refill penalty of each type includes the refill of the data cache lines of
+// the pages as well as of their translations, only the difference between the process and the thread switch
+// (process-thread) isolates the part of the address space switch (TLB).
+//
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "../common/statistics.h"
+#include "../common/timer.h"
+#include "../common/preflight.h"
+
+// Define variables
+#define NUMBER_OF_EXPERIMENTS 1000
+#define CORE_TO_TEST 3
+
+// Maximum number of footprints of the -p option
+#define MAX_FOOTPRINTS 64
+
+enum participant_type {
+    PARTICIPANT_THREAD,
+    PARTICIPANT_PROCESS
+};
+
+// Results of each participant, written only by it
+struct participant_result {
+    // Time from the handover of the other participant to the resumption of this one
+    struct histogram switch_cost_histogram;
+
+    // Extra time to touch the private pages after being resumed, compared with touching them again (data cache and TLB
+    // refill, the other participant evicts both)
+    struct histogram page_refill_penalty_histogram;
+} __attribute__((aligned(64)));
+
+// Memory shared by both participants (also between processes)
+struct shared_state {
+    // Participant that owns the CPU, the other one waits in the futex
+    uint32_t turn __attribute__((aligned(64)));
+
+    // Time when the last handover started
+    uint64_t handover_time_measure;
+
+    pthread_barrier_t start_barrier;
+
+    struct participant_result results[2];
+};
+
+// Options of the test
+static long number_of_experiments = NUMBER_OF_EXPERIMENTS;
+static long number_of_pages = 0;
+
+static struct shared_state *shared_state;
+
+static void futex_wait(uint32_t *word, uint32_t value) {
+    // Shared futex, so it works between processes
+    syscall(SYS_futex, word, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+static void futex_wake(uint32_t *word) {
+    syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static long long touch_pages(volatile char *pages, long page_size) {
+    /***
+     * Write one byte of each private page and get the time needed
+     */
+
+    uint64_t time_measure_before = timer_read();
+    for (long p = 0; p < number_of_pages; ++p)
+        pages[p * page_size]++;
+    uint64_t time_measure_after = timer_read();
+
+    return timer_interval_ns(time_measure_before, time_measure_after);
+}
+
+void participant_execution(long id) {
+    /***
+     * Wait for the turn of this participant, record the switch cost and the page refill penalty and hand the
+     * CPU to the other participant, number_of_experiments times
+     */
+
+    uint32_t other = 1 - (uint32_t) id;
+    struct participant_result *result = &(shared_state->results[id]);
+
+    // Private pages of the participant (of its own process in the process mode)
+    long page_size = sysconf(_SC_PAGESIZE);
+    char *pages = NULL;
+    if (number_of_pages) {
+        pages = mmap(NULL, number_of_pages * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pages == MAP_FAILED) {
+            perror("mmap failed");
+            exit(-1);
+        }
+        memset(pages, 1, number_of_pages * page_size);
+    }
+
+    pthread_barrier_wait(&(shared_state->start_barrier));
+
+    // The first participant starts the ping-pong
+    if (id == 0) {
+        shared_state->handover_time_measure = timer_read();
+        __atomic_store_n(&(shared_state->turn), other, __ATOMIC_RELEASE);
+        futex_wake(&(shared_state->turn));
+    }
+
+    for (long i = 0; i < number_of_experiments; ++i) {
+        // Wait until the other participant hands over the CPU
+        while (__atomic_load_n(&(shared_state->turn), __ATOMIC_ACQUIRE) != (uint32_t) id)
+            futex_wait(&(shared_state->turn), other);
+
+        uint64_t resume_time_measure = timer_read();
+        histogram_record(&(result->switch_cost_histogram),
+                         timer_interval_ns(shared_state->handover_time_measure, resume_time_measure));
+
+        // Touch the pages after the switch and again while their lines and translations are cached
+        if (number_of_pages) {
+            long long refill_time = touch_pages(pages, page_size);
+            long long warm_time = touch_pages(pages, page_size);
+            histogram_record(&(result->page_refill_penalty_histogram), refill_time - warm_time);
+        }
+
+        // Hand over the CPU, the other participant runs when this one blocks in the futex
+        shared_state->handover_time_measure = timer_read();
+        __atomic_store_n(&(shared_state->turn), other, __ATOMIC_RELEASE);
+        futex_wake(&(shared_state->turn));
+    }
+
+    if (pages != NULL)
+        munmap(pages, number_of_pages * page_size);
+}
+
+void *participant_thread_execution(void *data) {
+    participant_execution((long) data);
+    return NULL;
+}
+
+void set_test_scheduling(void) {
+    /***
+     * Move the calling process to CORE_TO_TEST with the max SCHED_FIFO priority and lock its memory
+     */
+
+    cpu_set_t mask_cpu;
+    CPU_ZERO(&mask_cpu);
+    CPU_SET(CORE_TO_TEST, &mask_cpu);
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &mask_cpu)) {
+        perror("setaffinity failed");
+        exit(-1);
+    }
+
+    struct sched_param my_sched;
+    my_sched.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    if (sched_setscheduler(0, SCHED_FIFO, &my_sched)) {
+        perror("setscheduler failed");
+        exit(-1);
+    }
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        perror("mlockall failed");
+        exit(-1);
+    }
+}
+
+void run_participants(enum participant_type type) {
+    /***
+     * Run both participants as threads or as processes in CORE_TO_TEST
+     */
+
+    memset(shared_state, 0, sizeof(struct shared_state));
+    for (int i = 0; i < 2; ++i) {
+        histogram_init(&(shared_state->results[i].switch_cost_histogram));
+        histogram_init(&(shared_state->results[i].page_refill_penalty_histogram));
+    }
+
+    pthread_barrierattr_t barrier_attr;
+    pthread_barrierattr_init(&barrier_attr);
+    pthread_barrierattr_setpshared(&barrier_attr, PTHREAD_PROCESS_SHARED);
+    if (pthread_barrier_init(&(shared_state->start_barrier), &barrier_attr, 2))
+        perror("thread barrier initialization failed");
+
+    // The forked participants must not print the pending output of the parent again when they exit
+    fflush(stdout);
+
+    if (type == PARTICIPANT_THREAD) {
+        // Both threads inherit the scheduling of a child process, so the parent keeps its own one
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork failed");
+            exit(-1);
+        }
+
+        if (pid == 0) {
+            set_test_scheduling();
+
+            pthread_t threads[2];
+            for (long i = 0; i < 2; ++i) {
+                if (pthread_create(&threads[i], NULL, participant_thread_execution, (void *) i)) {
+                    perror("thread creation failed");
+                    exit(-1);
+                }
+            }
+            for (int i = 0; i < 2; ++i)
+                pthread_join(threads[i], NULL);
+
+            exit(0);
+        }
+
+        waitpid(pid, NULL, 0);
+    } else {
+        pid_t pids[2];
+        for (long i = 0; i < 2; ++i) {
+            pids[i] = fork();
+            if (pids[i] < 0) {
+                perror("fork failed");
+                exit(-1);
+            }
+
+            if (pids[i] == 0) {
+                set_test_scheduling();
+                participant_execution(i);
+                exit(0);
+            }
+        }
+
+        for (int i = 0; i < 2; ++i)
+            waitpid(pids[i], NULL, 0);
+    }
+
+    pthread_barrier_destroy(&(shared_state->start_barrier));
+}
+
+int parse_footprints(const char *argument, long *footprints) {
+    /***
+     * Get the numbers of pages from a comma separated list. Return the number of footprints
+     */
+
+    int number_of_footprints = 0;
+    const char *position = argument;
+
+    while (*position && number_of_footprints < MAX_FOOTPRINTS) {
+        char *end;
+        long footprint = strtol(position, &end, 0);
+        if (end == position || footprint < 0) {
+            fprintf(stderr, "invalid number of pages %s\n", position);
+            exit(-1);
+        }
+        footprints[number_of_footprints++] = footprint;
+
+        if (*end != ',')
+            break;
+        position = end + 1;
+    }
+
+    return number_of_footprints;
+}
+
+void print_usage(const char *program_name) {
+    printf("Usage: %s [-m thread|process|both] [-n experiments] [-p pages[,pages...]] [-i]\n"
+           "\t-m: run the participants as threads, as processes or both (by default) to report the extra cost of\n"
+           "\t    switching the address space\n"
+           "\t-n: number of switches of each participant (%d by default)\n"
+           "\t-p: number of private pages that each participant touches after being resumed (0 by default), the page\n"
+           "\t    refill penalty includes the data cache refill, only process-thread isolates the TLB part\n"
+           "\t-i: apply a low noise setup to the tested core during the run (IRQs, frequency, C-states, RT\n"
+           "\t    throttling and THP, see common/preflight.h), it needs root and the settings are restored at exit\n",
+           program_name, NUMBER_OF_EXPERIMENTS);
+}
+
+int main(int argc, char *argv[]) {
+    bool run_type[2] = {true, true};
+    long footprints[MAX_FOOTPRINTS] = {0};
+    int number_of_footprints = 1;
+    bool low_noise_setup = false;
+    static struct preflight_report preflight_report;
+
+    int option;
+    while ((option = getopt(argc, argv, "m:n:p:ih")) != -1) {
+        switch (option) {
+            case 'm':
+                run_type[PARTICIPANT_THREAD] = strcmp(optarg, "thread") == 0 || strcmp(optarg, "both") == 0;
+                run_type[PARTICIPANT_PROCESS] = strcmp(optarg, "process") == 0 || strcmp(optarg, "both") == 0;
+                if (!run_type[PARTICIPANT_THREAD] && !run_type[PARTICIPANT_PROCESS]) {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            case 'n':
+                number_of_experiments = strtol(optarg, NULL, 0);
+                break;
+            case 'i':
+                low_noise_setup = true;
+                break;
+            case 'p':
+                number_of_footprints = parse_footprints(optarg, footprints);
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(option == 'h' ? 0 : -1);
+        }
+    }
+
+    // Select and calibrate the timer, the forked participants inherit the calibration
+    timer_init();
+
+    shared_state = mmap(NULL, sizeof(struct shared_state), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared_state == MAP_FAILED) {
+        perror("mmap failed");
+        exit(-1);
+    }
+
+    static const char *type_names[2] = {"thread", "process"};
+    static struct histogram switch_cost_histogram, page_refill_penalty_histogram;
+    long long switch_p50[2], total_p50[2];
+
+    // Check the settings of the core to test, the forked participants don't restore the low noise setup
+    cpu_set_t tested_cpus;
+    CPU_ZERO(&tested_cpus);
+    CPU_SET(CORE_TO_TEST, &tested_cpus);
+    preflight_check(&tested_cpus, &preflight_report);
+    if (low_noise_setup)
+        preflight_apply(&tested_cpus);
+
+    timer_print_info();
+
+    // Start sampling with the frequency of the core to test stable
+    preflight_warm_up(&tested_cpus);
+
+    printf("Process switch result: \n\t%s: %ld\n\t%s: %d\n", "Number of switches per participant",
+           number_of_experiments, "Core", CORE_TO_TEST);
+    printf("pages,type,switch_p50_ns,switch_p99_ns,page_refill_penalty_p50_ns,page_refill_penalty_p99_ns,"
+           "total_p50_ns\n");
+
+    for (int f = 0; f < number_of_footprints; ++f) {
+        number_of_pages = footprints[f];
+
+        for (int type = PARTICIPANT_THREAD; type <= PARTICIPANT_PROCESS; ++type) {
+            if (!run_type[type])
+                continue;
+
+            run_participants(type);
+
+            histogram_init(&switch_cost_histogram);
+            histogram_init(&page_refill_penalty_histogram);
+            for (int i = 0; i < 2; ++i) {
+                histogram_merge(&switch_cost_histogram, &(shared_state->results[i].switch_cost_histogram));
+                histogram_merge(&page_refill_penalty_histogram,
+                                &(shared_state->results[i].page_refill_penalty_histogram));
+            }
+
+            switch_p50[type] = histogram_percentile(&switch_cost_histogram, 50.0);
+            total_p50[type] = switch_p50[type] + histogram_percentile(&page_refill_penalty_histogram, 50.0);
+
+            printf("%ld,%s,%lld,%lld,%lld,%lld,%lld\n", number_of_pages, type_names[type], switch_p50[type],
+                   histogram_percentile(&switch_cost_histogram, 99.0),
+                   histogram_percentile(&page_refill_penalty_histogram, 50.0),
+                   histogram_percentile(&page_refill_penalty_histogram, 99.0), total_p50[type]);
+        }
+
+        // Extra cost of switching the address space, the data cache refill is in both types and cancels out
+        if (run_type[PARTICIPANT_THREAD] && run_type[PARTICIPANT_PROCESS]) {
+            printf("%ld,process-thread,%lld,,,,%lld\n", number_of_pages,
+                   switch_p50[PARTICIPANT_PROCESS] - switch_p50[PARTICIPANT_THREAD],
+                   total_p50[PARTICIPANT_PROCESS] - total_p50[PARTICIPANT_THREAD]);
+        }
+    }
+
+    munmap(shared_state, sizeof(struct shared_state));
+
+    return 0;
+}
@@ -0,0 +1,315 @@
+//
+// This program calculate the cost of an involuntary preemption in a Unix platform: a low priority thread that is
+// running is preempted by a high priority thread woken by a timer in the same core
+//
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../common/statistics.h"
+#include "../common/timer.h"
+#include "../common/preflight.h"
+
+// Define variables
+#define NUMBER_OF_EXPERIMENTS 1000
+#define CORE_TO_TEST 3
+
+// Time between two consecutive timer expirations
+#define TIMER_PERIOD_NANOSECONDS 1000000L
+
+// The low priority thread considers it has been preempted if two consecutive timestamps are separated more than this
+#define PREEMPTION_GAP_NANOSECONDS 500
+
+enum wake_up_method {
+    WAKE_UP_CLOCK_NANOSLEEP,
+    WAKE_UP_TIMERFD
+};
+
+// Options of the test
+static enum wake_up_method wake_up_method = WAKE_UP_CLOCK_NANOSLEEP;
+static long number_of_experiments = NUMBER_OF_EXPERIMENTS;
+static long timer_period_nanoseconds = TIMER_PERIOD_NANOSECONDS;
+
+// Data shared between both threads, each one written by a single thread and in its own cache line
+static volatile uint64_t spinner_timestamp __attribute__((aligned(64)));
+static volatile uint64_t sleep_timestamp __attribute__((aligned(64)));
+static volatile long published_experiment __attribute__((aligned(64)));
+static volatile bool test_finished __attribute__((aligned(64)));
+
+// Barrier used to start the high priority thread once the low priority one is spinning
+static pthread_barrier_t start_barrier;
+
+// Histograms where the results will be stored
+struct histogram wake_up_latency_histogram, preemption_latency_histogram, switch_back_histogram;
+
+void *spinner_thread_execution(void *data) {
+    /***
+     * Low priority thread, it takes timestamps continuously. When it detects that it has been preempted it records
+     * the time since the high priority thread went to sleep
+     */
+
+    (void) data;
+
+    long gap_threshold_ticks = (long) (PREEMPTION_GAP_NANOSECONDS / timer_ns_per_tick);
+    long last_experiment = 0;
+    uint64_t previous_timestamp = timer_read();
+
+    pthread_barrier_wait(&start_barrier);
+
+    while (!test_finished) {
+        uint64_t timestamp = timer_read();
+
+        if ((long) (timestamp - previous_timestamp) > gap_threshold_ticks) {
+            long experiment = __atomic_load_n(&published_experiment, __ATOMIC_ACQUIRE);
+
+            // The sleep timestamp of the experiment is published before the high priority thread goes to sleep
+            if (experiment != last_experiment) {
+                histogram_record(&switch_back_histogram, timer_interval_ns(sleep_timestamp, timestamp));
+                last_experiment = experiment;
+            }
+        }
+
+        spinner_timestamp = timestamp;
+        previous_timestamp = timestamp;
+    }
+
+    return NULL;
+}
+
+void wait_until(int timer_fd, const struct timespec *expiration) {
+    /***
+     * Sleep until the absolute CLOCK_MONOTONIC time expiration
+     */
+
+    if (wake_up_method == WAKE_UP_CLOCK_NANOSLEEP) {
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, expiration, NULL));
+    } else {
+        struct itimerspec timer_value;
+        memset(&timer_value, 0, sizeof(timer_value));
+        timer_value.it_value = *expiration;
+
+        if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &timer_value, NULL)) {
+            perror("timerfd_settime failed");
+            exit(-1);
+        }
+
+        uint64_t expirations;
+        if (read(timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+            perror("timerfd read failed");
+            exit(-1);
+        }
+    }
+}
+
+void *timer_thread_execution(void *data) {
+    /***
+     * High priority thread, it is woken periodically by a timer and preempts the low priority thread
+     */
+
+    (void) data;
+
+    int timer_fd = -1;
+    if (wake_up_method == WAKE_UP_TIMERFD) {
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+        if (timer_fd < 0) {
+            perror("timerfd_create failed");
+            exit(-1);
+        }
+    }
+
+    pthread_barrier_wait(&start_barrier);
+
+    struct timespec expiration;
+    clock_gettime(CLOCK_MONOTONIC, &expiration);
+
+    for (long i = 0; i < number_of_experiments; ++i) {
+        // Next expiration
+        expiration.tv_nsec += timer_period_nanoseconds;
+        while (expiration.tv_nsec >= 1000000000L) {
+            expiration.tv_nsec -= 1000000000L;
+            expiration.tv_sec++;
+        }
+
+        wait_until(timer_fd, &expiration);
+
+        // First instruction after the wake up
+        uint64_t wake_up_timestamp = timer_read();
+        struct timespec wake_up_time;
+        clock_gettime(CLOCK_MONOTONIC, &wake_up_time);
+
+        // Last timestamp of the low priority thread before being preempted
+        uint64_t preempted_timestamp = spinner_timestamp;
+
+        histogram_record(&wake_up_latency_histogram,
+                         (wake_up_time.tv_sec - expiration.tv_sec) * 1000000000LL +
+                         (wake_up_time.tv_nsec - expiration.tv_nsec));
+        histogram_record(&preemption_latency_histogram, timer_interval_ns(preempted_timestamp, wake_up_timestamp));
+
+        // Publish the time when this thread goes to sleep
+        sleep_timestamp = timer_read();
+        __atomic_store_n(&published_experiment, i + 1, __ATOMIC_RELEASE);
+    }
+
+    // Let the low priority thread record the last switch back before finishing
+    struct timespec last_switch_back = {0, timer_period_nanoseconds};
+    nanosleep(&last_switch_back, NULL);
+    test_finished = true;
+
+    if (timer_fd >= 0)
+        close(timer_fd);
+
+    return NULL;
+}
+
+void print_usage(const char *program_name) {
+    printf("Usage: %s [-m nanosleep|timerfd] [-n experiments] [-p period_us] [-i]\n"
+           "\t-m: method used to wake up the high priority thread (clock_nanosleep by default)\n"
+           "\t-n: number of experiments (%d by default)\n"
+           "\t-p: period of the timer in microseconds (%ld by default)\n"
+           "\t-i: apply a low noise setup to the tested core during the run (IRQs, frequency, C-states, RT\n"
+           "\t    throttling and THP, see common/preflight.h), it needs root and the settings are restored at exit\n",
+           program_name, NUMBER_OF_EXPERIMENTS, TIMER_PERIOD_NANOSECONDS / 1000);
+}
+
+int main(int argc, char *argv[]) {
+    bool low_noise_setup = false;
+    static struct preflight_report preflight_report;
+
+    int option;
+    while ((option = getopt(argc, argv, "m:n:p:ih")) != -1) {
+        switch (option) {
+            case 'm':
+                if (strcmp(optarg, "nanosleep") == 0) {
+                    wake_up_method = WAKE_UP_CLOCK_NANOSLEEP;
+                } else if (strcmp(optarg, "timerfd") == 0) {
+                    wake_up_method = WAKE_UP_TIMERFD;
+                } else {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            case 'n':
+                number_of_experiments = strtol(optarg, NULL, 0);
+                break;
+            case 'i':
+                low_noise_setup = true;
+                break;
+            case 'p':
+                timer_period_nanoseconds = strtol(optarg, NULL, 0) * 1000;
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(option == 'h' ? 0 : -1);
+        }
+    }
+
+    pthread_t threads[2];
+    struct sched_param param[2];
+    pthread_attr_t attr[2];
+    cpu_set_t affinity_mask[2];
+    void *(*thread_routines[2])(void *) = {spinner_thread_execution, timer_thread_execution};
+
+    // Initialize barrier
+    if (pthread_barrier_init(&start_barrier, NULL, 2))
+        perror("thread barrier initialization failed");
+
+    histogram_init(&wake_up_latency_histogram);
+    histogram_init(&preemption_latency_histogram);
+    histogram_init(&switch_back_histogram);
+
+    // Select and calibrate the timer
+    timer_init();
+
+    // Check the settings of the core to test, the RT throttling shows up as outliers
+    cpu_set_t tested_cpus;
+    CPU_ZERO(&tested_cpus);
+    CPU_SET(CORE_TO_TEST, &tested_cpus);
+    preflight_check(&tested_cpus, &preflight_report);
+    if (low_noise_setup)
+        preflight_apply(&tested_cpus);
+
+    // Lock memory
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        perror("mlockall failed");
+    }
+
+    // Start sampling with the frequency of the core to test stable
+    preflight_warm_up(&tested_cpus);
+
+    // Configure threads attributes, the spinner (0) with the min priority and the timer thread (1) with the max one
+    for (int i = 0; i < 2; ++i) {
+        // Init attrs
+        if (pthread_attr_init(&(attr[i]))) {
+            perror("pthread init failed");
+            exit(-1);
+        }
+
+        // Set a specific stack size
+        if (pthread_attr_setstacksize(&(attr[i]), PTHREAD_STACK_MIN + 0x4000)) {
+            perror("pthread setstacksize failed");
+            exit(-1);
+        }
+
+        // Set scheduler policy and priority of pthread
+        if (pthread_attr_setschedpolicy(&(attr[i]), SCHED_FIFO)) {
+            perror("pthread setschedpolicy failed");
+            exit(-1);
+        }
+        param[i].sched_priority = i == 0 ? sched_get_priority_min(SCHED_FIFO) : sched_get_priority_max(SCHED_FIFO);
+
+        if (pthread_attr_setschedparam(&(attr[i]), &(param[i]))) {
+            perror("pthread setschedparam failed");
+            exit(-1);
+        }
+
+        // Use scheduling parameters of attr
+        if (pthread_attr_setinheritsched(&(attr[i]), PTHREAD_EXPLICIT_SCHED)) {
+            perror("pthread setinheritsched failed");
+            exit(-1);
+        }
+
+        // Set thread affinity
+        CPU_ZERO(&(affinity_mask[i]));
+        CPU_SET(CORE_TO_TEST, &(affinity_mask[i]));
+
+        if (pthread_attr_setaffinity_np(&(attr[i]), sizeof(cpu_set_t), &(affinity_mask[i]))) {
+            perror("pthread setaffinity failed");
+            exit(-1);
+        }
+    }
+
+    for (int i = 0; i < 2; i++)
+        if (pthread_create(&threads[i], &(attr[i]), thread_routines[i], NULL)) {
+            perror("thread creation failed");
+            exit(-1);
+        }
+
+    for (int i = 0; i < 2; i++)
+        pthread_join(threads[i], NULL);
+
+    // Unlock pages
+    if (munlockall()) {
+        perror("munlockall failed");
+        exit(-1);
+    }
+
+    // Print result
+    timer_print_info();
+    printf("Wake up method: %s\n", wake_up_method == WAKE_UP_CLOCK_NANOSLEEP ? "clock_nanosleep" : "timerfd");
+    histogram_print(&wake_up_latency_histogram, "wake up (timer expiration to first instruction)");
+    histogram_print(&preemption_latency_histogram, "preemption (low priority thread to first instruction)");
+    histogram_print(&switch_back_histogram, "switch back (sleep to low priority thread)");
+
+    return 0;
+}
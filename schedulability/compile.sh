@@ -0,0 +1,15 @@
+#!/bin/bash
+
+# Architecture variables
+ARCHITECTURE=${ARCHITECTURE:-aarch64}
+
+if [ "${ARCHITECTURE}" == "aarch64" ]; then
+  CC=${CC:-aarch64-none-linux-gnu-gcc}
+else
+  CC=${CC:-gcc}
+fi
+
+mkdir -p ../builds/${ARCHITECTURE}
+
+# Overhead-aware response time analysis from the overhead profiles of the benchmarks
+${CC} -Wall -static -o ../builds/${ARCHITECTURE}/response_time_analysis response_time_analysis.c ../common/overhead_profile.c ../common/statistics.c ../common/timer.c -lm
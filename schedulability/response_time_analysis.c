@@ -0,0 +1,459 @@
+//
+// Overhead-aware response time analysis of a task set, using the costs of the overhead profiles written by the
+// benchmarks (-O option)
+//
+// The tasks are partitioned (each one runs in a fixed core) and scheduled with fixed priorities (SCHED_FIFO, a higher
+// number is a higher priority). The response time of each task is the fixed point of
+//
+//      w = C'i + sum over j in hep(i) of ceil((w + Jj) / Tj) * (C'j + gamma(i, j))      R = w + Ji
+//
+// where the tasks of the same core with a higher or equal priority interfere, and
+//  - C' is the WCET inflated with two context switches (the preemption cost of the core) and, for each migration of
+//    a job, the migration cost and the refill of the footprint of the task
+//  - J is the release jitter, the wake up latency of the core
+//  - gamma(i, j) is the cache related preemption delay of each preemption by j: the refill of the biggest footprint
+//    of the tasks that j can preempt while i is pending (priority from the one of i up to the one of j, excluded),
+//    interpolated from the cache refill costs by footprint
+//
+// Task set file: one task per line, fields separated by spaces, # starts a comment
+//      name core priority period_us deadline_us wcet_us [footprint_bytes [migrations_per_job]]
+// The deadlines must be constrained (deadline_us <= period_us)
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+
+#include "../common/overhead_profile.h"
+
+#define MAX_TASKS 256
+#define MAX_PROFILES 16
+#define MAX_REFILL_POINTS 128
+
+// Wake up mechanism used for the release jitter by default
+#define DEFAULT_WAKEUP_MECHANISM "futex"
+
+struct task {
+    char name[32];
+    int core;
+    int priority;
+    long long period_ns;
+    long long deadline_ns;
+    long long wcet_ns;
+    long footprint_bytes;
+    int migrations_per_job;
+
+    // Results of the analysis
+    long long inflated_wcet_ns;
+    long long release_jitter_ns;
+    long long response_time_ns;
+    long long response_time_without_overheads_ns;
+    bool schedulable;
+};
+
+// Refill cost of a footprint
+struct refill_point {
+    long footprint_bytes;
+    long long cost_ns;
+};
+
+// Merged profiles and selected percentile (index in overhead_profile_percentiles)
+static struct overhead_profile profile;
+static int percentile_index = OVERHEAD_PROFILE_NUMBER_OF_PERCENTILES - 1;
+static const char *wakeup_mechanism = DEFAULT_WAKEUP_MECHANISM;
+static const char *refill_label = NULL;
+
+static struct task tasks[MAX_TASKS];
+static int number_of_tasks = 0;
+
+bool select_percentile(const char *argument) {
+    /***
+     * Select the percentile of the costs ("max" or one of the stored percentiles). Return false if it isn't stored
+     */
+
+    double percentile = strcmp(argument, "max") == 0 ? 100.0 : strtod(argument, NULL);
+    for (int i = 0; i < OVERHEAD_PROFILE_NUMBER_OF_PERCENTILES; ++i) {
+        if (fabs(overhead_profile_percentiles[i] - percentile) < 1e-9) {
+            percentile_index = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool entry_matches(const struct overhead_entry *entry, enum overhead_kind kind, int core, const char *label) {
+    return entry->kind == kind && (core < 0 || entry->core == core) &&
+           (label == NULL || strcmp(entry->label, label) == 0);
+}
+
+long long find_cost(enum overhead_kind kind, int core, const char *label, bool *found) {
+    /***
+     * Worst cost of the entries of the given kind measured in the core (in any core if there isn't any of the core)
+     * at the selected percentile. found is false if there isn't any entry of the kind
+     */
+
+    for (int pass = 0; pass < 2; ++pass) {
+        long long cost = -1;
+        for (uint32_t e = 0; e < profile.number_of_entries; ++e) {
+            const struct overhead_entry *entry = &(profile.entries[e]);
+            if (entry_matches(entry, kind, pass == 0 ? core : -1, label) &&
+                entry->percentiles_ns[percentile_index] > cost)
+                cost = entry->percentiles_ns[percentile_index];
+        }
+
+        if (cost >= 0) {
+            *found = true;
+            return cost;
+        }
+    }
+
+    *found = false;
+    return 0;
+}
+
+int get_refill_points(int core, struct refill_point *points) {
+    /***
+     * Get the refill cost by footprint of the core (of any core if there isn't any of the core), sorted by footprint
+     * and keeping the worst cost of each footprint. Return the number of points
+     */
+
+    int number_of_points = 0;
+
+    for (int pass = 0; pass < 2 && number_of_points == 0; ++pass) {
+        for (uint32_t e = 0; e < profile.number_of_entries; ++e) {
+            const struct overhead_entry *entry = &(profile.entries[e]);
+            if (!entry_matches(entry, OVERHEAD_CACHE_REFILL, pass == 0 ? core : -1, refill_label) ||
+                entry->footprint_bytes <= 0)
+                continue;
+
+            long long cost = entry->percentiles_ns[percentile_index] > 0 ? entry->percentiles_ns[percentile_index] : 0;
+
+            // Insert it in order, or update the point of the same footprint
+            int position = 0;
+            while (position < number_of_points && points[position].footprint_bytes < entry->footprint_bytes)
+                position++;
+
+            if (position < number_of_points && points[position].footprint_bytes == entry->footprint_bytes) {
+                if (cost > points[position].cost_ns)
+                    points[position].cost_ns = cost;
+            } else if (number_of_points < MAX_REFILL_POINTS) {
+                memmove(&points[position + 1], &points[position],
+                        (number_of_points - position) * sizeof(struct refill_point));
+                points[position].footprint_bytes = entry->footprint_bytes;
+                points[position].cost_ns = cost;
+                number_of_points++;
+            }
+        }
+    }
+
+    return number_of_points;
+}
+
+long long refill_cost(const struct refill_point *points, int number_of_points, long footprint_bytes) {
+    /***
+     * Refill cost of a footprint, interpolated between the measured footprints. Out of their range the cost per byte
+     * of the nearest one is used
+     */
+
+    if (footprint_bytes <= 0 || number_of_points == 0)
+        return 0;
+
+    if (footprint_bytes <= points[0].footprint_bytes)
+        return (long long) ceil((double) points[0].cost_ns * footprint_bytes / points[0].footprint_bytes);
+
+    const struct refill_point *last = &points[number_of_points - 1];
+    if (footprint_bytes >= last->footprint_bytes)
+        return (long long) ceil((double) last->cost_ns * footprint_bytes / last->footprint_bytes);
+
+    int i = 1;
+    while (points[i].footprint_bytes < footprint_bytes)
+        i++;
+
+    double fraction = (double) (footprint_bytes - points[i - 1].footprint_bytes) /
+                      (double) (points[i].footprint_bytes - points[i - 1].footprint_bytes);
+    return (long long) ceil((double) points[i - 1].cost_ns + fraction * (double) (points[i].cost_ns -
+                                                                                  points[i - 1].cost_ns));
+}
+
+void read_task_set(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror("open task set failed");
+        exit(-1);
+    }
+
+    char line[512];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        line[strcspn(line, "#\n")] = '\0';
+
+        char name[32];
+        int core, priority, migrations = 0;
+        double period_us, deadline_us, wcet_us;
+        long footprint_bytes = 0;
+        int fields = sscanf(line, "%31s %d %d %lf %lf %lf %ld %d", name, &core, &priority, &period_us, &deadline_us,
+                            &wcet_us, &footprint_bytes, &migrations);
+        if (fields <= 0)
+            continue;
+
+        if (fields < 6 || period_us <= 0 || deadline_us <= 0 || wcet_us < 0 || footprint_bytes < 0 ||
+            migrations < 0) {
+            fprintf(stderr, "%s:%d: invalid task\n", path, line_number);
+            exit(-1);
+        }
+
+        // The recurrence only checks the first job of the busy period, that is the worst one with constrained deadlines
+        if (deadline_us > period_us) {
+            fprintf(stderr, "%s:%d: the deadline of %s is bigger than its period, only constrained deadlines are "
+                            "supported\n", path, line_number, name);
+            exit(-1);
+        }
+
+        if (number_of_tasks >= MAX_TASKS) {
+            fprintf(stderr, "too many tasks (maximum %d)\n", MAX_TASKS);
+            exit(-1);
+        }
+
+        struct task *task = &tasks[number_of_tasks++];
+        memset(task, 0, sizeof(struct task));
+        snprintf(task->name, sizeof(task->name), "%s", name);
+        task->core = core;
+        task->priority = priority;
+        task->period_ns = llround(period_us * 1000.0);
+        task->deadline_ns = llround(deadline_us * 1000.0);
+        task->wcet_ns = llround(wcet_us * 1000.0);
+        task->footprint_bytes = footprint_bytes;
+        task->migrations_per_job = migrations;
+    }
+
+    fclose(file);
+
+    if (number_of_tasks == 0) {
+        fprintf(stderr, "the task set %s is empty\n", path);
+        exit(-1);
+    }
+}
+
+long long response_time(const struct task *task, const long long *interference_costs, bool with_overheads) {
+    /***
+     * Fixed point of the response time of a task, interference_costs holds C'j + gamma(i, j) of each task. Return
+     * -1 if the response time is bigger than the deadline
+     */
+
+    long long wcet_ns = with_overheads ? task->inflated_wcet_ns : task->wcet_ns;
+    long long jitter_ns = with_overheads ? task->release_jitter_ns : 0;
+    long long window_ns = wcet_ns, previous_window_ns = -1;
+
+    while (window_ns != previous_window_ns) {
+        if (window_ns + jitter_ns > task->deadline_ns)
+            return -1;
+
+        previous_window_ns = window_ns;
+        window_ns = wcet_ns;
+        for (int j = 0; j < number_of_tasks; ++j) {
+            const struct task *other = &tasks[j];
+            if (other == task || other->core != task->core || other->priority < task->priority)
+                continue;
+
+            long long other_jitter_ns = with_overheads ? other->release_jitter_ns : 0;
+            long long releases = (previous_window_ns + other_jitter_ns + other->period_ns - 1) / other->period_ns;
+            window_ns += releases * (with_overheads ? interference_costs[j] : other->wcet_ns);
+        }
+    }
+
+    return window_ns + jitter_ns;
+}
+
+void analyze_task_set(void) {
+    /***
+     * Inflate the tasks with the overheads of their cores and compute their response times
+     */
+
+    static long long interference_costs[MAX_TASKS];
+    static struct refill_point points[MAX_REFILL_POINTS];
+    bool found;
+
+    bool missing[NUMBER_OF_OVERHEAD_KINDS] = {false};
+
+    for (int i = 0; i < number_of_tasks; ++i) {
+        struct task *task = &tasks[i];
+
+        long long switch_ns = find_cost(OVERHEAD_PREEMPTION, task->core, NULL, &found);
+        missing[OVERHEAD_PREEMPTION] |= !found;
+        task->release_jitter_ns = find_cost(OVERHEAD_WAKEUP, task->core, wakeup_mechanism, &found);
+        missing[OVERHEAD_WAKEUP] |= !found;
+
+        int number_of_points = get_refill_points(task->core, points);
+        missing[OVERHEAD_CACHE_REFILL] |= number_of_points == 0;
+
+        task->inflated_wcet_ns = task->wcet_ns + 2 * switch_ns;
+        if (task->migrations_per_job) {
+            long long migration_ns = find_cost(OVERHEAD_MIGRATION, task->core, NULL, &found);
+            missing[OVERHEAD_MIGRATION] |= !found;
+            task->inflated_wcet_ns += task->migrations_per_job *
+                                      (migration_ns + refill_cost(points, number_of_points, task->footprint_bytes));
+        }
+    }
+
+    for (int kind = 0; kind < NUMBER_OF_OVERHEAD_KINDS; ++kind) {
+        if (missing[kind])
+            fprintf(stderr, "there are no %s costs in the profiles, they are taken as 0\n",
+                    overhead_kind_name((enum overhead_kind) kind));
+    }
+
+    for (int i = 0; i < number_of_tasks; ++i) {
+        struct task *task = &tasks[i];
+        int number_of_points = get_refill_points(task->core, points);
+
+        for (int j = 0; j < number_of_tasks; ++j) {
+            const struct task *other = &tasks[j];
+            interference_costs[j] = other->inflated_wcet_ns;
+
+            // Tasks of the same priority don't preempt each other
+            if (other->core != task->core || other->priority <= task->priority)
+                continue;
+
+            long max_footprint_bytes = 0;
+            for (int k = 0; k < number_of_tasks; ++k) {
+                const struct task *preempted = &tasks[k];
+                if (preempted->core == task->core && preempted->priority >= task->priority &&
+                    preempted->priority < other->priority && preempted->footprint_bytes > max_footprint_bytes)
+                    max_footprint_bytes = preempted->footprint_bytes;
+            }
+            interference_costs[j] += refill_cost(points, number_of_points, max_footprint_bytes);
+        }
+
+        task->response_time_ns = response_time(task, interference_costs, true);
+        task->response_time_without_overheads_ns = response_time(task, interference_costs, false);
+        task->schedulable = task->response_time_ns >= 0;
+    }
+}
+
+void print_profile_costs(void) {
+    /***
+     * Print the costs of each core of the task set used in the analysis
+     */
+
+    char percentile_name[16] = "max";
+    if (percentile_index != OVERHEAD_PROFILE_NUMBER_OF_PERCENTILES - 1)
+        snprintf(percentile_name, sizeof(percentile_name), "%g", overhead_profile_percentiles[percentile_index]);
+
+    printf("Overhead model: \n\t%s: %s\n\t%s: %s\n\t%s: %s\n\t%s: %s (%s)\n\t%s: %u\n",
+           "Percentile of the costs", percentile_name, "Wake up mechanism", wakeup_mechanism,
+           "Host of the profile", profile.metadata.hostname, "Kernel", profile.metadata.kernel_release,
+           profile.metadata.machine, "Number of entries", profile.number_of_entries);
+
+    printf("core,preemption_ns,wakeup_ns,migration_ns,refill_points\n");
+    static struct refill_point points[MAX_REFILL_POINTS];
+    for (int i = 0; i < number_of_tasks; ++i) {
+        bool printed = false;
+        for (int j = 0; j < i && !printed; ++j)
+            printed = tasks[j].core == tasks[i].core;
+        if (printed)
+            continue;
+
+        bool found;
+        int core = tasks[i].core;
+        printf("%d,%lld,%lld,%lld,%d\n", core, find_cost(OVERHEAD_PREEMPTION, core, NULL, &found),
+               find_cost(OVERHEAD_WAKEUP, core, wakeup_mechanism, &found),
+               find_cost(OVERHEAD_MIGRATION, core, NULL, &found), get_refill_points(core, points));
+    }
+}
+
+void print_usage(const char *program_name) {
+    printf("Usage: %s -p profile.bin [-p profile.bin...] -t task_set [-q percentile|max] [-w mechanism]\n"
+           "       [-r label]\n"
+           "\t-p: overhead profile written by a benchmark with -O (binary form), several profiles are merged\n"
+           "\t-t: task set, one task per line: name core priority period_us deadline_us wcet_us [footprint_bytes\n"
+           "\t    [migrations_per_job]], with deadline_us <= period_us\n"
+           "\t-q: percentile of the costs used in the analysis (max by default):", program_name);
+    for (int i = 0; i < OVERHEAD_PROFILE_NUMBER_OF_PERCENTILES - 1; ++i)
+        printf(" %g", overhead_profile_percentiles[i]);
+    printf(" max\n"
+           "\t-w: wake up mechanism used for the release jitter (%s by default)\n"
+           "\t-r: only use the cache refill costs with this label (reload_penalty of preemption_cost,\n"
+           "\t    cache_affinity_loss of migration_cost or the kernel of l2_cache_fill_cost), all of them by default\n"
+           "The exit status is 0 if all the tasks are schedulable and 1 in other case\n", DEFAULT_WAKEUP_MECHANISM);
+}
+
+int main(int argc, char *argv[]) {
+    const char *profile_paths[MAX_PROFILES];
+    int number_of_profiles = 0;
+    const char *task_set_path = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "p:t:q:w:r:h")) != -1) {
+        switch (option) {
+            case 'p':
+                if (number_of_profiles == MAX_PROFILES) {
+                    fprintf(stderr, "too many profiles (maximum %d)\n", MAX_PROFILES);
+                    exit(-1);
+                }
+                profile_paths[number_of_profiles++] = optarg;
+                break;
+            case 't':
+                task_set_path = optarg;
+                break;
+            case 'q':
+                if (!select_percentile(optarg)) {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            case 'w':
+                wakeup_mechanism = optarg;
+                break;
+            case 'r':
+                refill_label = optarg;
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(option == 'h' ? 0 : -1);
+        }
+    }
+
+    if (number_of_profiles == 0 || task_set_path == NULL) {
+        print_usage(argv[0]);
+        exit(-1);
+    }
+
+    for (int i = 0; i < number_of_profiles; ++i)
+        overhead_profile_read(&profile, profile_paths[i]);
+    read_task_set(task_set_path);
+
+    analyze_task_set();
+
+    // Print result
+    print_profile_costs();
+    printf("task,core,priority,period_us,deadline_us,wcet_us,inflated_wcet_us,release_jitter_us,response_time_us,"
+           "response_time_without_overheads_us,schedulable\n");
+
+    int unschedulable_tasks = 0;
+    for (int i = 0; i < number_of_tasks; ++i) {
+        const struct task *task = &tasks[i];
+        unschedulable_tasks += !task->schedulable;
+
+        printf("%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,", task->name, task->core, task->priority, task->period_ns / 1000.0,
+               task->deadline_ns / 1000.0, task->wcet_ns / 1000.0, task->inflated_wcet_ns / 1000.0,
+               task->release_jitter_ns / 1000.0);
+        if (task->response_time_ns >= 0)
+            printf("%.3f,", task->response_time_ns / 1000.0);
+        else
+            printf("unbounded,");
+        if (task->response_time_without_overheads_ns >= 0)
+            printf("%.3f,", task->response_time_without_overheads_ns / 1000.0);
+        else
+            printf("unbounded,");
+        printf("%s\n", task->schedulable ? "yes" : "no");
+    }
+
+    printf("Schedulability result: \n\t%s: %d\n\t%s: %d\n\t%s: %s\n", "Number of tasks", number_of_tasks,
+           "Number of unschedulable tasks", unschedulable_tasks, "Task set schedulable",
+           unschedulable_tasks ? "no" : "yes");
+
+    return unschedulable_tasks ? 1 : 0;
+}
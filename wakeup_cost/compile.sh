@@ -0,0 +1,15 @@
+#!/bin/bash
+
+# Architecture variables
+ARCHITECTURE=${ARCHITECTURE:-aarch64}
+
+if [ "${ARCHITECTURE}" == "aarch64" ]; then
+  CC=${CC:-aarch64-none-linux-gnu-gcc}
+else
+  CC=${CC:-gcc}
+fi
+
+mkdir -p ../builds/${ARCHITECTURE}
+
+# Get wake up cost
+${CC} -Wall -static -pthread  -lpthread -o ../builds/${ARCHITECTURE}/wakeup_cost wakeup_cost_linux.c ../common/statistics.c ../common/timer.c ../common/overhead_profile.c ../common/preflight.c -lm
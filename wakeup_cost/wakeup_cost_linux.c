@@ -0,0 +1,462 @@
+//
+// This program calculate the cost of waking up a thread in other core with different synchronization mechanisms
+//
+// Two SCHED_FIFO threads play ping-pong: the first one signals the second one, that wakes up and signals back. The
+// one-way latency (from the signal to the first instruction of the woken thread) and the round-trip latency are
+// measured for each mechanism
+//
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/futex.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "../common/statistics.h"
+#include "../common/timer.h"
+#include "../common/overhead_profile.h"
+#include "../common/preflight.h"
+
+// Define variables
+#define NUMBER_OF_EXPERIMENTS 1000
+#define CORE_TO_TEST_PING 2
+#define CORE_TO_TEST_PONG 3
+
+// Time waited between experiments, so the woken thread is sleeping when it is signaled
+#define INTER_EXPERIMENT_DELAY_NANOSECONDS 50000
+
+// One direction of the ping-pong, aligned so each one has its own cache lines
+struct channel {
+    // futex and spin
+    int word __attribute__((aligned(64)));
+
+    // eventfd and pipe
+    int event_fd;
+    int pipe_fds[2];
+
+    // pthread_cond
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    bool flag;
+
+    // POSIX semaphore
+    sem_t semaphore;
+} __attribute__((aligned(64)));
+
+struct mechanism {
+    const char *name;
+    void (*init)(struct channel *channel);
+    void (*signal)(struct channel *channel);
+    void (*wait)(struct channel *channel);
+    void (*destroy)(struct channel *channel);
+
+    // False if the waiting thread never sleeps (it can't share the core with the signaling one)
+    bool blocking;
+};
+
+// Options of the test
+static long number_of_experiments = NUMBER_OF_EXPERIMENTS;
+static int cores[2] = {CORE_TO_TEST_PING, CORE_TO_TEST_PONG};
+
+// Channels of the test: ping (0) and pong (1)
+static struct channel channels[2];
+static const struct mechanism *tested_mechanism;
+
+// Timestamp taken just before signaling the ping
+static volatile uint64_t send_timestamp __attribute__((aligned(64)));
+
+// Histograms where the results will be stored
+struct histogram one_way_histogram, round_trip_histogram;
+
+// Raw futex
+static void futex_init(struct channel *channel) {
+    channel->word = 0;
+}
+
+static void futex_signal(struct channel *channel) {
+    __atomic_store_n(&(channel->word), 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &(channel->word), FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void futex_wait(struct channel *channel) {
+    while (__atomic_exchange_n(&(channel->word), 0, __ATOMIC_ACQUIRE) == 0)
+        syscall(SYS_futex, &(channel->word), FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+}
+
+static void no_destroy(struct channel *channel) {
+    (void) channel;
+}
+
+// eventfd
+static void eventfd_init(struct channel *channel) {
+    channel->event_fd = eventfd(0, 0);
+    if (channel->event_fd < 0) {
+        perror("eventfd failed");
+        exit(-1);
+    }
+}
+
+static void eventfd_signal(struct channel *channel) {
+    uint64_t value = 1;
+    if (write(channel->event_fd, &value, sizeof(value)) != sizeof(value)) {
+        perror("eventfd write failed");
+        exit(-1);
+    }
+}
+
+static void eventfd_wait(struct channel *channel) {
+    uint64_t value;
+    if (read(channel->event_fd, &value, sizeof(value)) != sizeof(value)) {
+        perror("eventfd read failed");
+        exit(-1);
+    }
+}
+
+static void eventfd_destroy(struct channel *channel) {
+    close(channel->event_fd);
+}
+
+// pipe
+static void pipe_init(struct channel *channel) {
+    if (pipe(channel->pipe_fds)) {
+        perror("pipe failed");
+        exit(-1);
+    }
+}
+
+static void pipe_signal(struct channel *channel) {
+    char value = 1;
+    if (write(channel->pipe_fds[1], &value, 1) != 1) {
+        perror("pipe write failed");
+        exit(-1);
+    }
+}
+
+static void pipe_wait(struct channel *channel) {
+    char value;
+    if (read(channel->pipe_fds[0], &value, 1) != 1) {
+        perror("pipe read failed");
+        exit(-1);
+    }
+}
+
+static void pipe_destroy(struct channel *channel) {
+    close(channel->pipe_fds[0]);
+    close(channel->pipe_fds[1]);
+}
+
+// pthread_cond
+static void condition_init(struct channel *channel) {
+    pthread_mutex_init(&(channel->mutex), NULL);
+    pthread_cond_init(&(channel->condition), NULL);
+    channel->flag = false;
+}
+
+static void condition_signal(struct channel *channel) {
+    pthread_mutex_lock(&(channel->mutex));
+    channel->flag = true;
+    pthread_cond_signal(&(channel->condition));
+    pthread_mutex_unlock(&(channel->mutex));
+}
+
+static void condition_wait(struct channel *channel) {
+    pthread_mutex_lock(&(channel->mutex));
+    while (!channel->flag)
+        pthread_cond_wait(&(channel->condition), &(channel->mutex));
+    channel->flag = false;
+    pthread_mutex_unlock(&(channel->mutex));
+}
+
+static void condition_destroy(struct channel *channel) {
+    pthread_cond_destroy(&(channel->condition));
+    pthread_mutex_destroy(&(channel->mutex));
+}
+
+// POSIX semaphore
+static void semaphore_init(struct channel *channel) {
+    if (sem_init(&(channel->semaphore), 0, 0)) {
+        perror("sem_init failed");
+        exit(-1);
+    }
+}
+
+static void semaphore_signal(struct channel *channel) {
+    sem_post(&(channel->semaphore));
+}
+
+static void semaphore_wait(struct channel *channel) {
+    while (sem_wait(&(channel->semaphore)));
+}
+
+static void semaphore_destroy(struct channel *channel) {
+    sem_destroy(&(channel->semaphore));
+}
+
+// Busy-spin on a cache line flag
+static void spin_signal(struct channel *channel) {
+    __atomic_store_n(&(channel->word), 1, __ATOMIC_RELEASE);
+}
+
+static void spin_wait(struct channel *channel) {
+    while (__atomic_exchange_n(&(channel->word), 0, __ATOMIC_ACQUIRE) == 0) {
+        while (__atomic_load_n(&(channel->word), __ATOMIC_RELAXED) == 0);
+    }
+}
+
+static const struct mechanism mechanisms[] = {
+        {"futex",     futex_init,     futex_signal,     futex_wait,     no_destroy,        true},
+        {"eventfd",   eventfd_init,   eventfd_signal,   eventfd_wait,   eventfd_destroy,   true},
+        {"pipe",      pipe_init,      pipe_signal,      pipe_wait,      pipe_destroy,      true},
+        {"condvar",   condition_init, condition_signal, condition_wait, condition_destroy, true},
+        {"semaphore", semaphore_init, semaphore_signal, semaphore_wait, semaphore_destroy, true},
+        {"spin",      futex_init,     spin_signal,      spin_wait,      no_destroy,        false},
+        {NULL,        NULL,           NULL,             NULL,           NULL,              false}
+};
+
+static void delay(long nanoseconds) {
+    /***
+     * Busy wait the given time
+     */
+
+    uint64_t start = timer_read();
+    while (timer_ticks_to_ns((long long) (timer_read() - start)) < nanoseconds);
+}
+
+void *ping_thread_execution(void *data) {
+    (void) data;
+
+    for (long i = 0; i < number_of_experiments; ++i) {
+        // Let the other thread go to sleep
+        delay(INTER_EXPERIMENT_DELAY_NANOSECONDS);
+
+        uint64_t local_send_timestamp = timer_read();
+        send_timestamp = local_send_timestamp;
+        tested_mechanism->signal(&(channels[0]));
+
+        tested_mechanism->wait(&(channels[1]));
+        uint64_t local_receive_timestamp = timer_read();
+
+        histogram_record(&round_trip_histogram, timer_interval_ns(local_send_timestamp, local_receive_timestamp));
+    }
+
+    return NULL;
+}
+
+void *pong_thread_execution(void *data) {
+    (void) data;
+
+    for (long i = 0; i < number_of_experiments; ++i) {
+        tested_mechanism->wait(&(channels[0]));
+        uint64_t local_receive_timestamp = timer_read();
+
+        // Copy the send time before signalling, the ping thread overwrites it in the next experiment
+        uint64_t local_send_timestamp = send_timestamp;
+        tested_mechanism->signal(&(channels[1]));
+
+        histogram_record(&one_way_histogram, timer_interval_ns(local_send_timestamp, local_receive_timestamp));
+    }
+
+    return NULL;
+}
+
+void run_threads(void) {
+    /***
+     * Execute the ping thread in cores[0] and the pong thread in cores[1], both with the max SCHED_FIFO priority
+     */
+
+    pthread_t threads[2];
+    struct sched_param param[2];
+    pthread_attr_t attr[2];
+    cpu_set_t affinity_mask[2];
+    void *(*thread_routines[2])(void *) = {ping_thread_execution, pong_thread_execution};
+
+    // Configure threads attributes
+    for (int i = 0; i < 2; ++i) {
+        // Init attrs
+        if (pthread_attr_init(&(attr[i]))) {
+            perror("pthread init failed");
+            exit(-1);
+        }
+
+        // Set a specific stack size
+        if (pthread_attr_setstacksize(&(attr[i]), PTHREAD_STACK_MIN + 0x4000)) {
+            perror("pthread setstacksize failed");
+            exit(-1);
+        }
+
+        // Set scheduler policy and priority of pthread
+        if (pthread_attr_setschedpolicy(&(attr[i]), SCHED_FIFO)) {
+            perror("pthread setschedpolicy failed");
+            exit(-1);
+        }
+        param[i].sched_priority = sched_get_priority_max(SCHED_FIFO);
+
+        if (pthread_attr_setschedparam(&(attr[i]), &(param[i]))) {
+            perror("pthread setschedparam failed");
+            exit(-1);
+        }
+
+        // Use scheduling parameters of attr
+        if (pthread_attr_setinheritsched(&(attr[i]), PTHREAD_EXPLICIT_SCHED)) {
+            perror("pthread setinheritsched failed");
+            exit(-1);
+        }
+
+        // Set thread affinity
+        CPU_ZERO(&(affinity_mask[i]));
+        CPU_SET(cores[i], &(affinity_mask[i]));
+
+        if (pthread_attr_setaffinity_np(&(attr[i]), sizeof(cpu_set_t), &(affinity_mask[i]))) {
+            perror("pthread setaffinity failed");
+            exit(-1);
+        }
+    }
+
+    for (int i = 0; i < 2; i++)
+        if (pthread_create(&threads[i], &(attr[i]), thread_routines[i], NULL)) {
+            perror("thread creation failed");
+            exit(-1);
+        }
+
+    for (int i = 0; i < 2; i++)
+        pthread_join(threads[i], NULL);
+}
+
+void print_usage(const char *program_name) {
+    printf("Usage: %s [-m mechanism|all] [-c ping_core,pong_core] [-n experiments] [-O path_prefix] [-i]\n"
+           "\t-m: mechanism to test (all by default):", program_name);
+    for (const struct mechanism *mechanism = mechanisms; mechanism->name != NULL; ++mechanism)
+        printf(" %s", mechanism->name);
+    printf("\n\t-c: cores of the ping and pong threads (%d,%d by default)\n"
+           "\t-n: number of experiments (%d by default)\n"
+           "\t-O: write the overhead profile (one-way wake up latency of each mechanism) with the metadata of the\n"
+           "\t    host to path_prefix.json and path_prefix.bin\n"
+           "\t-i: apply a low noise setup to both cores during the run (IRQs, frequency, C-states, RT throttling\n"
+           "\t    and THP, see common/preflight.h), it needs root and the settings are restored at exit\n",
+           CORE_TO_TEST_PING, CORE_TO_TEST_PONG, NUMBER_OF_EXPERIMENTS);
+}
+
+int main(int argc, char *argv[]) {
+    const char *mechanism_name = "all";
+    const char *overhead_profile_path = NULL;
+    static struct overhead_profile overhead_profile;
+    bool low_noise_setup = false;
+    static struct preflight_report preflight_report;
+
+    int option;
+    while ((option = getopt(argc, argv, "m:c:n:O:ih")) != -1) {
+        switch (option) {
+            case 'm':
+                mechanism_name = optarg;
+                break;
+            case 'c':
+                if (sscanf(optarg, "%d,%d", &(cores[0]), &(cores[1])) != 2) {
+                    print_usage(argv[0]);
+                    exit(-1);
+                }
+                break;
+            case 'n':
+                number_of_experiments = strtol(optarg, NULL, 0);
+                break;
+            case 'O':
+                overhead_profile_path = optarg;
+                break;
+            case 'i':
+                low_noise_setup = true;
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(option == 'h' ? 0 : -1);
+        }
+    }
+
+    // Select and calibrate the timer
+    timer_init();
+
+    if (overhead_profile_path != NULL) {
+        overhead_profile_init(&overhead_profile, "wakeup_cost", cores[1]);
+        overhead_profile_add_config(&overhead_profile, "experiments", "%ld", number_of_experiments);
+    }
+
+    // Check the settings of both cores, the wake up latency depends on the C-states of the pong core
+    cpu_set_t tested_cpus;
+    CPU_ZERO(&tested_cpus);
+    CPU_SET(cores[0], &tested_cpus);
+    CPU_SET(cores[1], &tested_cpus);
+    preflight_check(&tested_cpus, &preflight_report);
+    if (low_noise_setup)
+        preflight_apply(&tested_cpus);
+
+    // Lock memory
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        perror("mlockall failed");
+    }
+
+    timer_print_info();
+    printf("Cores: %d (ping) and %d (pong)\n", cores[0], cores[1]);
+
+    // Start sampling with the frequency of both cores stable
+    preflight_warm_up(&tested_cpus);
+
+    bool mechanism_found = false;
+    for (const struct mechanism *mechanism = mechanisms; mechanism->name != NULL; ++mechanism) {
+        if (strcmp(mechanism_name, "all") != 0 && strcmp(mechanism_name, mechanism->name) != 0)
+            continue;
+        mechanism_found = true;
+
+        // Two SCHED_FIFO threads with the same priority can't busy wait for each other in the same core
+        if (!mechanism->blocking && cores[0] == cores[1]) {
+            printf("Mechanism %s skipped, it needs two different cores\n", mechanism->name);
+            continue;
+        }
+
+        tested_mechanism = mechanism;
+        for (int i = 0; i < 2; ++i)
+            mechanism->init(&(channels[i]));
+
+        histogram_init(&one_way_histogram);
+        histogram_init(&round_trip_histogram);
+
+        run_threads();
+
+        for (int i = 0; i < 2; ++i)
+            mechanism->destroy(&(channels[i]));
+
+        // Print result
+        printf("Mechanism: %s\n", mechanism->name);
+        histogram_print(&one_way_histogram, "one-way wake up");
+        histogram_print(&round_trip_histogram, "round-trip wake up");
+
+        if (overhead_profile_path != NULL)
+            overhead_profile_add(&overhead_profile, OVERHEAD_WAKEUP, cores[1], cores[0], 0, mechanism->name,
+                                 &one_way_histogram);
+    }
+
+    if (!mechanism_found) {
+        print_usage(argv[0]);
+        exit(-1);
+    }
+
+    // Unlock pages
+    if (munlockall()) {
+        perror("munlockall failed");
+        exit(-1);
+    }
+
+    if (overhead_profile_path != NULL) {
+        overhead_profile_write(&overhead_profile, overhead_profile_path);
+        overhead_profile_free(&overhead_profile);
+    }
+
+    return 0;
+}